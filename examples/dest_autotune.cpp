@@ -0,0 +1,109 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/dest.h>
+#include <dest/core/autotune.h>
+#include <dest/util/synthetic.h>
+#include <tclap/CmdLine.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+/** Parse comma separated list of positive integers. */
+bool parseIntList(const std::string &str, std::vector<int> &values) {
+    values.clear();
+    std::istringstream iss(str);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        std::istringstream is(item);
+        int v;
+        if (!(is >> v) || v <= 0)
+            return false;
+        values.push_back(v);
+    }
+    return !values.empty();
+}
+
+/**
+    Find the fastest runtime configuration of a tracker on this host.
+
+    Evaluates instruction sets, sampling strategies, batch sizes, thread counts and pipeline
+    stages on synthetic faces and writes the fastest configuration to a profile file. By
+    default the profile is stored next to the tracker, where tools pick it up on startup.
+*/
+int main(int argc, char **argv)
+{
+    struct {
+        std::string tracker;
+        std::string output;
+        int numImages;
+        int imageSize;
+        dest::core::AutotuneParameters params;
+    } opts;
+
+    try {
+        TCLAP::CmdLine cmd("Find the fastest runtime configuration of a tracker on this host.", ' ', "0.9");
+
+        TCLAP::ValueArg<std::string> trackerArg("t", "tracker", "Trained tracker to tune.", true, "dest.bin", "file", cmd);
+        TCLAP::ValueArg<std::string> outputArg("o", "output", "Profile output. Defaults to tracker path with .profile appended.", false, "", "file", cmd);
+        TCLAP::ValueArg<int> numImagesArg("", "num-images", "Number of synthetic faces per trial.", false, 256, "int", cmd);
+        TCLAP::ValueArg<int> imageSizeArg("", "image-size", "Size of synthetic images.", false, 256, "int", cmd);
+        TCLAP::ValueArg<std::string> batchSizesArg("", "batch-sizes", "Comma separated batch sizes to try.", false, "4,8,16,32,64", "list", cmd);
+        TCLAP::ValueArg<std::string> threadsArg("", "threads", "Comma separated thread counts to try. Defaults to powers of two up to the number of hardware threads.", false, "", "list", cmd);
+        TCLAP::ValueArg<int> stagesArg("", "max-pipeline-stages", "Maximum number of pipeline stages to try.", false, opts.params.maxPipelineStages, "int", cmd);
+        TCLAP::ValueArg<int> repsArg("", "repetitions", "Number of passes per trial, the fastest pass counts.", false, 3, "int", cmd);
+
+        cmd.parse(argc, argv);
+
+        opts.tracker = trackerArg.getValue();
+        opts.output = outputArg.isSet() ? outputArg.getValue() : dest::core::runtimeProfilePath(opts.tracker);
+        opts.numImages = std::max<int>(1, numImagesArg.getValue());
+        opts.imageSize = imageSizeArg.getValue();
+        opts.params.maxPipelineStages = stagesArg.getValue();
+        opts.params.numRepetitions = repsArg.getValue();
+
+        if (!parseIntList(batchSizesArg.getValue(), opts.params.batchSizes)) {
+            std::cerr << "Invalid batch sizes." << std::endl;
+            return -1;
+        }
+        if (threadsArg.isSet() && !parseIntList(threadsArg.getValue(), opts.params.threadCounts)) {
+            std::cerr << "Invalid thread counts." << std::endl;
+            return -1;
+        }
+    }
+    catch (TCLAP::ArgException &e) {
+        std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+
+    dest::core::Tracker t;
+    if (!t.load(opts.tracker)) {
+        std::cerr << "Failed to load tracker." << std::endl;
+        return -1;
+    }
+
+    dest::core::InputData inputs;
+    inputs.rnd.seed(10);
+    dest::util::createSyntheticInputData(opts.numImages, opts.imageSize, inputs.rnd, inputs);
+    dest::core::InputData::normalizeShapes(inputs);
+
+    std::vector<dest::core::RuntimeProfile> trials;
+    dest::core::RuntimeProfile best = dest::core::autotune(t, inputs.images, inputs.shapeToImage, opts.params, &trials);
+
+    std::cout << "Evaluated " << trials.size() << " configurations. Fastest:" << std::endl << best << std::endl;
+
+    if (!dest::core::saveRuntimeProfile(opts.output, best)) {
+        std::cerr << "Failed to save profile." << std::endl;
+        return -1;
+    }
+    std::cout << "Profile written to " << opts.output << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/dest.h>
+#include <dest/io/synthetic_database.h>
+#include <tclap/CmdLine.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+    #include <direct.h>
+    #pragma comment(lib, "psapi.lib")
+#else
+    #include <sys/resource.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+/** Peak resident set size of this process in megabytes. */
+double peakResidentMB() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+bool makeDirectory(const std::string &path) {
+#if defined(_WIN32)
+    return _mkdir(path.c_str()) == 0;
+#else
+    return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+bool removeDirectory(const std::string &path) {
+#if defined(_WIN32)
+    return _rmdir(path.c_str()) == 0;
+#else
+    return rmdir(path.c_str()) == 0;
+#endif
+}
+
+std::string temporaryDirectory() {
+    const char *vars[] = { "TMPDIR", "TEMP", "TMP" };
+    std::string base;
+    for (int i = 0; i < 3 && base.empty(); ++i) {
+        const char *v = std::getenv(vars[i]);
+        if (v)
+            base = v;
+    }
+#if !defined(_WIN32)
+    if (base.empty())
+        base = "/tmp";
+#else
+    if (base.empty())
+        base = ".";
+#endif
+
+    std::ostringstream str;
+    str << base << "/dest_bench_io_" << Clock::now().time_since_epoch().count();
+    return str.str();
+}
+
+size_t fileSize(const std::string &path) {
+    std::ifstream ifs(path.c_str(), std::ios::binary | std::ios::ate);
+    return ifs.is_open() ? static_cast<size_t>(ifs.tellg()) : 0;
+}
+
+void report(const std::string &name, double ms, size_t numItems, double megaBytes) {
+    std::cout << std::setw(20) << std::left << name
+              << std::setw(12) << std::right << std::fixed << std::setprecision(1) << ms << " ms"
+              << std::setw(12) << std::setprecision(0) << (ms > 0 ? numItems / (ms * 0.001) : 0) << " items/s";
+    if (megaBytes > 0)
+        std::cout << std::setw(12) << std::setprecision(1) << (ms > 0 ? megaBytes / (ms * 0.001) : 0) << " MB/s";
+    std::cout << std::endl;
+}
+
+/**
+    Benchmark loading of training databases.
+
+    Writes a synthetic IMM, iBUG or LAND database to a temporary directory and times the phases of
+    ShapeDatabase::load separately: globbing, annotation parsing, image decoding, scaling, mirroring
+    and conversion to DEST format. Reports throughput per phase and peak resident memory.
+*/
+int main(int argc, char **argv)
+{
+    struct {
+        dest::io::SyntheticDatabaseParameters params;
+        std::string directory;
+        bool mirror;
+        int maxLoadSize;
+        int repeat;
+        bool keep;
+    } opts;
+
+    try {
+        TCLAP::CmdLine cmd("Benchmark loading of training databases.", ' ', "0.9");
+
+        std::vector<std::string> allowedFormats;
+        allowedFormats.push_back("imm");
+        allowedFormats.push_back("ibug");
+        allowedFormats.push_back("land");
+        TCLAP::ValuesConstraint<std::string> allowedFormatsConstraint(allowedFormats);
+
+        std::vector<std::string> allowedExtensions;
+        allowedExtensions.push_back("png");
+        allowedExtensions.push_back("jpg");
+        allowedExtensions.push_back("jpeg");
+        allowedExtensions.push_back("bmp");
+        TCLAP::ValuesConstraint<std::string> allowedExtensionsConstraint(allowedExtensions);
+
+        TCLAP::ValueArg<std::string> formatArg("f", "format", "Database format to generate.", false, opts.params.format, &allowedFormatsConstraint, cmd);
+        TCLAP::ValueArg<std::string> extensionArg("e", "image-extension", "Image file extension.", false, opts.params.imageExtension, &allowedExtensionsConstraint, cmd);
+        TCLAP::ValueArg<int> numImagesArg("n", "num-images", "Number of images to generate.", false, opts.params.numImages, "int", cmd);
+        TCLAP::ValueArg<int> imageSizeArg("s", "image-size", "Width and height of images in pixels.", false, opts.params.imageSize, "int", cmd);
+        TCLAP::ValueArg<int> maxLoadSizeArg("", "load-max-size", "Scale images exceeding this size while loading.", false, std::numeric_limits<int>::max(), "int", cmd);
+        TCLAP::ValueArg<int> repeatArg("r", "repeat", "Number of times to load the database.", false, 3, "int", cmd);
+        TCLAP::ValueArg<std::string> directoryArg("d", "directory", "Existing directory to generate database in. Defaults to a new temporary directory.", false, "", "path", cmd);
+        TCLAP::SwitchArg mirrorArg("", "load-mirrored", "Additionally load mirrored images.", cmd, false);
+        TCLAP::SwitchArg keepArg("", "keep", "Keep generated files.", cmd, false);
+
+        cmd.parse(argc, argv);
+
+        opts.params.format = formatArg.getValue();
+        opts.params.imageExtension = extensionArg.getValue();
+        opts.params.numImages = numImagesArg.getValue();
+        opts.params.imageSize = imageSizeArg.getValue();
+        opts.maxLoadSize = maxLoadSizeArg.getValue();
+        opts.repeat = std::max<int>(1, repeatArg.getValue());
+        opts.directory = directoryArg.getValue();
+        opts.mirror = mirrorArg.getValue();
+        opts.keep = keepArg.getValue();
+    }
+    catch (TCLAP::ArgException &e) {
+        std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+
+    const bool ownsDirectory = opts.directory.empty();
+    if (ownsDirectory) {
+        opts.directory = temporaryDirectory();
+        if (!makeDirectory(opts.directory)) {
+            std::cerr << "Failed to create directory " << opts.directory << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << opts.params;
+    std::cout << std::setw(30) << std::left << "Directory" << opts.directory << std::endl;
+
+    std::vector<std::string> files;
+    Clock::time_point start = Clock::now();
+    const bool written = dest::io::writeSyntheticDatabase(opts.directory, opts.params, &files);
+    const double generateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // Files alternate between image and annotation.
+    double imageMB = 0, annotationMB = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const double mb = fileSize(files[i]) / (1024.0 * 1024.0);
+        if (i % 2 == 0)
+            imageMB += mb;
+        else
+            annotationMB += mb;
+    }
+
+    int result = 0;
+    if (!written) {
+        std::cerr << "Failed to generate database." << std::endl;
+        result = -1;
+    } else {
+        std::cout << "Generated " << files.size() << " files, " << std::fixed << std::setprecision(1)
+                  << imageMB << " MB images and " << annotationMB << " MB annotations in " << generateMs << " ms" << std::endl;
+        std::cout << std::setw(30) << std::left << "Peak resident MB before load" << peakResidentMB() << std::endl << std::endl;
+
+        for (int r = 0; r < opts.repeat; ++r) {
+            dest::io::ShapeDatabase db;
+            db.setLoaderType(opts.params.format);
+            db.enableMirroring(opts.mirror);
+            db.setMaxImageLoadSize(opts.maxLoadSize);
+
+            std::vector<dest::core::Image> images;
+            std::vector<dest::core::Shape> shapes;
+            std::vector<dest::core::Rect> rects;
+
+            if (!db.load(opts.directory, images, shapes, rects)) {
+                std::cerr << "Failed to load database." << std::endl;
+                result = -1;
+                break;
+            }
+
+            const dest::io::DatabaseLoadStats &s = db.lastLoadStats();
+            const size_t n = s.numCandidates;
+            const double pixelMB = s.numPixelsDecoded / (1024.0 * 1024.0);
+
+            std::cout << "Run " << r + 1 << " of " << opts.repeat << ", loaded " << s.numLoaded << " entries" << std::endl;
+            report("Glob", s.globMs, n, 0);
+            report("Parse", s.parseMs, n, annotationMB);
+            report("Decode", s.decodeMs, n, imageMB);
+            report("Decoded pixels", s.decodeMs, n, pixelMB);
+            report("Scale", s.scaleMs, n, 0);
+            report("Mirror", s.mirrorMs, n, 0);
+            report("Convert", s.convertMs, s.numLoaded, 0);
+            report("Total", s.totalMs(), s.numLoaded, 0);
+            std::cout << std::setw(30) << std::left << "Peak resident MB" << std::setprecision(1) << peakResidentMB() << std::endl << std::endl;
+        }
+    }
+
+    if (!opts.keep) {
+        for (size_t i = 0; i < files.size(); ++i)
+            std::remove(files[i].c_str());
+        if (ownsDirectory)
+            removeDirectory(opts.directory);
+    }
+
+    return result;
+}
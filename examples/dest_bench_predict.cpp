@@ -0,0 +1,420 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/dest.h>
+#include <dest/core/request_coalescer.h>
+#include <dest/core/pipelined_tracker.h>
+#include <dest/util/synthetic.h>
+#include <dest/util/perf_counters.h>
+#include <dest/core/autotune.h>
+#include <tclap/CmdLine.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <limits>
+
+typedef std::chrono::steady_clock Clock;
+
+inline double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void report(const std::string &name, double ms, size_t numFaces) {
+    std::cout << std::setw(40) << std::left << name
+              << std::setw(12) << std::fixed << std::setprecision(1) << (ms * 1000.0 / numFaces) << "us/face"
+              << std::setw(12) << std::right << std::setprecision(0) << (numFaces / (ms * 0.001)) << " faces/s" << std::endl;
+
+    // Hardware counters of prediction since last report, normalized per face.
+    if (dest::util::perfCountersEnabled()) {
+        const dest::util::PerfStats ps = dest::util::perfStats(dest::util::PERF_PHASE_PREDICT);
+        std::cout << std::setw(40) << std::left << "" << std::fixed << std::setprecision(2);
+        if (ps.valid[dest::util::PERF_CYCLES]) {
+            std::cout << "IPC " << ps.instructionsPerCycle();
+            const dest::util::PerfEvent events[] = { dest::util::PERF_CYCLES, dest::util::PERF_L1D_MISSES, dest::util::PERF_LLC_MISSES, dest::util::PERF_BRANCH_MISSES };
+            for (int e = 0; e < 4; ++e) {
+                std::cout << ", " << dest::util::perfEventName(events[e]) << " ";
+                if (ps.valid[events[e]])
+                    std::cout << std::setprecision(0) << (double)ps.counts[events[e]] / numFaces;
+                else
+                    std::cout << "n/a";
+            }
+            std::cout << " per face";
+        } else {
+            std::cout << "Hardware counters not available";
+        }
+        std::cout << std::endl;
+        dest::util::resetPerfStats();
+    }
+}
+
+/** Mean landmark error in normalized shape space. */
+float meanNormalizedError(const dest::core::Tracker &t, const dest::core::InputData &input)
+{
+    float error = 0.f;
+    for (size_t i = 0; i < input.images.size(); ++i) {
+        dest::core::Shape s = t.predict(input.images[i], input.shapeToImage[i]);
+        s = input.shapeToImage[i].inverse() * s.colwise().homogeneous();
+        error += (s - input.shapes[i]).colwise().norm().mean();
+    }
+    return error / static_cast<float>(std::max<size_t>(1, input.images.size()));
+}
+
+/** Train with each split selection on the same samples, report training time and held-out error. */
+void compareSplitSelection(const dest::core::InputData &inputs, const dest::core::InputData &heldOut, const dest::core::TrainingParameters &params)
+{
+    const dest::core::SplitSelection selections[] = { dest::core::SPLIT_RANDOM, dest::core::SPLIT_CORRELATION };
+    const char *names[] = { "random", "correlation" };
+
+    for (int m = 0; m < 2; ++m) {
+        dest::core::InputData in = inputs;
+        in.rnd.seed(10);
+
+        dest::core::SampleData td(in);
+        td.params = params;
+        td.params.splitSelection = selections[m];
+
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 5;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+
+        dest::core::Tracker t;
+        Clock::time_point start = Clock::now();
+        t.fit(td);
+        const double ms = elapsedMs(start);
+
+        // Formatted separately, so that the parameters printed by the next training keep their format.
+        std::stringstream name, line;
+        name << "Train (" << names[m] << " splits)";
+        line << std::setw(40) << std::left << name.str()
+             << std::setw(12) << std::fixed << std::setprecision(0) << ms << "ms"
+             << std::setw(12) << std::right << std::setprecision(4) << meanNormalizedError(t, inputs) << " train error"
+             << std::setw(12) << std::right << std::setprecision(4) << meanNormalizedError(t, heldOut) << " held-out error";
+        std::cout << line.str() << std::endl;
+    }
+}
+
+/**
+    Train with and without pyramid sampling on the same samples, report single predict time and error
+    on held-out faces. Timings are the best of several passes over the held-out faces.
+*/
+void comparePyramidSampling(const dest::core::InputData &inputs, const dest::core::InputData &heldOut, const dest::core::TrainingParameters &params, float samplesPerLambda)
+{
+    const float samples[] = { 0.f, samplesPerLambda };
+
+    for (int m = 0; m < 2; ++m) {
+        dest::core::InputData in = inputs;
+        in.rnd.seed(10);
+
+        dest::core::SampleData td(in);
+        td.params = params;
+        td.params.pyramidSamplesPerLambda = samples[m];
+
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 5;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+
+        dest::core::Tracker t;
+        t.fit(td);
+
+        double best = std::numeric_limits<double>::max();
+        for (int pass = 0; pass < 5; ++pass) {
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < heldOut.images.size(); ++i) {
+                t.predict(heldOut.images[i], heldOut.shapeToImage[i]);
+            }
+            best = std::min<double>(best, elapsedMs(start));
+        }
+        const double usPerFace = best * 1000.0 / static_cast<double>(std::max<size_t>(1, heldOut.images.size()));
+
+        // Formatted separately, so that the parameters printed by the next training keep their format.
+        std::stringstream name, line;
+        if (m == 0)
+            name << "Predict (full resolution)";
+        else
+            name << "Predict (pyramid, " << samples[m] << " samples)";
+        line << std::setw(40) << std::left << name.str()
+             << std::setw(12) << std::fixed << std::setprecision(1) << usPerFace << "us/face"
+             << std::setw(12) << std::right << "level " << t.maxSamplingLevel(heldOut.shapeToImage.front())
+             << std::setw(12) << std::right << std::setprecision(4) << meanNormalizedError(t, heldOut) << " held-out error";
+        std::cout << line.str() << std::endl;
+    }
+}
+
+/**
+    Benchmark prediction throughput.
+
+    Runs the tracker on synthetic faces using single, batched, pipelined and coalesced prediction.
+    Single prediction is measured for each pixel sampling strategy. Automatic sampling uses the
+    relative cost of lazy sampling measured on this machine unless given explicitly.
+    When no tracker is given, a tracker is trained on synthetic faces first. Note that
+    a tracker loaded from file is evaluated on synthetic faces as well, so only timings
+    are meaningful in this case. With --compare-split-selection trackers are trained with random and
+    correlation based split selection first, comparing training time and error on held-out faces.
+    With --compare-pyramid-sampling trackers are trained with and without sampling coarse cascades from
+    image pyramids first, comparing prediction time and error on held-out faces.
+*/
+int main(int argc, char **argv)
+{
+    struct {
+        std::string tracker;
+        int numImages;
+        int imageSize;
+        int batchSize;
+        int pipelineStages;
+        bool batchSizeSet;
+        bool pipelineStagesSet;
+        int numClients;
+        int numRequests;
+        float windowMs;
+        float latencyMs;
+        int trainCascades;
+        int trainTrees;
+        int trainDepth;
+        int trainPixels;
+        bool perfCounters;
+        bool compareSplits;
+        float comparePyramidSamples;
+        float lazyCost;
+        bool lazyCostSet;
+    } opts;
+
+    try {
+        TCLAP::CmdLine cmd("Benchmark prediction throughput on synthetic faces.", ' ', "0.9");
+
+        TCLAP::ValueArg<std::string> trackerArg("t", "tracker", "Trained tracker to load. If omitted a tracker is trained on synthetic faces.", false, "", "file", cmd);
+        TCLAP::ValueArg<int> numImagesArg("", "num-images", "Number of synthetic images.", false, 256, "int", cmd);
+        TCLAP::ValueArg<int> imageSizeArg("", "image-size", "Size of synthetic images.", false, 256, "int", cmd);
+        TCLAP::ValueArg<int> batchSizeArg("", "batch-size", "Maximum batch size.", false, 32, "int", cmd);
+        TCLAP::ValueArg<int> pipelineStagesArg("", "pipeline-stages", "Number of pipeline stages for pipelined prediction.", false, (int)std::max<unsigned>(2, std::thread::hardware_concurrency()), "int", cmd);
+        TCLAP::ValueArg<int> numClientsArg("", "clients", "Number of concurrent clients submitting requests.", false, 8, "int", cmd);
+        TCLAP::ValueArg<int> numRequestsArg("", "requests", "Number of requests per client.", false, 200, "int", cmd);
+        TCLAP::ValueArg<float> windowArg("", "window", "Batch window in milliseconds.", false, 2.f, "float", cmd);
+        TCLAP::ValueArg<float> latencyArg("", "latency", "Latency target in milliseconds.", false, 10.f, "float", cmd);
+        TCLAP::ValueArg<int> trainCascadesArg("", "train-num-cascades", "Number of cascades when training synthetic tracker.", false, 10, "int", cmd);
+        TCLAP::ValueArg<int> trainTreesArg("", "train-num-trees", "Number of trees per cascade when training synthetic tracker.", false, 100, "int", cmd);
+
+        TCLAP::ValueArg<int> trainDepthArg("", "train-tree-depth", "Maximum tree depth when training synthetic tracker.", false, 5, "int", cmd);
+        TCLAP::ValueArg<int> trainPixelsArg("", "train-num-pixels", "Number of random pixel coordinates when training synthetic tracker.", false, 400, "int", cmd);
+        TCLAP::ValueArg<float> lazyCostArg("", "lazy-cost", "Cost of sampling a pixel lazily relative to bulk sampling for automatic sampling. Measured if omitted.", false, dest::core::Regressor::DefaultLazySamplingCost, "float", cmd);
+        TCLAP::SwitchArg compareSplitsArg("", "compare-split-selection", "Compare training time and held-out error of random and correlation split selection when training synthetic tracker.", cmd, false);
+        TCLAP::ValueArg<float> comparePyramidArg("", "compare-pyramid-sampling", "Compare prediction time and held-out error of trackers trained without and with pyramid sampling at the given samples per lambda.", false, 0.f, "float", cmd);
+        TCLAP::SwitchArg perfArg("", "perf-counters", "Report hardware performance counters per face. Counters of OpenMP workers in batched prediction are not included.", cmd, false);
+
+        cmd.parse(argc, argv);
+
+        opts.tracker = trackerArg.getValue();
+        opts.numImages = std::max<int>(1, numImagesArg.getValue());
+        opts.imageSize = imageSizeArg.getValue();
+        opts.batchSize = batchSizeArg.getValue();
+        opts.pipelineStages = std::max<int>(1, pipelineStagesArg.getValue());
+        opts.batchSizeSet = batchSizeArg.isSet();
+        opts.pipelineStagesSet = pipelineStagesArg.isSet();
+        opts.numClients = std::max<int>(1, numClientsArg.getValue());
+        opts.numRequests = numRequestsArg.getValue();
+        opts.windowMs = windowArg.getValue();
+        opts.latencyMs = latencyArg.getValue();
+        opts.trainCascades = trainCascadesArg.getValue();
+        opts.trainTrees = trainTreesArg.getValue();
+        opts.trainDepth = trainDepthArg.getValue();
+        opts.trainPixels = trainPixelsArg.getValue();
+        opts.perfCounters = perfArg.getValue();
+        opts.compareSplits = compareSplitsArg.getValue();
+        opts.comparePyramidSamples = comparePyramidArg.getValue();
+        opts.lazyCost = lazyCostArg.getValue();
+        opts.lazyCostSet = lazyCostArg.isSet();
+    }
+    catch (TCLAP::ArgException &e) {
+        std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+
+    dest::core::InputData inputs;
+    inputs.rnd.seed(10);
+    dest::util::createSyntheticInputData(opts.numImages, opts.imageSize, inputs.rnd, inputs);
+    dest::core::InputData::normalizeShapes(inputs);
+
+    if (opts.perfCounters) {
+        if (!dest::util::perfCountersAvailable()) {
+            std::cout << "Hardware performance counters not available, reporting timings only." << std::endl;
+        }
+        dest::util::setPerfCountersEnabled(true);
+    }
+
+    dest::core::Tracker t;
+    if (!opts.tracker.empty()) {
+        if (!t.load(opts.tracker)) {
+            std::cerr << "Failed to load tracker." << std::endl;
+            return -1;
+        }
+
+        // Runtime profile written by dest_autotune, explicit arguments take precedence.
+        dest::core::RuntimeProfile profile;
+        if (dest::core::loadRuntimeProfile(dest::core::runtimeProfilePath(opts.tracker), profile)) {
+            std::cout << "Using runtime profile " << dest::core::runtimeProfilePath(opts.tracker) << std::endl;
+            dest::core::applyRuntimeProfile(profile, t);
+            if (!opts.batchSizeSet)
+                opts.batchSize = profile.batchSize;
+            if (!opts.pipelineStagesSet)
+                opts.pipelineStages = profile.pipelineStages;
+        }
+    } else {
+        dest::core::SampleData td(inputs);
+        td.params.numCascades = opts.trainCascades;
+        td.params.numTrees = opts.trainTrees;
+        td.params.maxTreeDepth = opts.trainDepth;
+        td.params.numRandomPixelCoordinates = opts.trainPixels;
+
+        if (opts.compareSplits || opts.comparePyramidSamples > 0.f) {
+            dest::core::InputData heldOut;
+            heldOut.rnd.seed(20);
+            dest::util::createSyntheticInputData(std::max<int>(1, opts.numImages / 4), opts.imageSize, heldOut.rnd, heldOut);
+            dest::core::InputData::normalizeShapes(heldOut);
+
+            if (opts.compareSplits)
+                compareSplitSelection(inputs, heldOut, td.params);
+            if (opts.comparePyramidSamples > 0.f)
+                comparePyramidSampling(inputs, heldOut, td.params, opts.comparePyramidSamples);
+        }
+
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 5;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+
+        t.fit(td);
+    }
+
+    if (opts.perfCounters) {
+        if (dest::util::perfStats(dest::util::PERF_PHASE_FIT).numScopes > 0) {
+            std::cout << "Training performance" << std::endl << dest::util::perfStats(dest::util::PERF_PHASE_FIT);
+        }
+        dest::util::resetPerfStats();
+    }
+
+    const size_t numFaces = inputs.images.size();
+
+    // Single, comparing pixel sampling strategies. Auto is last and remains active.
+    if (!opts.lazyCostSet) {
+        opts.lazyCost = dest::core::measureLazySamplingCost();
+    }
+    std::cout << std::setw(40) << std::left << "Relative lazy sampling cost" << opts.lazyCost
+              << (opts.lazyCostSet ? "" : " (measured)") << std::endl;
+    t.setLazySamplingCost(opts.lazyCost);
+
+    const dest::core::SamplingStrategy strategies[] = { dest::core::SAMPLING_EAGER, dest::core::SAMPLING_LAZY, dest::core::SAMPLING_AUTO };
+    const char *strategyNames[] = { "eager", "lazy", "auto" };
+
+    std::vector<dest::core::Shape> shapes(numFaces);
+    std::stringstream name;
+    Clock::time_point start;
+    for (int s = 0; s < 3; ++s) {
+        t.setSamplingStrategy(strategies[s]);
+
+        start = Clock::now();
+        for (size_t i = 0; i < numFaces; ++i) {
+            shapes[i] = t.predict(inputs.images[i], inputs.shapeToImage[i]);
+        }
+
+        name.str("");
+        name << "Single predict (" << strategyNames[s] << " sampling)";
+        report(name.str(), elapsedMs(start), numFaces);
+    }
+    std::cout << std::setw(40) << std::left << "Lazy sampling cascades (auto)" << t.numLazySamplingCascades() << "/" << t.numCascades() << std::endl;
+
+    // Batched
+    std::vector<dest::core::MappedImage> imgs;
+    for (size_t i = 0; i < numFaces; ++i) {
+        const dest::core::Image &img = inputs.images[i];
+        imgs.push_back(dest::core::MappedImage(img.data(), img.rows(), img.cols(), Eigen::OuterStride<Eigen::Dynamic>(img.cols())));
+    }
+
+    start = Clock::now();
+    for (size_t i = 0; i < numFaces; i += opts.batchSize) {
+        const size_t end = std::min<size_t>(numFaces, i + opts.batchSize);
+        std::vector<dest::core::MappedImage> batchImgs(imgs.begin() + i, imgs.begin() + end);
+        std::vector<dest::core::ShapeTransform> batchTransforms(inputs.shapeToImage.begin() + i, inputs.shapeToImage.begin() + end);
+        std::vector<dest::core::Shape> batchShapes;
+        t.predict(batchImgs, batchTransforms, batchShapes);
+    }
+    name.str("");
+    name << "Batched predict (" << opts.batchSize << ")";
+    report(name.str(), elapsedMs(start), numFaces);
+
+    // Pipelined
+    {
+        dest::core::PipelineParameters pp;
+        pp.numStages = opts.pipelineStages;
+
+        dest::core::PipelinedTracker pt(t, pp);
+        std::vector< std::future<dest::core::Shape> > results;
+        results.reserve(numFaces);
+
+        start = Clock::now();
+        for (size_t i = 0; i < numFaces; ++i) {
+            results.push_back(pt.submit(inputs.images[i], inputs.shapeToImage[i]));
+        }
+        for (size_t i = 0; i < numFaces; ++i) {
+            results[i].get();
+        }
+
+        name.str("");
+        name << "Pipelined predict (" << pt.numStages() << " stages)";
+        report(name.str(), elapsedMs(start), numFaces);
+    }
+
+    // Coalesced with concurrent clients
+    dest::core::CoalescerParameters cp;
+    cp.maxBatchSize = opts.batchSize;
+    cp.batchWindowMs = opts.windowMs;
+    cp.latencyTargetMs = opts.latencyMs;
+
+    std::vector< std::vector<double> > latencies(opts.numClients);
+    dest::core::CoalescerStats stats;
+    {
+        dest::core::RequestCoalescer rc(t, cp);
+
+        start = Clock::now();
+        std::vector<std::thread> clients;
+        for (int c = 0; c < opts.numClients; ++c) {
+            clients.push_back(std::thread([&, c]() {
+                for (int r = 0; r < opts.numRequests; ++r) {
+                    const size_t idx = (c * opts.numRequests + r) % numFaces;
+                    Clock::time_point submitted = Clock::now();
+                    rc.submit(inputs.images[idx], inputs.shapeToImage[idx]).get();
+                    latencies[c].push_back(elapsedMs(submitted));
+                }
+            }));
+        }
+        for (size_t c = 0; c < clients.size(); ++c) {
+            clients[c].join();
+        }
+        stats = rc.stats();
+    }
+    const double coalescedMs = elapsedMs(start);
+
+    std::vector<double> all;
+    for (size_t c = 0; c < latencies.size(); ++c) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    }
+    std::sort(all.begin(), all.end());
+
+    name.str("");
+    name << "Coalesced predict (" << opts.numClients << " clients)";
+    report(name.str(), coalescedMs, all.size());
+
+    std::cout << std::setprecision(2)
+              << std::setw(40) << std::left << "Coalesced latency p50 (ms)" << all[all.size() / 2] << std::endl
+              << std::setw(40) << std::left << "Coalesced latency p99 (ms)" << all[(all.size() * 99) / 100] << std::endl
+              << std::setw(40) << std::left << "Coalesced average batch size" << (double)stats.numRequests / std::max<size_t>(1, stats.numBatches) << std::endl
+              << std::setw(40) << std::left << "Coalesced final batch size limit" << stats.batchSizeLimit << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,351 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/dest.h>
+#include <dest/face/detection_scheduler.h>
+#include <dest/util/synthetic.h>
+#include <tclap/CmdLine.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+inline double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/** Detection cadence of a run. */
+enum DetectMode {
+    DETECT_EVERY_FRAME,
+    DETECT_FIXED,
+    DETECT_ADAPTIVE
+};
+
+/** Counters and measurements of a single run over the video. */
+struct RunResult {
+    std::vector<double> latencies;
+    std::vector<float> errors;
+    int numDetections;
+    int numMissedFrames;
+    int numStaleFrames;
+
+    RunResult() : numDetections(0), numMissedFrames(0), numStaleFrames(0) {}
+};
+
+/**
+    Stand-in for a face detector reporting jittered ground truth bounds.
+
+    Running time is simulated by sleeping, so that detector cost shows up in frame latency
+    without depending on OpenCV.
+*/
+class MockDetector {
+public:
+    MockDetector(const dest::util::SyntheticVideo &video, float noise, float costMs)
+        :_video(video), _noise(noise), _costMs(costMs), _rnd(20)
+    {}
+
+    bool detect(int frame, dest::core::Rect &r) {
+        if (_costMs > 0.f)
+            std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(_costMs));
+
+        if (!_video.faceVisible(frame))
+            return false;
+
+        r = dest::core::shapeBounds(_video.shape(frame));
+
+        std::normal_distribution<float> n(0.f, _noise);
+        const float size = (r.col(3) - r.col(0)).norm();
+        const Eigen::Vector2f center = r.rowwise().mean();
+        const Eigen::Vector2f offset(n(_rnd) * size, n(_rnd) * size);
+        const float scale = 1.f + n(_rnd);
+
+        r = ((r.colwise() - center) * scale).colwise() + (center + offset);
+        return true;
+    }
+
+private:
+    const dest::util::SyntheticVideo &_video;
+    float _noise;
+    float _costMs;
+    std::mt19937 _rnd;
+};
+
+/**
+    Run the detect / track loop of dest_track_video on the synthetic video.
+*/
+RunResult run(const dest::core::Tracker &t, const dest::util::SyntheticVideo &video, DetectMode mode,
+              const dest::face::DetectionSchedulerParameters &schedulerParams, bool incremental,
+              float detectNoise, float detectMs)
+{
+    RunResult result;
+    MockDetector detector(video, detectNoise, detectMs);
+    dest::face::DetectionScheduler scheduler(schedulerParams);
+
+    dest::core::Image img, prevImg;
+    dest::core::Rect r;
+    dest::core::Shape s;
+    dest::core::TrackState trackState;
+    bool detectSuccess = false;
+
+    for (int frame = 0; frame < video.numFrames(); ++frame) {
+        const bool visible = video.render(frame, img);
+
+        Clock::time_point start = Clock::now();
+
+        bool isDetectFrame = true;
+        if (mode == DETECT_FIXED) {
+            isDetectFrame = (frame % schedulerParams.baseInterval == 0);
+        } else if (mode == DETECT_ADAPTIVE) {
+            float motion = 0.f;
+            if (prevImg.size() > 0) {
+                motion = dest::face::DetectionScheduler::measureMotion(prevImg, img);
+            }
+            isDetectFrame = scheduler.shouldDetect(motion);
+        }
+
+        if (isDetectFrame) {
+            ++result.numDetections;
+
+            if (detector.detect(frame, r)) {
+                const dest::core::ShapeTransform shapeToImage = dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), r);
+                s = incremental ? t.predict(img, shapeToImage, trackState) : t.predict(img, shapeToImage);
+                detectSuccess = true;
+            } else {
+                detectSuccess = false;
+                trackState.reset();
+            }
+
+            if (mode == DETECT_ADAPTIVE) {
+                scheduler.reportDetection(detectSuccess);
+            }
+        } else if (detectSuccess) {
+            r = dest::core::shapeBounds(s);
+            const dest::core::ShapeTransform shapeToImage = dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), r);
+            const dest::core::Shape prev = s;
+            s = incremental ? t.predict(img, shapeToImage, trackState) : t.predict(img, shapeToImage);
+
+            if (mode == DETECT_ADAPTIVE) {
+                // Landmark jitter relative to face size as uncertainty of the track.
+                const float size = (r.col(3) - r.col(0)).norm();
+                scheduler.reportTrack((s - prev).colwise().norm().mean() / std::max<float>(size, 1.f));
+            }
+        }
+
+        result.latencies.push_back(elapsedMs(start));
+
+        if (mode == DETECT_ADAPTIVE) {
+            std::swap(prevImg, img);
+        }
+
+        // Error relative to the ground truth bounds diagonal.
+        if (visible && detectSuccess) {
+            const dest::core::Shape gt = video.shape(frame);
+            const dest::core::Rect gtr = dest::core::shapeBounds(gt);
+            result.errors.push_back((s - gt).colwise().norm().mean() / (gtr.col(3) - gtr.col(0)).norm());
+        } else if (visible) {
+            ++result.numMissedFrames;
+        } else if (detectSuccess) {
+            ++result.numStaleFrames;
+        }
+    }
+
+    return result;
+}
+
+template<class T>
+T percentile(const std::vector<T> &sorted, double p) {
+    if (sorted.empty())
+        return T(0);
+    const size_t idx = std::min<size_t>(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return sorted[idx];
+}
+
+void report(const std::string &name, RunResult &r) {
+    std::sort(r.latencies.begin(), r.latencies.end());
+    std::sort(r.errors.begin(), r.errors.end());
+
+    double totalMs = 0;
+    for (size_t i = 0; i < r.latencies.size(); ++i)
+        totalMs += r.latencies[i];
+
+    double meanError = 0;
+    for (size_t i = 0; i < r.errors.size(); ++i)
+        meanError += r.errors[i];
+    meanError /= std::max<size_t>(1, r.errors.size());
+
+    std::cout << std::setw(20) << std::left << name
+              << std::setw(10) << std::right << std::fixed << std::setprecision(2) << percentile(r.latencies, 0.5)
+              << std::setw(10) << percentile(r.latencies, 0.9)
+              << std::setw(10) << percentile(r.latencies, 0.99)
+              << std::setw(10) << r.latencies.back()
+              << std::setw(10) << std::setprecision(0) << r.latencies.size() / (totalMs * 0.001)
+              << std::setw(10) << r.numDetections
+              << std::setw(10) << std::setprecision(4) << meanError
+              << std::setw(10) << percentile(r.errors, 0.9)
+              << std::setw(10) << r.numMissedFrames
+              << std::setw(10) << r.numStaleFrames << std::endl;
+}
+
+/**
+    Benchmark the detect / track loop on a synthetic video.
+
+    Renders a video of a synthetic face moving, rotating and scaling over a textured background
+    with known landmark trajectories (see dest::util::SyntheticVideo) and runs the detect / track loop
+    of dest_track_video headlessly. A mock detector reports jittered ground truth bounds and simulates
+    detector cost. Detection on every frame, on every n-th frame and adaptive detection via
+    dest::face::DetectionScheduler are compared by frame latency percentiles, detector invocations
+    and tracking error versus ground truth.
+
+    When no tracker is given, a tracker is trained on synthetic faces first. Note that
+    a tracker loaded from file is evaluated on synthetic faces as well, so only timings
+    are meaningful in this case.
+*/
+int main(int argc, char **argv)
+{
+    struct {
+        std::string tracker;
+        dest::util::SyntheticVideoParameters video;
+        int detectRate;
+        int maxDetectRate;
+        float detectMs;
+        float detectNoise;
+        bool incremental;
+        int trainImages;
+        int trainCascades;
+        int trainTrees;
+        int trainDepth;
+        int trainPixels;
+    } opts;
+
+    try {
+        TCLAP::CmdLine cmd("Benchmark the detect / track loop on a synthetic video.", ' ', "0.9");
+
+        TCLAP::ValueArg<std::string> trackerArg("t", "tracker", "Trained tracker to load. If omitted a tracker is trained on synthetic faces.", false, "", "file", cmd);
+        TCLAP::ValueArg<int> widthArg("", "width", "Frame width.", false, opts.video.width, "int", cmd);
+        TCLAP::ValueArg<int> heightArg("", "height", "Frame height.", false, opts.video.height, "int", cmd);
+        TCLAP::ValueArg<int> numFramesArg("", "num-frames", "Number of frames.", false, opts.video.numFrames, "int", cmd);
+        TCLAP::ValueArg<float> faceSizeArg("", "face-size", "Face size as fraction of the smaller frame dimension.", false, opts.video.faceSize, "float", cmd);
+        TCLAP::ValueArg<float> maxSpeedArg("", "max-speed", "Peak face translation in pixels per frame.", false, opts.video.maxSpeed, "float", cmd);
+        TCLAP::ValueArg<int> visibleFramesArg("", "visible-frames", "Number of consecutive frames the face is visible.", false, opts.video.visibleFrames, "int", cmd);
+        TCLAP::ValueArg<int> hiddenFramesArg("", "hidden-frames", "Number of consecutive frames without face following visible frames.", false, opts.video.hiddenFrames, "int", cmd);
+        TCLAP::ValueArg<float> noiseArg("", "noise", "Standard deviation of per-frame intensity noise.", false, opts.video.noise, "float", cmd);
+        TCLAP::ValueArg<int> detectRateArg("", "detect-rate", "Use detector in every n-th frame. Used while tracking confidently in adaptive mode.", false, 5, "int", cmd);
+        TCLAP::ValueArg<int> maxDetectRateArg("", "max-detect-rate", "Maximum number of frames between detections when no face is present in adaptive mode.", false, 120, "int", cmd);
+        TCLAP::ValueArg<float> detectMsArg("", "detect-ms", "Simulated detector cost in milliseconds.", false, 20.f, "float", cmd);
+        TCLAP::ValueArg<float> detectNoiseArg("", "detect-noise", "Detector jitter as fraction of face size.", false, 0.03f, "float", cmd);
+        TCLAP::SwitchArg incrementalArg("", "incremental", "Re-evaluate only trees whose split decisions may have changed since the previous frame.", cmd, false);
+        TCLAP::ValueArg<int> trainImagesArg("", "train-num-images", "Number of synthetic images when training synthetic tracker.", false, 256, "int", cmd);
+        TCLAP::ValueArg<int> trainCascadesArg("", "train-num-cascades", "Number of cascades when training synthetic tracker.", false, 10, "int", cmd);
+        TCLAP::ValueArg<int> trainTreesArg("", "train-num-trees", "Number of trees per cascade when training synthetic tracker.", false, 100, "int", cmd);
+        TCLAP::ValueArg<int> trainDepthArg("", "train-tree-depth", "Maximum tree depth when training synthetic tracker.", false, 5, "int", cmd);
+        TCLAP::ValueArg<int> trainPixelsArg("", "train-num-pixels", "Number of random pixel coordinates when training synthetic tracker.", false, 400, "int", cmd);
+
+        cmd.parse(argc, argv);
+
+        opts.tracker = trackerArg.getValue();
+        opts.video.width = std::max<int>(1, widthArg.getValue());
+        opts.video.height = std::max<int>(1, heightArg.getValue());
+        opts.video.numFrames = std::max<int>(1, numFramesArg.getValue());
+        opts.video.faceSize = faceSizeArg.getValue();
+        opts.video.maxSpeed = maxSpeedArg.getValue();
+        opts.video.visibleFrames = visibleFramesArg.getValue();
+        opts.video.hiddenFrames = hiddenFramesArg.getValue();
+        opts.video.noise = noiseArg.getValue();
+        opts.detectRate = std::max<int>(1, detectRateArg.getValue());
+        opts.maxDetectRate = maxDetectRateArg.getValue();
+        opts.detectMs = detectMsArg.getValue();
+        opts.detectNoise = detectNoiseArg.getValue();
+        opts.incremental = incrementalArg.getValue();
+        opts.trainImages = std::max<int>(1, trainImagesArg.getValue());
+        opts.trainCascades = trainCascadesArg.getValue();
+        opts.trainTrees = trainTreesArg.getValue();
+        opts.trainDepth = trainDepthArg.getValue();
+        opts.trainPixels = trainPixelsArg.getValue();
+    }
+    catch (TCLAP::ArgException &e) {
+        std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+
+    dest::core::Tracker t;
+    if (!opts.tracker.empty()) {
+        if (!t.load(opts.tracker)) {
+            std::cerr << "Failed to load tracker." << std::endl;
+            return -1;
+        }
+
+        // Apply runtime profile written by dest_autotune if present.
+        dest::core::RuntimeProfile profile;
+        if (dest::core::loadRuntimeProfile(dest::core::runtimeProfilePath(opts.tracker), profile)) {
+            std::cout << "Using runtime profile " << dest::core::runtimeProfilePath(opts.tracker) << std::endl;
+            dest::core::applyRuntimeProfile(profile, t);
+        }
+    } else {
+        dest::core::InputData inputs;
+        inputs.rnd.seed(10);
+        dest::util::createSyntheticInputData(opts.trainImages, 128, inputs.rnd, inputs);
+        dest::core::InputData::normalizeShapes(inputs);
+
+        dest::core::SampleData td(inputs);
+        td.params.numCascades = opts.trainCascades;
+        td.params.numTrees = opts.trainTrees;
+        td.params.maxTreeDepth = opts.trainDepth;
+        td.params.numRandomPixelCoordinates = opts.trainPixels;
+
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 5;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+
+        t.fit(td);
+    }
+
+    dest::util::SyntheticVideo video(opts.video);
+
+    dest::face::DetectionSchedulerParameters schedulerParams;
+    schedulerParams.baseInterval = opts.detectRate;
+    schedulerParams.maxInterval = opts.maxDetectRate;
+
+    std::cout << std::setw(20) << std::left << "Mode"
+              << std::setw(10) << std::right << "p50 ms"
+              << std::setw(10) << "p90 ms"
+              << std::setw(10) << "p99 ms"
+              << std::setw(10) << "max ms"
+              << std::setw(10) << "fps"
+              << std::setw(10) << "detects"
+              << std::setw(10) << "error"
+              << std::setw(10) << "p90 err"
+              << std::setw(10) << "missed"
+              << std::setw(10) << "stale" << std::endl;
+
+    const DetectMode modes[] = { DETECT_EVERY_FRAME, DETECT_FIXED, DETECT_ADAPTIVE };
+    const char *modeNames[] = { "every frame", "fixed", "adaptive" };
+
+    std::stringstream name;
+    for (int m = 0; m < 3; ++m) {
+        RunResult r = run(t, video, modes[m], schedulerParams, opts.incremental, opts.detectNoise, opts.detectMs);
+
+        name.str("");
+        name << modeNames[m];
+        if (modes[m] != DETECT_EVERY_FRAME)
+            name << " (" << opts.detectRate << ")";
+        report(name.str(), r);
+    }
+
+    std::cout << std::endl
+              << "Error is the mean landmark distance relative to the face diagonal on frames with a face and a track." << std::endl
+              << "Missed counts frames with a face but no track, stale counts frames tracked without a face." << std::endl;
+
+    return 0;
+}
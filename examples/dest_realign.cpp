@@ -0,0 +1,210 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/dest.h>
+#include <dest/core/autotune.h>
+#include <dest/io/jpeg_io.h>
+#include <dest/io/rect_io.h>
+#include <dest/util/glob.h>
+#include <tclap/CmdLine.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+typedef std::chrono::steady_clock Clock;
+
+/** Read image paths either from a list file, one path per line, or from a directory. */
+bool findImages(const std::string &path, std::vector<std::string> &images)
+{
+    images.clear();
+
+    if (path.size() > 4 && path.substr(path.size() - 4) == ".txt") {
+        std::ifstream ifs(path.c_str());
+        if (!ifs.is_open())
+            return false;
+
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (!line.empty())
+                images.push_back(line);
+        }
+    } else {
+        std::vector<std::string> extensions;
+        extensions.push_back("jpg");
+        extensions.push_back("jpeg");
+        extensions.push_back("JPG");
+        extensions.push_back("JPEG");
+        images = dest::util::findFilesInDir(path, extensions, false, false);
+    }
+
+    return !images.empty();
+}
+
+/**
+    Re-align faces in JPEG photos from previously stored face rectangles.
+
+    Instead of decoding entire photos, only the region each face's landmarks are sampled
+    from is decoded, optionally at reduced scale. Use this tool to run a new tracker over
+    archived photos whose face rectangles are known, for example from dest_gen_rects.
+
+    Faces are decoded in chunks of the batch size of the tracker's runtime profile, written by
+    dest_autotune, and predicted with the profile's engine.
+
+    Rectangles are matched to images by order. Landmarks are written one row per image,
+    x coordinates followed by y coordinates separated by spaces. Images with empty
+    rectangles or failing to decode produce rows of zeros.
+*/
+int main(int argc, char **argv)
+{
+    struct {
+        std::string tracker;
+        std::string rectangles;
+        std::string images;
+        std::string output;
+        dest::io::JpegRealignParameters params;
+    } opts;
+
+    try {
+        TCLAP::CmdLine cmd("Re-align faces in JPEG photos decoding only face regions.", ' ', "0.9");
+
+        TCLAP::ValueArg<std::string> trackerArg("t", "tracker", "Trained tracker to load.", true, "dest.bin", "file", cmd);
+        TCLAP::ValueArg<std::string> rectsArg("r", "rectangles", "Face rectangles, one per image.", true, "rectangles.csv", "file", cmd);
+        TCLAP::ValueArg<std::string> outputArg("o", "output", "CSV landmarks output file.", false, "landmarks.csv", "file", cmd);
+        TCLAP::ValueArg<float> footprintArg("", "footprint-scale", "Extent of decoded region as multiple of mean shape bounds.", false, opts.params.footprintScale, "float", cmd);
+        TCLAP::ValueArg<int> scaleArg("", "scale-denom", "Decode at 1/N resolution. One of 1, 2, 4, 8 or 0 for automatic.", false, opts.params.scaleDenom, "int", cmd);
+        TCLAP::ValueArg<int> minFaceSizeArg("", "min-face-size", "Minimum decoded face width in pixels for automatic scale.", false, opts.params.minFaceSize, "int", cmd);
+        TCLAP::UnlabeledValueArg<std::string> imagesArg("images", "Directory of JPEG images or text file listing one image per line.", true, "images.txt", "path", cmd);
+
+        cmd.parse(argc, argv);
+
+        opts.tracker = trackerArg.getValue();
+        opts.rectangles = rectsArg.getValue();
+        opts.output = outputArg.getValue();
+        opts.images = imagesArg.getValue();
+        opts.params.footprintScale = footprintArg.getValue();
+        opts.params.scaleDenom = scaleArg.getValue();
+        opts.params.minFaceSize = minFaceSizeArg.getValue();
+    }
+    catch (TCLAP::ArgException &e) {
+        std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return -1;
+    }
+
+    dest::core::Tracker t;
+    if (!t.load(opts.tracker)) {
+        std::cerr << "Failed to load tracker." << std::endl;
+        return -1;
+    }
+
+    // Apply runtime profile written by dest_autotune if present.
+    dest::core::RuntimeProfile profile;
+    if (dest::core::loadRuntimeProfile(dest::core::runtimeProfilePath(opts.tracker), profile)) {
+        std::cout << "Using runtime profile " << dest::core::runtimeProfilePath(opts.tracker) << std::endl;
+        dest::core::applyRuntimeProfile(profile, t);
+    }
+
+    std::vector<dest::core::Rect> rects;
+    if (!dest::io::importRectangles(opts.rectangles, rects)) {
+        std::cerr << "Failed to load rectangles." << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> images;
+    if (!findImages(opts.images, images)) {
+        std::cerr << "Failed to find images." << std::endl;
+        return -1;
+    }
+
+    if (images.size() != rects.size()) {
+        std::cerr << "Number of images " << images.size() << " does not match number of rectangles " << rects.size() << "." << std::endl;
+        return -1;
+    }
+
+    std::ofstream ofs(opts.output.c_str());
+    if (!ofs.is_open()) {
+        std::cerr << "Failed to open output file." << std::endl;
+        return -1;
+    }
+
+    std::cout << opts.params << std::endl;
+
+    const Eigen::IOFormat csvFormat(Eigen::StreamPrecision, Eigen::DontAlignCols, " ", " ");
+    const dest::core::Shape zero = dest::core::Shape::Zero(2, t.meanShape().cols());
+
+    size_t numAligned = 0;
+    double decodedPixels = 0, imagePixels = 0;
+    Clock::time_point start = Clock::now();
+
+    // Engine is kept alive across chunks, pipeline threads are started once.
+    dest::core::ProfiledPredictor predictor(profile, t);
+
+    const size_t chunkSize = static_cast<size_t>(std::max<int>(1, profile.batchSize));
+    std::vector<dest::io::JpegRegion> regions;
+    std::vector<bool> decoded;
+    std::vector<dest::core::MappedImage> imgs;
+    std::vector<dest::core::ShapeTransform> shapeToRegion;
+    std::vector<dest::core::Shape> shapes;
+
+    for (size_t first = 0; first < images.size(); first += chunkSize) {
+        const size_t last = std::min<size_t>(images.size(), first + chunkSize);
+
+        // Decode footprints of all faces in chunk.
+        regions.assign(last - first, dest::io::JpegRegion());
+        decoded.assign(last - first, false);
+        imgs.clear();
+        shapeToRegion.clear();
+        for (size_t i = first; i < last; ++i) {
+            dest::io::JpegRegion &region = regions[i - first];
+            dest::core::ShapeTransform tr;
+
+            if (rects[i].isZero())
+                continue;
+
+            if (!dest::io::decodeJpegFootprint(t, images[i], rects[i], opts.params, region, tr)) {
+                std::cerr << "Failed to re-align " << images[i] << std::endl;
+                continue;
+            }
+
+            decoded[i - first] = true;
+            imgs.push_back(dest::core::MappedImage(region.image.data(), region.image.rows(), region.image.cols(), Eigen::OuterStride<Eigen::Dynamic>(region.image.cols())));
+            shapeToRegion.push_back(tr);
+        }
+
+        predictor.predict(imgs, shapeToRegion, shapes);
+
+        size_t k = 0;
+        for (size_t i = first; i < last; ++i) {
+            const dest::io::JpegRegion &region = regions[i - first];
+            if (decoded[i - first]) {
+                const dest::core::Shape s = region.imageToRegion().inverse() * shapes[k++].colwise().homogeneous();
+                ++numAligned;
+                decodedPixels += static_cast<double>(region.image.size()) * region.scaleDenom * region.scaleDenom;
+                imagePixels += static_cast<double>(region.imageWidth) * region.imageHeight;
+                ofs << s.format(csvFormat) << std::endl;
+            } else {
+                ofs << zero.format(csvFormat) << std::endl;
+            }
+        }
+
+        std::cout << "Processing " << last << "\r" << std::flush;
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << "Re-aligned " << numAligned << " of " << images.size() << " images in " << ms << " ms";
+    if (numAligned > 0) {
+        std::cout << " (" << ms / numAligned << " ms per image, decoded "
+                  << 100.0 * decodedPixels / imagePixels << "% of image area)";
+    }
+    std::cout << std::endl;
+
+    return 0;
+}
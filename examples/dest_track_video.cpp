@@ -13,18 +13,22 @@ of the BSD license.See the LICENSE file for details.
 #include <tclap/CmdLine.h>
 
 #include <dest/face/face_detector.h>
+#include <dest/face/detection_scheduler.h>
 #include <dest/util/draw.h>
 #include <dest/util/convert.h>
 #include <random>
+#include <algorithm>
 
 
 /**
     Track on video sequence.
 
-    This tool supports two operation modes. 
+    This tool supports three operation modes. 
         - Use face-detector then tracker on every frame (accurate but slow as face detector is the slowest component, 60ms in total per frame).
         - Use face-detector only every n-th frame. 
           In between detector frames, a combination of tracker and mock face-detector (fast 4ms in total per frame) is used.
+        - Adapt the detection cadence to the scene. Back off when no face is present, snap back on global motion
+          and detect more often while tracks are uncertain.
 
     This application uses OpenCV capture device to open the input device. As such it supports web cams and video files.
     During execution press any key except 'x' to trigger a new face detection.
@@ -40,6 +44,9 @@ int main(int argc, char **argv)
         int detectRate;
         bool drawRect;
         float imageScale;
+        bool incremental;
+        bool adaptiveDetect;
+        int maxDetectRate;
     } opts;
     
     try {
@@ -50,7 +57,10 @@ int main(int argc, char **argv)
         TCLAP::ValueArg<float> imageScaleArg("", "image-scale", "Scale factor to be applied to input image.", false, 1.f, "float", cmd);
         TCLAP::UnlabeledValueArg<std::string> deviceArg("device", "Device to be opened. Either filename of video or camera device id.", true, "0", "string", cmd);
         TCLAP::SwitchArg drawRectArg("", "draw-rect", "Draw face detector rectangle", cmd, false);
+        TCLAP::SwitchArg incrementalArg("", "incremental", "Re-evaluate only trees whose split decisions may have changed since the previous frame.", cmd, false);
         TCLAP::ValueArg<int> detectInNthFrameArg("", "detect-rate", "Use detector in every n-th frame. If false tries to mimick detector for fast tracking.", false, 5, "int", cmd);
+        TCLAP::SwitchArg adaptiveDetectArg("", "adaptive-detect", "Adapt detection rate to scene state. --detect-rate is used while tracking confidently.", cmd, false);
+        TCLAP::ValueArg<int> maxDetectRateArg("", "max-detect-rate", "Maximum number of frames between detections when no face is present in adaptive mode.", false, 120, "int", cmd);
         
         cmd.parse(argc, argv);
         
@@ -60,6 +70,9 @@ int main(int argc, char **argv)
         opts.detectRate = detectInNthFrameArg.getValue();
         opts.drawRect = drawRectArg.getValue();
         opts.imageScale = imageScaleArg.getValue();
+        opts.incremental = incrementalArg.getValue();
+        opts.adaptiveDetect = adaptiveDetectArg.getValue();
+        opts.maxDetectRate = maxDetectRateArg.getValue();
     }
     catch (TCLAP::ArgException &e) {
         std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
@@ -71,6 +84,12 @@ int main(int argc, char **argv)
         std::cerr << "Failed to load tracker." << std::endl;
         return -1;
     }
+
+    // Apply runtime profile written by dest_autotune if present.
+    dest::core::RuntimeProfile profile;
+    if (dest::core::loadRuntimeProfile(dest::core::runtimeProfilePath(opts.tracker), profile)) {
+        dest::core::applyRuntimeProfile(profile, t);
+    }
       
     dest::face::FaceDetector fd;
     if (!fd.loadClassifiers(opts.detector)) {
@@ -100,11 +119,17 @@ int main(int argc, char **argv)
     float txToCV = -0.01f; // Translation in x normalized by image width
     float tyToCV = -0.05f; // Translation in y normalized by image height
     
-    cv::Mat imgCV, imgCVScaled, grayCV;
+    dest::face::DetectionSchedulerParameters schedulerParams;
+    schedulerParams.baseInterval = opts.detectRate;
+    schedulerParams.maxInterval = opts.maxDetectRate;
+    dest::face::DetectionScheduler scheduler(schedulerParams);
+
+    cv::Mat imgCV, imgCVScaled, grayCV, prevGrayCV;
     cv::Rect cvRect;
     dest::core::Rect r;
     dest::core::Shape s;
     dest::core::ShapeTransform shapeToImage;
+    dest::core::TrackState trackState;
     bool done = false;
     bool requestDetect = false;
     bool detectSuccess = false;
@@ -120,19 +145,35 @@ int main(int argc, char **argv)
         
         dest::core::MappedImage img = dest::util::toDestHeaderOnly(grayCV);
         
-        const bool isDetectFrame = (frameCount % opts.detectRate == 0);
+        bool isDetectFrame = (frameCount % opts.detectRate == 0);
+        if (opts.adaptiveDetect) {
+            float motion = 0.f;
+            if (!prevGrayCV.empty()) {
+                motion = dest::face::DetectionScheduler::measureMotion(dest::util::toDestHeaderOnly(prevGrayCV), img);
+            }
+            if (requestDetect) {
+                scheduler.requestDetection();
+            }
+            isDetectFrame = scheduler.shouldDetect(motion);
+            grayCV.copyTo(prevGrayCV);
+        }
 
         if (requestDetect || isDetectFrame) {
 
             if (fd.detectSingleFace(grayCV, cvRect)) {
                 dest::util::toDest(cvRect, r);
                 shapeToImage = dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), r);
-                s = t.predict(img, shapeToImage);
+                s = opts.incremental ? t.predict(img, shapeToImage, trackState) : t.predict(img, shapeToImage);
 
                 requestDetect = false;
                 detectSuccess = true;
             } else {
                 detectSuccess = false;
+                trackState.reset();
+            }
+
+            if (opts.adaptiveDetect) {
+                scheduler.reportDetection(detectSuccess);
             }
         }
 
@@ -150,7 +191,14 @@ int main(int argc, char **argv)
             r = tr * r.colwise().homogeneous();
 
             shapeToImage = dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), r);
-            s = t.predict(img, shapeToImage);
+            dest::core::Shape prev = s;
+            s = opts.incremental ? t.predict(img, shapeToImage, trackState) : t.predict(img, shapeToImage);
+
+            if (opts.adaptiveDetect) {
+                // Landmark jitter relative to face size as uncertainty of the track.
+                const float size = (r.col(3) - r.col(0)).norm();
+                scheduler.reportTrack((s - prev).colwise().norm().mean() / std::max<float>(size, 1.f));
+            }
         }
 
         dest::util::drawShape(imgCVScaled, s, cv::Scalar(255, 0, 102));
@@ -169,5 +217,9 @@ int main(int argc, char **argv)
         
     }
 
+    if (opts.adaptiveDetect) {
+        std::cout << scheduler.stats() << std::endl;
+    }
+
     return 0;
 }
@@ -29,6 +29,7 @@ int main(int argc, char **argv)
         std::string db;
         std::string rects;
         std::string output;
+        std::string fineTune;
         int randomSeed;
         bool showInitialSamples;
     } opts;
@@ -44,11 +45,18 @@ int main(int argc, char **argv)
         TCLAP::ValueArg<int> randomSeedArg("", "train-rnd-seed", "Seed for the random number generator", false, 10, "int", cmd);
         TCLAP::ValueArg<float> lambdaArg("", "train-lambda", "Prior that favors closer pixel coordinates.", false, 0.1f, "float", cmd);
         TCLAP::ValueArg<float> learnArg("", "train-learn", "Learning rate of each tree.", false, 0.08f, "float", cmd);
+        TCLAP::ValueArg<float> pyramidArg("", "train-pyramid-samples", "Pyramid samples per lambda. When positive, coarse cascades sample from downsampled images. 0 disables.", false, 0.f, "float", cmd);
+        std::vector<std::string> splitSelections;
+        splitSelections.push_back("random");
+        splitSelections.push_back("correlation");
+        TCLAP::ValuesConstraint<std::string> splitSelectionConstraint(splitSelections);
+        TCLAP::ValueArg<std::string> splitSelectionArg("", "train-split-selection", "How split candidates are proposed at each tree node.", false, "random", &splitSelectionConstraint, cmd);
         
         TCLAP::ValueArg<int> numShapesPerImageArg("", "create-num-shapes", "Number of shapes per image to create.", false, 20, "int", cmd);
         
         TCLAP::SwitchArg showInitialSamplesArg("", "show-samples", "Show generated samples", cmd, false);
         TCLAP::ValueArg<std::string> rectsArg("", "rectangles", "Initial detection rectangles to train on.", false, "rectangles.csv", "string", cmd);
+        TCLAP::ValueArg<std::string> fineTuneArg("", "fine-tune", "Adapt an existing tracker to the database by refitting leaf values only. Tree structures are kept and training parameters are ignored.", false, "", "file", cmd);
         TCLAP::ValueArg<std::string> outputArg("o", "output", "Trained regressor output.", false, "dest.bin", "string", cmd);
         TCLAP::ValueArg<int> maxImageSizeArg("", "load-max-size", "Maximum size of images in the database", false, 2048, "int", cmd);
         TCLAP::SwitchArg mirrorImageArg("", "load-mirrored", "Additionally mirror each database image, shape and rects.", cmd, false);
@@ -66,6 +74,8 @@ int main(int argc, char **argv)
         opts.trainingParams.numRandomSplitTestsPerNode = numSplitTestsArg.getValue();
         opts.trainingParams.exponentialLambda = lambdaArg.getValue();
         opts.trainingParams.learningRate = learnArg.getValue();
+        opts.trainingParams.pyramidSamplesPerLambda = pyramidArg.getValue();
+        opts.trainingParams.splitSelection = (splitSelectionArg.getValue() == "correlation") ? dest::core::SPLIT_CORRELATION : dest::core::SPLIT_RANDOM;
         opts.randomSeed = randomSeedArg.getValue();
         
         opts.loadMaxSize = maxImageSizeArg.getValue();
@@ -74,7 +84,8 @@ int main(int argc, char **argv)
         opts.showInitialSamples = showInitialSamplesArg.getValue();
         opts.db = databaseArg.getValue();
         opts.rects = rectsArg.isSet() ? rectsArg.getValue() : "";
-        opts.output = outputArg.getValue();        
+        opts.output = outputArg.getValue();
+        opts.fineTune = fineTuneArg.getValue();        
     }
     catch (TCLAP::ArgException &e) {
         std::cerr << "Error: " << e.error() << " for arg " << e.argId() << std::endl;
@@ -125,7 +136,15 @@ int main(int argc, char **argv)
 
 
     dest::core::Tracker t;
-    t.fit(td);
+    if (!opts.fineTune.empty()) {
+        if (!t.load(opts.fineTune)) {
+            std::cerr << "Failed to load tracker to fine-tune." << std::endl;
+            return -1;
+        }
+        t.refit(td);
+    } else {
+        t.fit(td);
+    }
     
     std::cout << "Saving tracker to " << opts.output << std::endl;
     t.save(opts.output);
@@ -0,0 +1,229 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_AUTOTUNE_H
+#define DEST_AUTOTUNE_H
+
+#include <dest/core/tracker.h>
+#include <dest/core/request_coalescer.h>
+#include <dest/core/pipelined_tracker.h>
+#include <dest/util/cpu.h>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dest {
+    namespace core {
+
+        /**
+            Ways of evaluating a tracker on many faces.
+        */
+        enum PredictEngine {
+            /** One face at a time through Tracker::predict. */
+            ENGINE_SINGLE,
+            /** Batches evaluated stage by stage through Tracker::predict, see RequestCoalescer. */
+            ENGINE_BATCHED,
+            /** Cascade ranges on pinned threads, see PipelinedTracker. */
+            ENGINE_PIPELINED
+        };
+
+        /**
+            Human readable name of predict engine.
+        */
+        const char *predictEngineName(PredictEngine e);
+
+        /**
+            Parse predict engine from name as returned by predictEngineName.
+
+            \returns true on success, false otherwise.
+        */
+        bool parsePredictEngine(const std::string &name, PredictEngine &e);
+
+        /**
+            Runtime configuration of a tracker on a specific host.
+        */
+        struct RuntimeProfile {
+            /** Instruction set level of sampling kernels. Defaults to the detected level. */
+            util::InstructionSet isa;
+
+            /** Pixel sampling strategy. Defaults to SAMPLING_AUTO. */
+            SamplingStrategy samplingStrategy;
+
+            /** Engine to evaluate many faces with. Defaults to ENGINE_BATCHED. */
+            PredictEngine engine;
+
+            /** Batch size for ENGINE_BATCHED. Defaults to 32. */
+            int batchSize;
+
+            /** Number of OpenMP threads for ENGINE_BATCHED. Zero keeps the OpenMP default. Defaults to 0. */
+            int numThreads;
+
+            /** Number of pipeline stages for ENGINE_PIPELINED. Defaults to 2. */
+            int pipelineStages;
+
+            /** Throughput measured when tuning, zero if not tuned. Informative only. Defaults to 0. */
+            float facesPerSecond;
+
+            RuntimeProfile();
+        };
+
+        /**
+            Inspect runtime profile.
+        */
+        std::ostream& operator<<(std::ostream &stream, const RuntimeProfile &obj);
+
+        /**
+            Save runtime profile as a text file of key=value lines.
+
+            \returns true on success, false otherwise.
+        */
+        bool saveRuntimeProfile(const std::string &path, const RuntimeProfile &p);
+
+        /**
+            Load runtime profile from a file written by saveRuntimeProfile.
+
+            Empty lines and lines starting with '#' are ignored. Keys not present keep their current
+            value, unknown keys are skipped, so profiles remain loadable across versions.
+
+            \returns false if the file cannot be read or a value is malformed, true otherwise.
+        */
+        bool loadRuntimeProfile(const std::string &path, RuntimeProfile &p);
+
+        /**
+            Default location of the runtime profile of a tracker file. This is the tracker path
+            with .profile appended.
+        */
+        std::string runtimeProfilePath(const std::string &trackerPath);
+
+        /**
+            Apply process wide and tracker settings of a runtime profile.
+
+            Sets the active instruction set (capped to the level supported by this host), the
+            OpenMP thread count and the tracker's sampling strategy. Engine, batch size and pipeline
+            stages are used by predictWithRuntimeProfile.
+        */
+        void applyRuntimeProfile(const RuntimeProfile &p, Tracker &t);
+
+        /**
+            Fill coalescer parameters from runtime profile.
+        */
+        void applyRuntimeProfile(const RuntimeProfile &p, CoalescerParameters &params);
+
+        /**
+            Fill pipeline parameters from runtime profile.
+        */
+        void applyRuntimeProfile(const RuntimeProfile &p, PipelineParameters &params);
+
+        /**
+            Predict many faces using the engine of a runtime profile.
+
+            Faces are evaluated one at a time, in batches of RuntimeProfile::batchSize or through a
+            pipeline of RuntimeProfile::pipelineStages stages, as selected by RuntimeProfile::engine.
+            Results are the same for all engines. Process wide settings are applied separately, see
+            applyRuntimeProfile.
+
+            Pipelined prediction starts and joins its stage threads on every call. When predicting
+            repeatedly, use ProfiledPredictor instead.
+
+            \param p Runtime profile.
+            \param t Tracker.
+            \param imgs Images, one per face.
+            \param shapeToImage Face transforms, one per image.
+            \param shapes Landmarks in image space, one per face.
+        */
+        void predictWithRuntimeProfile(const RuntimeProfile &p, const Tracker &t,
+                                       const std::vector<MappedImage> &imgs,
+                                       const std::vector<ShapeTransform> &shapeToImage,
+                                       std::vector<Shape> &shapes);
+
+        /**
+            Predicts many faces using the engine of a runtime profile, see predictWithRuntimeProfile.
+
+            The engine is set up once on construction and reused by all calls to predict. In
+            particular the stage threads of ENGINE_PIPELINED are started once and joined on
+            destruction. The tracker must outlive the predictor.
+        */
+        class ProfiledPredictor {
+        public:
+            ProfiledPredictor(const RuntimeProfile &p, const Tracker &t);
+            ~ProfiledPredictor();
+
+            /**
+                Predict faces. Not thread-safe.
+
+                \param imgs Images, one per face.
+                \param shapeToImage Face transforms, one per image.
+                \param shapes Landmarks in image space, one per face.
+            */
+            void predict(const std::vector<MappedImage> &imgs,
+                         const std::vector<ShapeTransform> &shapeToImage,
+                         std::vector<Shape> &shapes);
+
+            /**
+                Runtime profile of this predictor.
+            */
+            const RuntimeProfile &profile() const;
+
+        private:
+            ProfiledPredictor(const ProfiledPredictor &other);
+            ProfiledPredictor &operator=(const ProfiledPredictor &other);
+
+            struct data;
+            std::unique_ptr<data> _data;
+        };
+
+        /**
+            Parameters to control auto-tuning.
+        */
+        struct AutotuneParameters {
+            /** Batch sizes to try for ENGINE_BATCHED. Defaults to 4, 8, 16, 32, 64. */
+            std::vector<int> batchSizes;
+
+            /**
+                OpenMP thread counts to try for ENGINE_BATCHED. Defaults to powers of two up to the
+                number of hardware threads. Ignored without OpenMP.
+            */
+            std::vector<int> threadCounts;
+
+            /** Maximum number of pipeline stages to try. Defaults to the number of hardware threads. */
+            int maxPipelineStages;
+
+            /** Number of passes over all faces per trial, the fastest pass counts. Defaults to 3. */
+            int numRepetitions;
+
+            AutotuneParameters();
+        };
+
+        /**
+            Find the fastest runtime configuration of a tracker on this host.
+
+            Tuning proceeds greedily. First instruction set and sampling strategy are chosen by
+            single face throughput, as they affect all engines alike. Then batch sizes and thread
+            counts of batched prediction and stage counts of pipelined prediction are compared.
+            The process wide instruction set and thread count are restored afterwards.
+
+            \param t Tracker to tune. Its sampling strategy is left unchanged.
+            \param imgs Representative images.
+            \param shapeToImage Face transforms, one per image.
+            \param params Tuning parameters.
+            \param trials Optional, receives all evaluated configurations along with their throughput.
+            \returns fastest configuration.
+        */
+        RuntimeProfile autotune(const Tracker &t,
+                                const std::vector<Image> &imgs,
+                                const std::vector<ShapeTransform> &shapeToImage,
+                                const AutotuneParameters &params = AutotuneParameters(),
+                                std::vector<RuntimeProfile> *trials = 0);
+
+    }
+}
+
+#endif
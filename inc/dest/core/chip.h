@@ -0,0 +1,79 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_CHIP_H
+#define DEST_CHIP_H
+
+#include <dest/core/image.h>
+#include <dest/core/shape.h>
+#include <vector>
+
+namespace dest {
+    namespace core {
+
+        /**
+            Parameters to control chip extraction.
+        */
+        struct ChipParameters {
+            /** Width of each chip in pixels. Defaults to 112. */
+            int width;
+
+            /** Height of each chip in pixels. Defaults to 112. */
+            int height;
+
+            /**
+                Border left around the bounds of the reference shape, given as fraction
+                of the chip size. Defaults to 0.1.
+            */
+            float padding;
+
+            ChipParameters();
+        };
+
+        /**
+            Compute reference landmark positions in chip coordinates.
+
+            Scales the given shape uniformly so that its bounds fit into the chip respecting the
+            padding and centers it. Usually the shape is the mean shape of a tracker (Tracker::meanShape),
+            so that chips are aligned to the normalized frame the tracker was trained on.
+
+            \param s Shape to derive the reference from.
+            \param params Chip parameters.
+            \returns Reference landmark positions in chip coordinates.
+        */
+        Shape chipReferenceShape(const Shape &s, const ChipParameters &params);
+
+        /**
+            Extract similarity aligned chips for multiple shapes of a single image.
+
+            For each shape the best-fit similarity transform between reference and shape is estimated
+            and the chip is filled by bilinear sampling with clamp to edge. Chips are processed in a single
+            parallel pass using the vectorized sampling kernels.
+
+            \param img Image to sample from.
+            \param shapes Landmark positions in image space, for example as returned by Tracker::predict.
+            \param reference Landmark positions in chip coordinates, see chipReferenceShape.
+            \param params Chip parameters.
+            \param chips Caller provided buffer of shapes.size() * height * width floats. Chips are stored
+                         consecutively, each in row-major order.
+        */
+        void extractChips(const Eigen::Ref<const Image> &img, const std::vector<Shape> &shapes, const Shape &reference, const ChipParameters &params, float *chips);
+
+        /**
+            Extract similarity aligned chips for shapes of multiple images.
+
+            Same as above, except that the n-th shape is sampled from the n-th image.
+        */
+        void extractChips(const std::vector<MappedImage> &imgs, const std::vector<Shape> &shapes, const Shape &reference, const ChipParameters &params, float *chips);
+
+    }
+}
+
+#endif
@@ -12,7 +12,9 @@
 #define DEST_IMAGE_H
 
 #include <Eigen/Core>
+#include <Eigen/Geometry>
 #include <random>
+#include <vector>
 
 namespace dest {
     namespace core {
@@ -45,6 +47,161 @@ namespace dest {
             \param intentsities Bilinear interpolated intensities for all coordintes.
          */
         void readImage(const Eigen::Ref<const Image> &img, const PixelCoordinates &coords, PixelIntensities &intensities);
+
+        /**
+            Read image intensities at locations given relative to anchor points.
+
+            The i-th location is computed as A * offsets.col(i) + anchors.col(anchorIds(i)). Produces the
+            same intensities as LazyPixelIntensities for the same arguments, bit for bit at every instruction
+            set level, as no sampling kernel is compiled with fused multiply-add contraction.
+
+            \param img Image to sample from
+            \param A Linear transform applied to offsets.
+            \param offsets Offsets relative to anchor points.
+            \param anchorIds Anchor index for each offset.
+            \param anchors Anchor points in image space.
+            \param intentsities Bilinear interpolated intensities for all locations.
+        */
+        void readImage(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors, PixelIntensities &intensities);
+
+        /**
+            Downsampled levels of a rectangular image region.
+
+            Level l has 2^-l times the resolution of the image and is computed by repeated 2x2 box filtering.
+            Only the given region is downsampled, so the cost is independent of the total image size.
+            Level 0 refers to the image itself and is not stored.
+
+            Levels can be computed in full by create, or on demand by createLazy for the pixels that bilinear
+            sampling at given locations reads. Both produce identical pixel values.
+        */
+        class ImagePyramid {
+        public:
+            ImagePyramid();
+
+            /**
+                Build levels 1 to numLevels of a region of the image.
+
+                \param img Image to downsample.
+                \param x Left of region in pixels.
+                \param y Top of region in pixels.
+                \param width Width of region in pixels.
+                \param height Height of region in pixels.
+                \param numLevels Number of levels to build in addition to the image.
+            */
+            void create(const Eigen::Ref<const Image> &img, int x, int y, int width, int height, int numLevels);
+
+            /**
+                Prepare levels 1 to numLevels of a region of the image without computing any pixels.
+
+                Pixels are computed on first access through level(l, bounds) in square tiles
+                of the region, all levels of a tile at once. The cost is proportional to the area of accessed tiles
+                instead of the region size. The image must outlive the pyramid. Parameters as in create.
+            */
+            void createLazy(const Eigen::Ref<const Image> &img, int x, int y, int width, int height, int numLevels);
+
+            /**
+                Number of levels in addition to the image.
+            */
+            int numLevels() const;
+
+            /**
+                Access level l in [1, numLevels]. For lazily created pyramids only pixels computed so far are valid.
+            */
+            const Image &level(int l) const;
+
+            /**
+                Access level l in [1, numLevels] with all pixels computed that bilinear sampling at locations
+                inside the given bounds reads. Bounds are given in pixel coordinates of level l.
+            */
+            const Image &level(int l, const Eigen::AlignedBox2f &bounds);
+
+            /**
+                Transform from image coordinates to pixel coordinates of level l.
+            */
+            Eigen::AffineCompact2f imageToLevel(int l) const;
+
+        private:
+            void prepare(const Eigen::Ref<const Image> &img, int x, int y, int width, int height, int numLevels);
+            void computeTile(int tu, int tv);
+
+            std::vector<Image> _levels;
+            std::vector<unsigned char> _tileComputed;
+            const unsigned char *_data;
+            int _stride;
+            int _x, _y, _width, _height;
+            int _tileSize, _tileShift, _tileRows, _tileCols;
+        };
+
+        /**
+            Image intensities sampled on first access.
+
+            Locations are given relative to anchor points as in readImage above. An intensity is sampled
+            the first time it is accessed and memoized for subsequent accesses. Useful when only a small
+            fraction of locations is referenced, for example when traversing shallow trees.
+
+            All referenced arguments must outlive this object.
+        */
+        class LazyPixelIntensities {
+        public:
+            /**
+                Memo storage that can be kept across instances to avoid reallocation.
+            */
+            struct Buffer {
+                std::vector<float> values;
+                std::vector<unsigned int> valid;
+            };
+
+            LazyPixelIntensities(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors);
+
+            /**
+                Construct using external memo storage. The buffer must outlive this object and must not
+                be shared by instances alive at the same time.
+            */
+            LazyPixelIntensities(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors, Buffer &buffer);
+
+            /**
+                Access intensity of i-th location.
+            */
+            inline float operator()(int idx) {
+                const unsigned int bit = 1u << (idx & 31);
+                unsigned int &word = _valid[idx >> 5];
+                if (!(word & bit)) {
+                    word |= bit;
+                    _values[idx] = sample(idx);
+                }
+                return _values[idx];
+            }
+
+            /**
+                Number of distinct locations sampled so far.
+            */
+            int numSampled() const;
+
+        private:
+            float sample(int idx) const;
+
+            const unsigned char *_data;
+            int _rows, _cols, _stride;
+            float _a00, _a01, _a10, _a11;
+            const PixelCoordinates &_offsets;
+            const Eigen::VectorXi &_anchorIds;
+            const PixelCoordinates &_anchors;
+            Buffer _own;
+            std::vector<float> &_values;
+            std::vector<unsigned int> &_valid;
+        };
+
+        /**
+            Measure the cost of sampling a single location with LazyPixelIntensities relative to
+            sampling it in bulk with readImage.
+
+            Times both on a synthetic image for the given number of random locations.
+
+            \param numLocations Number of locations to sample.
+            \param numRepetitions Number of timed repetitions.
+            \returns Ratio of lazy to bulk sampling time per location.
+        */
+        float measureLazySamplingCost(int numLocations = 400, int numRepetitions = 2000);
         
     }
 }
@@ -0,0 +1,110 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_PIPELINED_TRACKER_H
+#define DEST_PIPELINED_TRACKER_H
+
+#include <dest/core/tracker.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <utility>
+
+namespace dest {
+    namespace core {
+
+        /**
+            Parameters to control pipelined execution.
+        */
+        struct PipelineParameters {
+            /**
+                Number of pipeline stages. Each stage runs a contiguous range of cascades on its own
+                thread. Clamped to the number of cascades. Defaults to 2.
+            */
+            int numStages;
+
+            /** Capacity of the queues connecting stages. Defaults to 64. */
+            int queueCapacity;
+
+            /**
+                Pin stage threads to consecutive cores starting at this core index. Set to a negative
+                value to disable pinning. Pinning is only supported on Linux. Defaults to 0.
+            */
+            int firstCore;
+
+            PipelineParameters();
+        };
+
+        /**
+            Work of a pipeline stage on a single face, see Tracker::predictCascades for the parameters.
+        */
+        typedef std::function<void(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const ShapeTransform &shapeToImage, int first, int last, Shape &estimate)> PipelineStageFunction;
+
+        /**
+            Evaluates the cascades of a tracker in a pipeline across cores.
+
+            A full cascade usually does not fit into the private cache of a single core, so each
+            prediction streams all cascades from shared cache or memory. For workloads consisting of
+            many independent faces, this class assigns contiguous ranges of cascades to pipeline stages,
+            each running on its own (pinned) thread. While stage 0 works on face n, stage 1 works on
+            face n-1 and so on. Faces are handed off through lock-free single-producer single-consumer
+            queues, so each core's trees stay hot in its private cache.
+
+            Submitting is not thread-safe, faces must be submitted from a single thread. Images passed
+            to submit must stay alive and unmodified until the corresponding result is available. The
+            tracker must outlive the pipeline.
+
+            If a stage throws, the exception is rethrown by get() of the future of that face. Other faces
+            are not affected.
+        */
+        class PipelinedTracker {
+        public:
+            /**
+                Create pipeline.
+
+                \param t Tracker.
+                \param params Pipeline parameters.
+                \param stage Optional replacement of Tracker::predictCascades run by each stage, for example
+                             to validate or instrument stages. Must be thread-safe.
+            */
+            PipelinedTracker(const Tracker &t, const PipelineParameters &params = PipelineParameters(), const PipelineStageFunction &stage = PipelineStageFunction());
+            ~PipelinedTracker();
+
+            /**
+                Submit a face for prediction. Blocks while the first stage queue is full.
+
+                \param img Single channel intensity input image.
+                \param shapeToImage Inverse of shape normalization transform.
+                \returns future holding the landmark positions in image space.
+            */
+            std::future<Shape> submit(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage);
+
+            /**
+                Number of pipeline stages.
+            */
+            int numStages() const;
+
+            /**
+                Range [first, last) of cascades run by the given stage.
+            */
+            std::pair<int, int> stageCascades(int stage) const;
+
+        private:
+            PipelinedTracker(const PipelinedTracker &other);
+            PipelinedTracker &operator=(const PipelinedTracker &other);
+
+            struct data;
+            std::unique_ptr<data> _data;
+        };
+
+    }
+}
+
+#endif
@@ -20,6 +20,46 @@
 namespace dest {
     namespace core {
         
+        /**
+            Strategy to sample pixel intensities during prediction.
+        */
+        enum SamplingStrategy {
+            /** Sample all pixel intensities before evaluating trees. */
+            SAMPLING_EAGER,
+            /** Sample pixel intensities on first reference during tree traversal. */
+            SAMPLING_LAZY,
+            /** Choose per regressor from the expected number of referenced pixels. */
+            SAMPLING_AUTO
+        };
+
+        /**
+            State of a regressor for incremental prediction on a single face track.
+        */
+        struct RegressorTrackState {
+            /** Leaf of each tree reached in the previous prediction, negative if none. */
+            Eigen::VectorXi leaves;
+
+            /** Smallest split margin along the path of each tree. */
+            Eigen::VectorXf margins;
+
+            /** Intensities referenced along the path of each tree. */
+            Eigen::VectorXf pathIntensities;
+
+            /** Sum of the leaf residuals of all trees. */
+            ShapeResidual leafSum;
+
+            /** Number of leaf changes patched into leafSum since it was last recomputed. */
+            int numPatches;
+
+            /** Number of trees traversed in the last prediction. */
+            int treesEvaluated;
+
+            /** Number of trees whose previous leaf was kept in the last prediction. */
+            int treesReused;
+
+            RegressorTrackState();
+        };
+
         /**
             Multi-dimensional regressor based on GBDT (Gradient boosted decision trees).
         */
@@ -35,6 +75,15 @@ namespace dest {
             */
             bool fit(RegressorTraining &t);
             
+            /**
+                Refit leaf values of a trained regressor to new training data.
+
+                Keeps mean shape, pixel coordinates, tree structure and split tests fixed and re-estimates
+                the mean residual and the leaf values of all trees in a single pass per tree. The mean shape
+                given by the training data is ignored.
+            */
+            bool refit(RegressorTraining &t);
+
             /** 
                 Predict incremental shape from current shape estimate.
 
@@ -44,6 +93,105 @@ namespace dest {
             */
             ShapeResidual predict(const Eigen::Ref<const Image> &img, const Shape &shape, const ShapeTransform &shapeToImage) const;
 
+            /**
+                Incrementally predict incremental shape from current shape estimate.
+
+                Intended for consecutive video frames of the same face. Trees whose split decisions cannot
+                have changed since the previous prediction keep their leaf without being traversed. Results
+                equal those of predict up to floating point rounding.
+
+                \param img Image to sample from
+                \param shape Current shape estimate
+                \param shapeToImage Global similarity transform from normalized shape space to image.
+                \param state State of previous prediction on the same face track. Updated.
+            */
+            ShapeResidual predict(const Eigen::Ref<const Image> &img, const Shape &shape, const ShapeTransform &shapeToImage, RegressorTrackState &state) const;
+
+            /**
+                Predict incremental shape from current shape estimate, sampling from the pyramid level
+                given by samplingLevel.
+
+                Only the level pixels read by this regressor are computed, see ImagePyramid::createLazy.
+                Falls back to the image when the pyramid has fewer levels.
+
+                \param img Image to sample from
+                \param pyr Pyramid of img shared by the regressors of a cascade.
+                \param shape Current shape estimate
+                \param shapeToImage Global similarity transform from normalized shape space to image.
+            */
+            ShapeResidual predict(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const Shape &shape, const ShapeTransform &shapeToImage) const;
+
+            /**
+                Incrementally predict incremental shape sampling from the pyramid level given by samplingLevel.
+                See above.
+            */
+            ShapeResidual predict(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const Shape &shape, const ShapeTransform &shapeToImage, RegressorTrackState &state) const;
+
+            /**
+                Image pyramid level to sample from for a face with the given transform.
+
+                Level 0 refers to the full resolution image. The level is the coarsest level at which a pixel
+                spans no more than samplingSpacing in normalized shape space, limited to MaxSamplingLevel.
+            */
+            int samplingLevel(const ShapeTransform &shapeToImage) const;
+
+            /**
+                Pixel spacing in normalized shape space units this regressor was trained for. Zero when
+                sampling at full resolution only.
+            */
+            float samplingSpacing() const;
+
+            /**
+                Image pyramid level for the given spacing and face transform. See samplingLevel.
+            */
+            static int samplingLevel(float spacing, const ShapeTransform &shapeToImage);
+
+            /** Coarsest supported pyramid level. */
+            enum { MaxSamplingLevel = 5 };
+
+            /**
+                Set strategy to sample pixel intensities in prediction. Defaults to SAMPLING_AUTO.
+
+                With SAMPLING_AUTO lazy sampling is chosen when the expected number of distinct pixels
+                referenced by all trees is small compared to the number of pixels, weighted by the higher
+                cost of sampling individual pixels. The choice is re-evaluated after fitting and loading.
+            */
+            void setSamplingStrategy(SamplingStrategy s);
+
+            /**
+                Set cost of sampling a single pixel lazily relative to sampling it in bulk. Used by
+                SAMPLING_AUTO only. Defaults to DefaultLazySamplingCost.
+
+                The ratio depends on the machine and can be measured by measureLazySamplingCost.
+            */
+            void setLazySamplingCost(float cost);
+
+            /**
+                Cost of sampling a single pixel lazily relative to sampling it in bulk.
+            */
+            float lazySamplingCost() const;
+
+            /**
+                Default relative cost of lazy sampling. measureLazySamplingCost reports 5 to 6 on
+                x86-64 with AVX2 bulk sampling kernels, see dest_bench_predict.
+            */
+            static const float DefaultLazySamplingCost;
+
+            /**
+                Test if prediction samples pixel intensities lazily.
+            */
+            bool lazySampling() const;
+
+            /**
+                Expected number of distinct pixels referenced in a single prediction.
+            */
+            float expectedPixelReads() const;
+
+            /**
+                Number of pixels per prediction sampled in eager mode.
+            */
+            int numPixels() const;
+
             /**
                 Save trained regressor to flatbuffers.
             */
@@ -57,7 +205,11 @@ namespace dest {
         private:
             
             PixelCoordinates sampleCoordinates(RegressorTraining &t) const;
-            void readPixelIntensities(const Eigen::AffineCompact2f &shapeToShape, const Eigen::AffineCompact2f &shapeToImage, const Shape &s, const Image &i, PixelIntensities &intensities) const;
+            void readSampleIntensities(const RegressorTraining &t, const SampleData::Sample &s, PixelIntensities &intensities) const;
+            void readPixelIntensities(const Eigen::AffineCompact2f &shapeToShape, const Eigen::AffineCompact2f &shapeToImage, const Shape &s, const Eigen::Ref<const Image> &i, PixelIntensities &intensities) const;
+            int prepareLevel(ImagePyramid &pyr, const Shape &shape, const ShapeTransform &shapeToImage, Eigen::Matrix2f &A, PixelCoordinates &anchors) const;
+            ShapeResidual predictAt(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &anchors) const;
+            ShapeResidual predictAt(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &anchors, RegressorTrackState &state) const;
             
             struct data;
             std::unique_ptr<data> _data;
@@ -0,0 +1,128 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_REQUEST_COALESCER_H
+#define DEST_REQUEST_COALESCER_H
+
+#include <dest/core/tracker.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <iosfwd>
+
+namespace dest {
+    namespace core {
+
+        /**
+            Parameters to control request coalescing.
+        */
+        struct CoalescerParameters {
+            /** Maximum number of requests evaluated as a single batch. Defaults to 32. */
+            int maxBatchSize;
+
+            /**
+                Maximum time in milliseconds to wait for further requests once the first
+                request of a batch has arrived. Defaults to 2.
+            */
+            float batchWindowMs;
+
+            /**
+                Targeted latency in milliseconds from submission to result. The effective batch size
+                is adapted so that waiting plus batch evaluation stays within this target.
+                Set to zero to always allow maxBatchSize. Defaults to 10.
+            */
+            float latencyTargetMs;
+
+            /** Number of worker threads evaluating batches. Defaults to 1. */
+            int numWorkers;
+
+            CoalescerParameters();
+        };
+
+        /**
+            Inspect coalescer parameters.
+        */
+        std::ostream& operator<<(std::ostream &stream, const CoalescerParameters &obj);
+
+        /**
+            Statistics gathered by the request coalescer.
+        */
+        struct CoalescerStats {
+            /** Number of requests evaluated. */
+            size_t numRequests;
+            /** Number of batches evaluated. */
+            size_t numBatches;
+            /** Current adaptive batch size limit. */
+            int batchSizeLimit;
+            /** Smoothed evaluation time per request in milliseconds. */
+            float msPerRequest;
+        };
+
+        /**
+            Evaluation of a batch of faces, see Tracker::predict for the parameters.
+        */
+        typedef std::function<void(const std::vector<MappedImage> &imgs, const std::vector<ShapeTransform> &shapeToImage, std::vector<Shape> &shapes)> BatchPredictFunction;
+
+        /**
+            Coalesces concurrently arriving prediction requests into batches.
+
+            Requests arriving within a configurable time window (or until the batch is full) are
+            gathered and evaluated through Tracker::predict as a single batch. Since the batch is
+            evaluated stage by stage, the trees of each cascade are streamed through cache once per
+            batch instead of once per request, which raises throughput under load.
+
+            The batch size limit adapts to the latency target: the evaluation time per request is
+            tracked and the limit is chosen so that batch window plus batch evaluation time stays
+            within the target.
+
+            Submitting is thread-safe. Images passed to submit must stay alive and unmodified until
+            the corresponding result is available. The tracker must outlive the coalescer.
+        */
+        class RequestCoalescer {
+        public:
+            /**
+                Create coalescer.
+
+                \param t Tracker.
+                \param params Coalescer parameters.
+                \param predict Optional replacement of Tracker::predict evaluating each batch, for example
+                               to validate or instrument batches. Must be thread-safe when using multiple
+                               workers.
+            */
+            RequestCoalescer(const Tracker &t, const CoalescerParameters &params = CoalescerParameters(), const BatchPredictFunction &predict = BatchPredictFunction());
+            ~RequestCoalescer();
+
+            /**
+                Submit a prediction request.
+
+                \param img Single channel intensity input image.
+                \param shapeToImage Inverse of shape normalization transform.
+                \returns future holding the landmark positions in image space. If prediction of the batch
+                         throws, the exception is rethrown by get() of every future in that batch.
+            */
+            std::future<Shape> submit(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage);
+
+            /**
+                Access statistics.
+            */
+            CoalescerStats stats() const;
+
+        private:
+            RequestCoalescer(const RequestCoalescer &other);
+            RequestCoalescer &operator=(const RequestCoalescer &other);
+
+            struct data;
+            std::unique_ptr<data> _data;
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_RESULT_CACHE_H
+#define DEST_RESULT_CACHE_H
+
+#include <dest/core/tracker.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace dest {
+    namespace core {
+
+        /**
+            Parameters to control result caching.
+        */
+        struct ResultCacheParameters {
+            /** Maximum number of results kept in memory. Least recently used results are evicted first. Defaults to 10000. */
+            size_t maxEntries;
+
+            /**
+                Hash only the image region around the face instead of the entire image. The region spans
+                twice the extent of the tracker's mean shape bounds, which contains all pixels sampled for
+                typical faces. Much cheaper for large images. Results remain exact as long as no tree samples
+                outside of the region. Defaults to false.
+            */
+            bool hashFaceRegion;
+
+            /**
+                Path to a file storing results persistently. Results are appended on insert and looked up
+                on memory misses, so they survive restarts. Empty disables the disk tier. Defaults to empty.
+            */
+            std::string diskPath;
+
+            ResultCacheParameters();
+        };
+
+        /**
+            Identifies a prediction by content.
+        */
+        struct ResultCacheKey {
+            /** Hash of image bytes. */
+            uint64_t image;
+            /** Hash of the shape normalization transform. */
+            uint64_t transform;
+            /** Fingerprint of the tracker, see trackerFingerprint. */
+            uint64_t model;
+
+            bool operator==(const ResultCacheKey &other) const {
+                return image == other.image && transform == other.transform && model == other.model;
+            }
+        };
+
+        /**
+            Statistics gathered by the result cache.
+        */
+        struct ResultCacheStats {
+            /** Number of lookups answered from memory. */
+            size_t numHits;
+            /** Number of lookups answered from disk. */
+            size_t numDiskHits;
+            /** Number of lookups not answered. */
+            size_t numMisses;
+            /** Number of results evicted from memory. */
+            size_t numEvictions;
+            /** Number of results in memory. */
+            size_t numEntries;
+            /** Number of results on disk. */
+            size_t numDiskEntries;
+
+            ResultCacheStats();
+        };
+
+        /**
+            Hash of the intensities of an image, independent of its stride.
+        */
+        uint64_t hashImage(const Eigen::Ref<const Image> &img);
+
+        /**
+            Fingerprint of a tracker computed from its serialized form. Trackers with equal
+            fingerprints predict equal results.
+        */
+        uint64_t trackerFingerprint(const Tracker &t);
+
+        /**
+            Content-addressed cache of tracker results.
+
+            Duplicate inputs, such as re-uploaded photos, are recognized by a fast hash of their
+            image bytes (or the face region), the face transform and the tracker fingerprint, and
+            answered without evaluating the tracker. Recently used results are kept in memory up to
+            a bounded number of entries, an optional disk tier persists all results across runs.
+
+            All methods are thread-safe. The tracker must outlive the cache.
+        */
+        class ResultCache {
+        public:
+            ResultCache(const Tracker &t, const ResultCacheParameters &params = ResultCacheParameters());
+            ~ResultCache();
+
+            /**
+                Compute key of a prediction request.
+            */
+            ResultCacheKey key(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage) const;
+
+            /**
+                Lookup result by key, first in memory then on disk.
+
+                Results are stored in normalized shape space, so that equal face regions at different
+                image positions share results. Apply the face's shapeToImage transform to obtain
+                landmarks in image space.
+
+                \returns true if found, false otherwise.
+            */
+            bool lookup(const ResultCacheKey &key, Shape &shape);
+
+            /**
+                Store result in normalized shape space by key.
+            */
+            void insert(const ResultCacheKey &key, const Shape &shape);
+
+            /**
+                Predict landmarks, evaluating the tracker only for unseen inputs.
+
+                \param img Single channel intensity input image.
+                \param shapeToImage Inverse of shape normalization transform.
+                \returns landmark positions in image space.
+            */
+            Shape predict(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage);
+
+            /**
+                Predict landmarks of multiple faces.
+
+                Cached results are returned directly. Remaining inputs are deduplicated and evaluated
+                as a single batch, see Tracker::predict.
+            */
+            void predict(const std::vector<MappedImage> &imgs, const std::vector<ShapeTransform> &shapeToImage, std::vector<Shape> &shapes);
+
+            /**
+                Drop all results kept in memory. The disk tier is kept.
+            */
+            void clear();
+
+            /**
+                Access statistics.
+            */
+            ResultCacheStats stats() const;
+
+        private:
+            ResultCache(const ResultCache &other);
+            ResultCache &operator=(const ResultCache &other);
+
+            struct data;
+            std::unique_ptr<data> _data;
+        };
+
+    }
+}
+
+#endif
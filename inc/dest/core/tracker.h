@@ -14,6 +14,7 @@
 #include <dest/core/image.h>
 #include <dest/core/shape.h>
 #include <dest/core/training_data.h>
+#include <dest/core/regressor.h>
 #include <dest/io/dest_io_generated.h>
 #include <memory>
 #include <string>
@@ -21,6 +22,25 @@
 namespace dest {
     namespace core {
 
+        /**
+            State of a single face track for incremental prediction.
+        */
+        struct TrackState {
+            /** State of each regressor in the cascade. */
+            std::vector<RegressorTrackState> cascade;
+
+            /** Number of trees traversed in the last prediction. */
+            int treesEvaluated;
+
+            /** Number of trees whose previous leaf was kept in the last prediction. */
+            int treesReused;
+
+            TrackState();
+
+            /** Forget previous predictions. */
+            void reset();
+        };
+
         /**
             Provides alignment of shape landmarks.
 
@@ -47,6 +67,20 @@ namespace dest {
             */
             bool fit(SampleData &t);
 
+            /**
+                Adapt a trained tracker to new training data by refitting leaf values only.
+
+                Keeps mean shape, pixel coordinates, tree structures and split tests fixed. Stage by stage,
+                the mean residual and leaf values of each regressor are re-estimated on the given samples
+                and sample estimates are advanced using the refitted regressor. This requires no split search
+                and is therefore much faster than fit, while the cost of prediction is unchanged.
+
+                Sample estimates are expected in the normalized shape space of this tracker, which is the case
+                when samples are created by SampleData::createTrainingSamples with the same normalization as
+                used for training. Training parameters are ignored.
+            */
+            bool refit(SampleData &t);
+
             /**
                 Predict shape landmarks from image and a global transform.
 
@@ -66,6 +100,114 @@ namespace dest {
             */
             Shape predict(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, std::vector<Shape> *stepResults = 0) const;
 
+            /**
+                Incrementally predict shape landmarks on consecutive frames of a face track.
+
+                Same as predict, except that each tree remembers its path from the previous frame. A tree is
+                only traversed again if any intensity along its path changed by more than half of the smallest
+                margin by which the path's pixel differences cleared their thresholds. On stable faces most trees
+                keep their leaf, skipping traversal and residual accumulation. Results equal those of predict
+                up to floating point rounding.
+
+                \param img Single channel intensity input image.
+                \param shapeToImage Inverse of shape normalization transform.
+                \param state State of the face track. Use a separate state per face and reset it when the
+                             track is lost.
+                \returns the computed landmark positions in image space.
+            */
+            Shape predict(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, TrackState &state) const;
+
+            /**
+                Predict shape landmarks for a batch of independent inputs.
+
+                Evaluates the cascade stage by stage across the whole batch, so the trees of each
+                cascade are brought into cache once per batch instead of once per input. Results are
+                the same as when calling predict for each input separately.
+
+                \param imgs Single channel intensity input images.
+                \param shapeToImage Inverse of shape normalization transform for each image.
+                \param shapes Computed landmark positions in image space for each image.
+            */
+            void predict(const std::vector<MappedImage> &imgs, const std::vector<ShapeTransform> &shapeToImage, std::vector<Shape> &shapes) const;
+
+            /**
+                Refine a shape estimate by a range of cascades.
+
+                Applies the cascades [first, last) to the given estimate. Starting from meanShape and
+                applying all cascades followed by shapeToImage is equivalent to predict.
+
+                \param img Single channel intensity input image.
+                \param shapeToImage Inverse of shape normalization transform.
+                \param first Index of first cascade to apply.
+                \param last Index one past the last cascade to apply.
+                \param estimate Shape estimate in normalized shape space to refine.
+            */
+            void predictCascades(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, int first, int last, Shape &estimate) const;
+
+            /**
+                Prepare the pyramid all cascades sample from for a face.
+
+                Pixels are computed on demand, see ImagePyramid::createLazy. Passing the pyramid to each call of
+                predictCascades for the same face computes every pixel once across all cascade ranges.
+
+                \param img Single channel intensity input image. Must outlive the pyramid.
+                \param shapeToImage Inverse of shape normalization transform.
+                \param pyr Pyramid to prepare.
+            */
+            void createPyramid(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, ImagePyramid &pyr) const;
+
+            /**
+                Refine a shape estimate by a range of cascades, sampling from a pyramid prepared by createPyramid.
+                See above.
+            */
+            void predictCascades(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const ShapeTransform &shapeToImage, int first, int last, Shape &estimate) const;
+
+            /**
+                Set strategy to sample pixel intensities in prediction. Defaults to SAMPLING_AUTO.
+
+                With SAMPLING_AUTO each regressor decides on its own whether to sample lazily. The strategy
+                is retained when fitting or loading.
+            */
+            void setSamplingStrategy(SamplingStrategy s);
+
+            /**
+                Strategy to sample pixel intensities in prediction.
+            */
+            SamplingStrategy samplingStrategy() const;
+
+            /**
+                Set cost of sampling a single pixel lazily relative to sampling it in bulk, see
+                Regressor::setLazySamplingCost. Defaults to Regressor::DefaultLazySamplingCost. The
+                cost is retained when fitting or loading.
+            */
+            void setLazySamplingCost(float cost);
+
+            /**
+                Cost of sampling a single pixel lazily relative to sampling it in bulk.
+            */
+            float lazySamplingCost() const;
+
+            /**
+                Number of regressors sampling pixel intensities lazily.
+            */
+            int numLazySamplingCascades() const;
+
+            /**
+                Coarsest image pyramid level any regressor samples from for a face with the given
+                transform. Zero unless trained with TrainingParameters::pyramidSamplesPerLambda.
+            */
+            int maxSamplingLevel(const ShapeTransform &shapeToImage) const;
+
+            /**
+                Number of regressors in cascade.
+            */
+            int numCascades() const;
+
+            /**
+                Mean shape in normalized shape space. Used as initial estimate in prediction.
+            */
+            const Shape &meanShape() const;
+
             /**
                 Save trained tracker to flatbuffers.
             */
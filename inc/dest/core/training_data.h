@@ -20,6 +20,23 @@
 namespace dest {
     namespace core {
 
+        /**
+            Strategy to propose split candidates during tree training.
+        */
+        enum SplitSelection {
+            /** Random pixel pairs preferring close pixels, random thresholds. */
+            SPLIT_RANDOM,
+            /**
+                Pixel pairs whose intensity difference correlates best with random projections of the
+                node residuals, thresholds drawn from the node's samples.
+
+                Based on
+                [1] Cao, Xudong, et al. "Face alignment by explicit shape regression."
+                    International Journal of Computer Vision 107.2 (2014): 177-190.
+            */
+            SPLIT_CORRELATION
+        };
+
         /**
             Training parameters.
 
@@ -68,6 +85,20 @@ namespace dest {
             */
             float expansionRandomPixelCoordinates;
 
+            /**
+                Pyramid samples per exponential lambda. When positive, each cascade samples from the coarsest
+                image pyramid level at which its exponential lambda still spans this many pixels. Coarse
+                cascades then read from smaller, anti-aliased images. Set to 0 to always sample at full
+                resolution. Defaults to 0.
+            */
+            float pyramidSamplesPerLambda;
+
+            /**
+                How split candidates are proposed. Correlation based selection yields stronger splits per
+                tree, so fewer trees reach the same accuracy. Defaults to SPLIT_RANDOM.
+            */
+            SplitSelection splitSelection;
+
             TrainingParameters();
         };
 
@@ -209,6 +240,11 @@ namespace dest {
             SampleData *training;
             Shape meanShape;
             int numLandmarks;
+
+            /** Pyramid of each input image or null when sampling at full resolution only. */
+            const std::vector<ImagePyramid> *pyramids;
+
+            RegressorTraining();
         };
 
         /**
@@ -218,12 +254,18 @@ namespace dest {
             struct Sample {
                 ShapeResidual residual;
                 PixelIntensities intensities;
+                /** Intensities in pixelBasis. Only computed for SPLIT_CORRELATION. */
+                Eigen::RowVectorXf components;
+                /** Residual projected onto the random directions of the tree in training. Only computed for SPLIT_CORRELATION. */
+                Eigen::RowVectorXf projections;
 
                 friend inline void swap(Sample& a, Sample& b)
                 {
                     using std::swap;
                     swap(a.residual, b.residual);
                     swap(a.intensities, b.intensities);
+                    swap(a.components, b.components);
+                    swap(a.projections, b.projections);
                 }
             };
             typedef std::vector<Sample> SampleVector;
@@ -233,6 +275,15 @@ namespace dest {
             SampleVector samples;
             PixelCoordinates pixelCoordinates;
             int numLandmarks;
+
+            /** Covariance of pixel intensities over all samples. Only computed for SPLIT_CORRELATION. */
+            Eigen::MatrixXf pixelCovariance;
+
+            /**
+                Leading principal directions of pixel intensities in columns. Only computed for
+                SPLIT_CORRELATION.
+            */
+            Eigen::MatrixXf pixelBasis;
         };
     }
 }
@@ -34,6 +34,10 @@ namespace dest {
             This tree is stored implicitely as linear array as in GBDT we usually deal with
             shallow trees without many empty branches.
 
+            Alternatively split candidates are chosen by correlation, see SPLIT_CORRELATION. For each
+            candidate the node residuals are projected onto a random direction, drawn once per tree, and the
+            pixel pair whose intensity difference correlates best with the projection is selected.
+
             Provides parallelization of split position testing when OpenMP is enabled.
 
             Based on the work of
@@ -54,6 +58,14 @@ namespace dest {
             */
             bool fit(TreeTraining &t);
 
+            /**
+                Re-estimate leaf values keeping the tree structure and split tests fixed.
+
+                Each leaf is set to the mean residual of the samples reaching it. Leaves not reached
+                by any sample keep their value.
+            */
+            bool refitLeaves(TreeTraining &t);
+
             /**
                 Predict incremental shape update from image intensities.
 
@@ -62,6 +74,58 @@ namespace dest {
             */
             ShapeResidual predict(const PixelIntensities &intensities) const;
 
+            /**
+                Predict incremental shape update from lazily sampled image intensities.
+
+                Only intensities referenced along the traversed path are sampled.
+
+                \param intensities Image intensities sampled on demand.
+                \return Incremental shape update.
+            */
+            ShapeResidual predict(LazyPixelIntensities &intensities) const;
+
+            /**
+                Incrementally find the leaf for lazily sampled image intensities.
+
+                The path of a previous traversal is given by its leaf. If no intensity referenced along that
+                path changed by more than half the smallest split margin on the path, no split decision can
+                have flipped and the previous leaf is kept without traversing. Otherwise the tree is traversed
+                and the trace is updated.
+
+                \param intensities Image intensities sampled on demand.
+                \param leaf Leaf of previous traversal or negative if none. Updated on traversal.
+                \param margin Smallest absolute difference between pixel difference and threshold along the
+                              path. Updated on traversal.
+                \param pathIntensities Intensity pairs referenced along the path, 2 * (depth() - 1) values.
+                                       Updated on traversal.
+                \return true if the tree was traversed, false if the previous leaf was kept.
+            */
+            bool findLeaf(LazyPixelIntensities &intensities, int &leaf, float &margin, float *pathIntensities) const;
+
+            /**
+                Incrementally find the leaf for image intensities. See above.
+            */
+            bool findLeaf(const PixelIntensities &intensities, int &leaf, float &margin, float *pathIntensities) const;
+
+            /**
+                Incremental shape update stored in the given leaf.
+            */
+            const ShapeResidual &leafResidual(int leaf) const;
+
+            /**
+                Maximum depth of tree.
+            */
+            int depth() const;
+
+            /**
+                Accumulate expected number of accesses per pixel for a single prediction.
+
+                Assumes each split is passed to either side with equal probability.
+
+                \param rates Accumulated access rates indexed by pixel. Must be sized to the number of pixels.
+            */
+            void accumulatePixelAccessRates(Eigen::VectorXf &rates) const;
+
             /**
                 Save tree to flatbuffers.
             */
@@ -94,6 +158,11 @@ namespace dest {
             */
             void sampleSplitPositions(TreeTraining &t, std::vector<SplitInfo> &splits) const;
 
+            /**
+                Generate split candidates correlating with random projections of the node residuals.
+            */
+            void sampleCorrelatedSplitPositions(TreeTraining &t, const NodeInfo &parent, std::vector<SplitInfo> &splits) const;
+
             /**
                 Compute the split energy for a single candidate.
             */
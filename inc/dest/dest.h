@@ -17,14 +17,27 @@
 #include <dest/core/tracker.h>
 #include <dest/core/training_data.h>
 #include <dest/core/tester.h>
+#include <dest/core/request_coalescer.h>
+#include <dest/core/pipelined_tracker.h>
+#include <dest/core/chip.h>
+#include <dest/core/autotune.h>
+#include <dest/core/result_cache.h>
 #include <dest/io/rect_io.h>
+#include <dest/face/detection_scheduler.h>
+#include <dest/face/tiled_processor.h>
+#include <dest/util/perf_counters.h>
 
 #ifdef DEST_WITH_OPENCV
 #include <dest/util/convert.h>
 #include <dest/util/draw.h>
 #include <dest/util/triangulate.h>
 #include <dest/io/database_io.h>
+#include <dest/io/synthetic_database.h>
 #include <dest/face/face_detector.h>
 #endif
 
+#ifdef DEST_WITH_JPEG
+#include <dest/io/jpeg_io.h>
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,175 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_DETECTION_SCHEDULER_H
+#define DEST_DETECTION_SCHEDULER_H
+
+#include <dest/core/image.h>
+#include <iosfwd>
+
+namespace dest {
+    namespace face {
+
+        /**
+            Parameters to control adaptive detection cadence.
+        */
+        struct DetectionSchedulerParameters {
+            /** Frames between detections while a face is tracked confidently. Defaults to 5. */
+            int baseInterval;
+
+            /** Smallest number of frames between detections. Defaults to 1. */
+            int minInterval;
+
+            /** Largest number of frames between detections when no face is present. Defaults to 120. */
+            int maxInterval;
+
+            /** Factor to grow the interval by after each detection that found no face. Defaults to 2. */
+            float backoffFactor;
+
+            /**
+                Global motion above this value snaps the interval back to minInterval, unless a face is
+                tracked confidently. In that case the interval is halved at most once, down to no less
+                than half of baseInterval. Measured as mean absolute intensity difference between frames,
+                see measureMotion. Defaults to 6.
+            */
+            float motionThreshold;
+
+            /**
+                Track uncertainty above this value tightens the interval while tracking. The scale depends
+                on the measure reported via reportTrack. Defaults to 0.05.
+            */
+            float uncertaintyThreshold;
+
+            DetectionSchedulerParameters();
+        };
+
+        /**
+            Inspect scheduler parameters.
+        */
+        std::ostream& operator<<(std::ostream &stream, const DetectionSchedulerParameters &obj);
+
+        /**
+            Counters of a detection scheduler.
+        */
+        struct DetectionSchedulerStats {
+            /** Number of frames processed. */
+            int numFrames;
+
+            /** Number of frames the detector was run on. */
+            int numDetections;
+
+            /** Number of detections a fixed cadence of baseInterval frames would have run. */
+            int numBaselineDetections;
+
+            /** Number of times global motion shortened the interval. */
+            int numMotionTriggers;
+
+            /** Number of frames on which a face was tracked. */
+            int numTrackedFrames;
+
+            /** Current number of frames between detections. */
+            int interval;
+
+            /** Detections saved compared to a fixed cadence. Negative when more detections were run. */
+            int detectionsSaved() const;
+
+            DetectionSchedulerStats();
+        };
+
+        /**
+            Inspect scheduler counters.
+        */
+        std::ostream& operator<<(std::ostream &stream, const DetectionSchedulerStats &obj);
+
+        /**
+            Decides on which frames of a video to run the face detector.
+
+            Face detection is usually far more expensive than tracking. A fixed detection cadence wastes most
+            CPU on scenes without faces. This scheduler adapts the cadence to the scene state:
+                - While no face is present, the interval between detections grows exponentially up to maxInterval.
+                - Global motion or a new detection snap the interval back. While a face is tracked confidently,
+                  global motion only shortens the interval to half of baseInterval, as the tracker follows
+                  fast but steady motion on its own.
+                - While a face is tracked the interval is baseInterval and tightens towards minInterval as long
+                  as the track is reported uncertain.
+
+            Call shouldDetect once per frame. Report detection results via reportDetection and, on frames
+            that were tracked, the track uncertainty via reportTrack.
+
+            The scheduler is independent of any particular detector or tracker.
+        */
+        class DetectionScheduler {
+        public:
+            DetectionScheduler(const DetectionSchedulerParameters &params = DetectionSchedulerParameters());
+
+            /**
+                Decide whether to run the detector on the current frame.
+
+                \param motion Global motion of the current frame with respect to the previous one, for
+                              example as computed by measureMotion. Pass 0 if unknown.
+                \returns true if the detector should be run.
+            */
+            bool shouldDetect(float motion = 0.f);
+
+            /**
+                Report the result of running the detector.
+
+                \param faceFound True if at least one face was found.
+            */
+            void reportDetection(bool faceFound);
+
+            /**
+                Report the uncertainty of a tracked frame.
+
+                Any measure where larger values indicate less reliable tracks can be used, for example the
+                landmark displacement between consecutive frames relative to the face size.
+            */
+            void reportTrack(float uncertainty);
+
+            /**
+                Force detection on the next call to shouldDetect.
+            */
+            void requestDetection();
+
+            /**
+                True if a face is currently assumed to be present.
+            */
+            bool tracking() const;
+
+            /**
+                Access counters.
+            */
+            const DetectionSchedulerStats &stats() const;
+
+            /**
+                Measure global motion between two frames of equal size.
+
+                Computes the mean absolute intensity difference on a regular grid of pixels.
+
+                \param prev Previous frame.
+                \param cur Current frame.
+                \param step Distance between grid pixels.
+                \returns mean absolute difference or 0 if frame sizes do not match.
+            */
+            static float measureMotion(const Eigen::Ref<const core::Image> &prev, const Eigen::Ref<const core::Image> &cur, int step = 4);
+
+        private:
+            DetectionSchedulerParameters _params;
+            DetectionSchedulerStats _stats;
+            bool _tracking;
+            bool _uncertain;
+            bool _forced;
+            int _framesSinceDetection;
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_TILED_PROCESSOR_H
+#define DEST_TILED_PROCESSOR_H
+
+#include <dest/core/tracker.h>
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+namespace dest {
+    namespace face {
+
+        /**
+            Provides rectangular regions of a large image on demand.
+
+            Implementations may decode regions from disk, so that the full image never has to be
+            resident in memory, see io::JpegTileSource. Reads are serialized by TiledProcessor unless the source
+            declares itself thread-safe, so implementations need not be thread-safe.
+        */
+        class TileSource {
+        public:
+            virtual ~TileSource();
+
+            /** Width of the image in pixels. */
+            virtual int width() const = 0;
+
+            /** Height of the image in pixels. */
+            virtual int height() const = 0;
+
+            /**
+                Read region of the image. The region is guaranteed to lie within the image.
+
+                \param x Left of region in pixels.
+                \param y Top of region in pixels.
+                \param w Width of region in pixels.
+                \param h Height of region in pixels.
+                \param dst Receives region as h x w intensity image.
+                \returns true on success, false otherwise.
+            */
+            virtual bool readRegion(int x, int y, int w, int h, core::Image &dst) = 0;
+
+            /**
+                Whether readRegion may be called concurrently. TiledProcessor then reads without locking,
+                for example to decode tiles in parallel. Defaults to false.
+            */
+            virtual bool threadSafe() const;
+        };
+
+        /**
+            Tile source reading from an image in memory.
+        */
+        class ImageTileSource : public TileSource {
+        public:
+            explicit ImageTileSource(const Eigen::Ref<const core::Image> &img);
+
+            int width() const;
+            int height() const;
+            bool readRegion(int x, int y, int w, int h, core::Image &dst);
+
+        private:
+            core::MappedImage _img;
+        };
+
+        /**
+            Detects faces in a single tile. Rectangles are reported in tile coordinates.
+
+            Called concurrently from multiple threads.
+        */
+        typedef std::function<bool(const Eigen::Ref<const core::Image> &tile, std::vector<core::Rect> &faces)> TileDetector;
+
+        /**
+            Parameters to control tiled processing.
+        */
+        struct TiledParameters {
+            /** Edge length of square detection tiles in pixels. Defaults to 2048. */
+            int tileSize;
+
+            /**
+                Overlap between neighboring tiles in pixels. Should exceed the size of the largest face to
+                be detected, so that each face lies entirely within at least one tile. Defaults to 256.
+            */
+            int tileOverlap;
+
+            /**
+                Detections overlapping by more than this fraction of the smaller one are merged, keeping the
+                larger detection. Removes duplicates and partial detections at tile borders. Defaults to 0.5.
+            */
+            float nmsOverlap;
+
+            /**
+                Extent of the region read to align a face, as multiple of the tracker's mean shape bounds.
+                Pixels outside of this region are treated as if beyond the image border. Defaults to 2.
+            */
+            float footprintScale;
+
+            /** Number of worker threads. Zero uses the number of hardware threads. Defaults to 0. */
+            int numThreads;
+
+            TiledParameters();
+        };
+
+        /**
+            Inspect tiled parameters.
+        */
+        std::ostream& operator<<(std::ostream &stream, const TiledParameters &obj);
+
+        /**
+            Statistics of the last run of a tiled processor.
+        */
+        struct TiledStats {
+            /** Number of tiles processed by detection. */
+            int numTiles;
+            /** Number of detections before suppressing overlaps. */
+            int numDetections;
+            /** Number of faces after suppressing overlaps. */
+            int numFaces;
+            /** Largest number of image pixels resident at any time, summed over threads. */
+            size_t peakResidentPixels;
+
+            TiledStats();
+        };
+
+        /**
+            Detects and aligns faces in very large images without decoding them as a whole.
+
+            Detection runs tile by tile on a regular grid of overlapping tiles, followed by suppression
+            of overlapping detections across tiles. Each face is then aligned by reading only the region
+            of the image its pixel footprint covers. Tiles and faces are distributed over worker threads,
+            each thread holds at most one tile or face region at a time, so resident memory is bounded by
+            the number of threads times the tile size.
+
+            Faces are aligned using the default shape normalization estimateSimilarityTransform(unitRectangle(), rect),
+            which needs to match training. The tracker must outlive the processor.
+        */
+        class TiledProcessor {
+        public:
+            TiledProcessor(const core::Tracker &t, const TiledParameters &params = TiledParameters());
+
+            /**
+                Detect faces tile by tile.
+
+                \param src Image source.
+                \param detector Detector invoked on each tile.
+                \param faces Detected faces in image coordinates, overlaps suppressed.
+                \returns false if reading a tile failed, true otherwise.
+            */
+            bool detect(TileSource &src, const TileDetector &detector, std::vector<core::Rect> &faces);
+
+            /**
+                Align faces reading only their footprint regions.
+
+                \param src Image source.
+                \param faces Face rectangles in image coordinates.
+                \param shapes Landmarks in image coordinates, one per face.
+                \returns false if reading a region failed, true otherwise.
+            */
+            bool align(TileSource &src, const std::vector<core::Rect> &faces, std::vector<core::Shape> &shapes);
+
+            /**
+                Detect and align faces.
+            */
+            bool process(TileSource &src, const TileDetector &detector, std::vector<core::Rect> &faces, std::vector<core::Shape> &shapes);
+
+            /**
+                Access statistics of the last run.
+            */
+            const TiledStats &stats() const;
+
+            /**
+                Suppress overlapping axis aligned rectangles, keeping larger ones.
+
+                \param rects Rectangles, modified in place.
+                \param overlap Rectangles intersecting by more than this fraction of the smaller one are merged.
+            */
+            static void suppressOverlaps(std::vector<core::Rect> &rects, float overlap);
+
+        private:
+            const core::Tracker *_tracker;
+            TiledParameters _params;
+            TiledStats _stats;
+            core::Shape _meanShapeRectCorners;
+        };
+
+    }
+}
+
+#endif
@@ -20,6 +20,7 @@
 
 #include <dest/core/shape.h>
 #include <dest/core/image.h>
+#include <iosfwd>
 #include <string>
 #include <vector>
 #include <memory>
@@ -157,6 +158,40 @@ namespace dest {
         };
 
 
+        /**
+            Time spent in phases of the last ShapeDatabase::load.
+        */
+        struct DatabaseLoadStats {
+            /** Milliseconds spent finding annotation files. */
+            double globMs;
+            /** Milliseconds spent parsing annotations. */
+            double parseMs;
+            /** Milliseconds spent reading and decoding images. */
+            double decodeMs;
+            /** Milliseconds spent scaling images, shapes and rectangles. */
+            double scaleMs;
+            /** Milliseconds spent mirroring images, shapes and rectangles. */
+            double mirrorMs;
+            /** Milliseconds spent converting images to DEST format. */
+            double convertMs;
+            /** Number of annotation files found. */
+            size_t numCandidates;
+            /** Number of entries loaded, including mirrored ones. */
+            size_t numLoaded;
+            /** Number of image pixels decoded. */
+            size_t numPixelsDecoded;
+
+            DatabaseLoadStats();
+
+            /** Total milliseconds spent in all phases. */
+            double totalMs() const;
+        };
+
+        /**
+            Inspect load statistics.
+        */
+        std::ostream& operator<<(std::ostream &stream, const DatabaseLoadStats &obj);
+
         /**
             Generic base class for loading shapes and images from existing databases.
         */
@@ -174,6 +209,11 @@ namespace dest {
             void addLoader(std::shared_ptr<DatabaseLoader> l);
             std::string lastLoaderType() const;
 
+            /**
+                Access time spent in phases of the last load.
+            */
+            const DatabaseLoadStats &lastLoadStats() const;
+
             /**
                 Load shapes / images from directory.
 
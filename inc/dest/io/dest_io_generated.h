@@ -180,6 +180,7 @@ struct Regressor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const MatrixF *meanShape() const { return GetPointer<const MatrixF *>(10); }
   const flatbuffers::Vector<flatbuffers::Offset<Tree>> *forest() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<Tree>> *>(12); }
   float learningRate() const { return GetField<float>(14, 0); }
+  float samplingSpacing() const { return GetField<float>(16, 0); }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, 4 /* pixelCoordinates */) &&
@@ -194,6 +195,7 @@ struct Regressor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.Verify(forest()) &&
            verifier.VerifyVectorOfTables(forest()) &&
            VerifyField<float>(verifier, 14 /* learningRate */) &&
+           VerifyField<float>(verifier, 16 /* samplingSpacing */) &&
            verifier.EndTable();
   }
 };
@@ -207,10 +209,11 @@ struct RegressorBuilder {
   void add_meanShape(flatbuffers::Offset<MatrixF> meanShape) { fbb_.AddOffset(10, meanShape); }
   void add_forest(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Tree>>> forest) { fbb_.AddOffset(12, forest); }
   void add_learningRate(float learningRate) { fbb_.AddElement<float>(14, learningRate, 0); }
+  void add_samplingSpacing(float samplingSpacing) { fbb_.AddElement<float>(16, samplingSpacing, 0); }
   RegressorBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
   RegressorBuilder &operator=(const RegressorBuilder &);
   flatbuffers::Offset<Regressor> Finish() {
-    auto o = flatbuffers::Offset<Regressor>(fbb_.EndTable(start_, 6));
+    auto o = flatbuffers::Offset<Regressor>(fbb_.EndTable(start_, 7));
     return o;
   }
 };
@@ -221,8 +224,10 @@ inline flatbuffers::Offset<Regressor> CreateRegressor(flatbuffers::FlatBufferBui
    flatbuffers::Offset<MatrixF> meanShapeResidual = 0,
    flatbuffers::Offset<MatrixF> meanShape = 0,
    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Tree>>> forest = 0,
-   float learningRate = 0) {
+   float learningRate = 0,
+   float samplingSpacing = 0) {
   RegressorBuilder builder_(_fbb);
+  builder_.add_samplingSpacing(samplingSpacing);
   builder_.add_learningRate(learningRate);
   builder_.add_forest(forest);
   builder_.add_meanShape(meanShape);
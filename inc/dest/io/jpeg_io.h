@@ -0,0 +1,208 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_JPEG_IO_H
+#define DEST_JPEG_IO_H
+
+#include <dest/core/config.h>
+#if !defined(DEST_WITH_JPEG)
+    #error libjpeg-turbo is required for this part of DEST.
+#endif
+
+#include <dest/core/tracker.h>
+#include <dest/face/tiled_processor.h>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace dest {
+    namespace io {
+
+        /**
+            Part of a JPEG image decoded at a possibly reduced scale.
+        */
+        struct JpegRegion {
+            /** Decoded intensities. */
+            core::Image image;
+            /** Left of region in full resolution image pixels. */
+            int x;
+            /** Top of region in full resolution image pixels. */
+            int y;
+            /** Scale denominator, each region pixel covers scaleDenom x scaleDenom image pixels. */
+            int scaleDenom;
+            /** Width of the full resolution image. */
+            int imageWidth;
+            /** Height of the full resolution image. */
+            int imageHeight;
+
+            JpegRegion();
+
+            /**
+                Transform from full resolution image coordinates to region coordinates.
+            */
+            core::ShapeTransform imageToRegion() const;
+        };
+
+        /**
+            Read the dimensions of a JPEG image from its header.
+
+            \returns True if successful, false otherwise
+        */
+        bool readJpegSize(const unsigned char *data, size_t size, int &width, int &height);
+
+        /**
+            Decode part of a JPEG image as intensities.
+
+            Only the MCU rows covering the region are decoded, MCU columns left and right of the region are
+            skipped. Decoding at reduced scale uses the scaled inverse DCT, which is cheaper than decoding at
+            full resolution and downsampling afterwards.
+
+            \param data Compressed image.
+            \param size Size of compressed image in bytes.
+            \param x Left of region in full resolution image pixels.
+            \param y Top of region in full resolution image pixels.
+            \param w Width of region in full resolution image pixels.
+            \param h Height of region in full resolution image pixels.
+            \param scaleDenom Decode at 1 / scaleDenom of the original resolution. One of 1, 2, 4, 8.
+            \param region Decoded region. The region is clipped to the image and may be slightly larger
+                   than requested due to rounding to scaled pixels.
+            \returns True if successful, false otherwise
+        */
+        bool decodeJpegRegion(const unsigned char *data, size_t size, int x, int y, int w, int h, int scaleDenom, JpegRegion &region);
+
+        /**
+            Decode part of a JPEG file as intensities. See decodeJpegRegion for details.
+        */
+        bool decodeJpegRegion(const std::string &path, int x, int y, int w, int h, int scaleDenom, JpegRegion &region);
+
+        /**
+            Tile source decoding regions of a JPEG image on demand.
+
+            Only the compressed image is kept in memory. Each region is decoded when read, skipping MCU rows
+            below and columns beside it, so TiledProcessor never holds more than its tiles and face regions
+            decoded. See decodeJpegRegion. Regions are decoded independently, so reads may run concurrently.
+        */
+        class JpegTileSource : public face::TileSource {
+        public:
+            JpegTileSource();
+
+            /**
+                Use compressed image from memory. The data is copied.
+
+                \returns True if the JPEG header could be read, false otherwise.
+            */
+            bool open(const unsigned char *data, size_t size);
+
+            /**
+                Use compressed image from file.
+
+                \returns True if the file could be read and its JPEG header parsed, false otherwise.
+            */
+            bool open(const std::string &path);
+
+            int width() const;
+            int height() const;
+            bool readRegion(int x, int y, int w, int h, core::Image &dst);
+            bool threadSafe() const;
+
+        private:
+            std::vector<unsigned char> _data;
+            int _width, _height;
+        };
+
+        /**
+            Compress intensities as JPEG.
+
+            \param img Single channel intensity image.
+            \param quality Compression quality 1..100.
+            \param data Compressed image.
+            \returns True if successful, false otherwise
+        */
+        bool encodeJpeg(const Eigen::Ref<const core::Image> &img, int quality, std::vector<unsigned char> &data);
+
+        /**
+            Parameters to control re-alignment from JPEG images.
+        */
+        struct JpegRealignParameters {
+            /**
+                Extent of the decoded region, as multiple of the tracker's mean shape bounds. Pixels outside of
+                this region are treated as if beyond the image border. Defaults to 2.
+            */
+            float footprintScale;
+
+            /**
+                Decode at 1 / scaleDenom of the original resolution. One of 1, 2, 4, 8. Zero selects the
+                largest denominator keeping faces at least minFaceSize pixels wide. Defaults to 1.
+            */
+            int scaleDenom;
+
+            /** Minimum face width in decoded pixels when selecting scale automatically. Defaults to 128. */
+            int minFaceSize;
+
+            JpegRealignParameters();
+        };
+
+        /**
+            Inspect re-alignment parameters.
+        */
+        std::ostream& operator<<(std::ostream &stream, const JpegRealignParameters &obj);
+
+        /**
+            Decode the image region the tracker samples from for a stored face rectangle.
+
+            Use this instead of realignJpeg to predict many faces at once, for example through
+            core::ProfiledPredictor.
+
+            \param t Tracker
+            \param data Compressed image.
+            \param size Size of compressed image in bytes.
+            \param rect Face rectangle in full resolution image coordinates.
+            \param params Re-alignment parameters.
+            \param region Decoded region.
+            \param shapeToRegion Inverse of shape normalization transform in region coordinates.
+            \returns True if successful, false otherwise
+        */
+        bool decodeJpegFootprint(const core::Tracker &t, const unsigned char *data, size_t size, const core::Rect &rect,
+                                 const JpegRealignParameters &params, JpegRegion &region, core::ShapeTransform &shapeToRegion);
+
+        /**
+            Decode the footprint region of a face from a JPEG file. See decodeJpegFootprint for details.
+        */
+        bool decodeJpegFootprint(const core::Tracker &t, const std::string &path, const core::Rect &rect,
+                                 const JpegRealignParameters &params, JpegRegion &region, core::ShapeTransform &shapeToRegion);
+
+        /**
+            Predict landmarks from a stored face rectangle, decoding only the image region the tracker samples from.
+
+            Faces are aligned using the default shape normalization estimateSimilarityTransform(unitRectangle(), rect),
+            which needs to match training.
+
+            \param t Tracker
+            \param data Compressed image.
+            \param size Size of compressed image in bytes.
+            \param rect Face rectangle in full resolution image coordinates.
+            \param params Re-alignment parameters.
+            \param shape Landmarks in full resolution image coordinates.
+            \param region If not null receives the decoded region.
+            \returns True if successful, false otherwise
+        */
+        bool realignJpeg(const core::Tracker &t, const unsigned char *data, size_t size, const core::Rect &rect,
+                         const JpegRealignParameters &params, core::Shape &shape, JpegRegion *region = 0);
+
+        /**
+            Predict landmarks from a stored face rectangle and a JPEG file. See realignJpeg for details.
+        */
+        bool realignJpeg(const core::Tracker &t, const std::string &path, const core::Rect &rect,
+                         const JpegRealignParameters &params, core::Shape &shape, JpegRegion *region = 0);
+
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_SYNTHETIC_DATABASE_H
+#define DEST_SYNTHETIC_DATABASE_H
+
+#include <dest/core/config.h>
+#if !defined(DEST_WITH_OPENCV)
+    #error OpenCV is required for this part of DEST.
+#endif
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace dest {
+    namespace io {
+
+        /**
+            Parameters to control generation of synthetic on-disk databases.
+        */
+        struct SyntheticDatabaseParameters {
+            /**
+                Annotation format, one of imm, ibug or land. Defaults to ibug.
+            */
+            std::string format;
+
+            /**
+                Image file extension, one of png, jpg, jpeg or bmp as looked up by database loaders. Defaults to jpg.
+            */
+            std::string imageExtension;
+
+            /** Number of images to generate. Defaults to 100. */
+            int numImages;
+
+            /** Width and height of each image in pixels. Defaults to 512. */
+            int imageSize;
+
+            /** Seed of random number generator. Defaults to 10. */
+            unsigned int seed;
+
+            SyntheticDatabaseParameters();
+        };
+
+        /**
+            Inspect synthetic database parameters.
+        */
+        std::ostream& operator<<(std::ostream &stream, const SyntheticDatabaseParameters &obj);
+
+        /**
+            Number of landmarks used by the given annotation format, zero if the format is unknown.
+        */
+        int syntheticDatabaseLandmarkCount(const std::string &format);
+
+        /**
+            Whether images with the given file extension are found by database loaders.
+        */
+        bool syntheticDatabaseSupportsImageExtension(const std::string &extension);
+
+        /**
+            Write a database of synthetic faces readable by ShapeDatabase.
+
+            Faces are rendered by util::createSyntheticInputData. Its landmarks are resampled along the
+            landmark sequence to the number of landmarks of the requested format, so shapes do not carry the
+            semantics of real annotations. Use this to benchmark loading without access to real databases.
+
+            \param directory Existing directory to write to.
+            \param params Generation parameters.
+            \param files If not null receives the paths of all files written.
+            \returns True if successful, false otherwise or if format or image extension is not supported.
+        */
+        bool writeSyntheticDatabase(const std::string &directory, const SyntheticDatabaseParameters &params, std::vector<std::string> *files = 0);
+
+    }
+}
+
+#endif
@@ -0,0 +1,69 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_CPU_H
+#define DEST_CPU_H
+
+#include <string>
+
+namespace dest {
+    namespace util {
+
+        /**
+            Instruction set levels vectorized kernels are compiled for.
+
+            Levels are ordered, each level implies support for all lower levels.
+        */
+        enum InstructionSet {
+            ISA_GENERIC = 0,
+            ISA_SSE2 = 1,
+            ISA_AVX2 = 2,
+            ISA_AVX512 = 3
+        };
+
+        /**
+            Detect the highest instruction set level supported by CPU and operating system.
+
+            Only levels that have been compiled into DEST are reported. Without
+            DEST_WITH_ISA_DISPATCH this is always ISA_GENERIC.
+        */
+        InstructionSet detectInstructionSet();
+
+        /**
+            Access the instruction set level used by vectorized kernels.
+
+            On first use the level is initialized to the detected level. Setting the environment
+            variable DEST_ISA to one of generic, sse2, avx2 or avx512 caps the level for testing.
+        */
+        InstructionSet activeInstructionSet();
+
+        /**
+            Change the instruction set level used by vectorized kernels.
+
+            \returns false if the level is not supported on this host, true otherwise.
+        */
+        bool setActiveInstructionSet(InstructionSet isa);
+
+        /**
+            Human readable name of instruction set level.
+        */
+        const char *instructionSetName(InstructionSet isa);
+
+        /**
+            Parse instruction set level from name as returned by instructionSetName.
+
+            \returns true on success, false otherwise.
+        */
+        bool parseInstructionSet(const std::string &name, InstructionSet &isa);
+
+    }
+}
+
+#endif
@@ -0,0 +1,44 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_HASH_H
+#define DEST_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dest {
+    namespace util {
+
+        /**
+            Fast non-cryptographic 64 bit hash of a byte sequence.
+
+            Implements XXH64, which processes 32 bytes per step in four independent lanes and
+            runs close to memory bandwidth. Suitable for content addressing, not for security.
+
+            \param data Bytes to hash.
+            \param len Number of bytes.
+            \param seed Seed, different seeds give independent hashes.
+            \returns 64 bit hash value.
+        */
+        uint64_t hashBytes(const void *data, size_t len, uint64_t seed = 0);
+
+        /**
+            Combine two hash values into one.
+        */
+        inline uint64_t hashCombine(uint64_t a, uint64_t b) {
+            a ^= b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2);
+            return a;
+        }
+
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_PERF_COUNTERS_H
+#define DEST_PERF_COUNTERS_H
+
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+
+namespace dest {
+    namespace util {
+
+        /**
+            Hardware events measured by performance counters.
+        */
+        enum PerfEvent {
+            PERF_CYCLES = 0,
+            PERF_INSTRUCTIONS,
+            PERF_L1D_MISSES,
+            PERF_LLC_MISSES,
+            PERF_BRANCH_MISSES,
+            PERF_NUM_EVENTS
+        };
+
+        /**
+            Phases measurements are accumulated for.
+        */
+        enum PerfPhase {
+            PERF_PHASE_PREDICT = 0,
+            PERF_PHASE_FIT,
+            PERF_NUM_PHASES
+        };
+
+        /**
+            Measurements accumulated for a single phase.
+        */
+        struct PerfStats {
+            /** Number of measured scopes. */
+            uint64_t numScopes;
+
+            /** Wall clock time spent in measured scopes in milliseconds. */
+            double milliseconds;
+
+            /** Event counts, scaled when counters were multiplexed. */
+            uint64_t counts[PERF_NUM_EVENTS];
+
+            /** Whether the respective event was counted. False when counters are not available. */
+            bool valid[PERF_NUM_EVENTS];
+
+            PerfStats();
+
+            /** Instructions per cycle, zero if not counted. */
+            double instructionsPerCycle() const;
+
+            /** Event count per measured scope, zero if not counted. */
+            double perScope(PerfEvent e) const;
+        };
+
+        /**
+            Inspect performance statistics.
+        */
+        std::ostream& operator<<(std::ostream &stream, const PerfStats &obj);
+
+        /**
+            Test if hardware performance counters can be opened by the calling thread.
+
+            Counters are read through perf_event_open on Linux. They are commonly unavailable in
+            containers and virtual machines or restricted by kernel.perf_event_paranoid. On other
+            platforms this is always false.
+        */
+        bool perfCountersAvailable();
+
+        /**
+            Enable or disable measurements in PerfScope.
+
+            Disabled by default. Setting the environment variable DEST_PERF_COUNTERS to 1 enables
+            measurements on startup. When enabled but counters are unavailable, only scopes and
+            wall clock time are recorded.
+        */
+        void setPerfCountersEnabled(bool enabled);
+
+        /**
+            Test if measurements are enabled.
+        */
+        bool perfCountersEnabled();
+
+        /**
+            Access measurements accumulated for the given phase across all threads.
+        */
+        PerfStats perfStats(PerfPhase phase);
+
+        /**
+            Reset measurements of all phases.
+        */
+        void resetPerfStats();
+
+        /**
+            Human readable name of event.
+        */
+        const char *perfEventName(PerfEvent e);
+
+        /**
+            Human readable name of phase.
+        */
+        const char *perfPhaseName(PerfPhase p);
+
+        /**
+            Measures the calling thread from construction to destruction and accumulates into the
+            statistics of a phase.
+
+            Each thread lazily opens its own counter group on first use. Work offloaded to other
+            threads, such as OpenMP workers, is not counted. Nested scopes on the same thread are
+            only measured by the outermost scope. When measurements are disabled, a scope costs a
+            single atomic load.
+        */
+        class PerfScope {
+        public:
+            explicit PerfScope(PerfPhase phase);
+            ~PerfScope();
+
+        private:
+            PerfScope(const PerfScope &other);
+            PerfScope &operator=(const PerfScope &other);
+
+            void begin();
+            void end();
+
+            PerfPhase _phase;
+            bool _active;
+            bool _outermost;
+            uint64_t _start[PERF_NUM_EVENTS + 2];
+            std::chrono::steady_clock::time_point _startTime;
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_SPSC_QUEUE_H
+#define DEST_SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace dest {
+    namespace util {
+
+        /**
+            Bounded lock-free single-producer single-consumer queue.
+
+            A ring buffer whose capacity is rounded up to the next power of two. Exactly one
+            thread may push and exactly one other thread may pop concurrently. Producer and
+            consumer positions are kept on separate cache lines to avoid false sharing.
+        */
+        template<class T>
+        class SPSCQueue {
+        public:
+            explicit SPSCQueue(size_t capacity)
+            : _head(0), _tail(0)
+            {
+                size_t c = 2;
+                while (c < capacity)
+                    c <<= 1;
+                _buffer.resize(c);
+                _mask = c - 1;
+            }
+
+            /**
+                Append element.
+
+                \returns false if the queue is full, true otherwise.
+            */
+            bool push(const T &v) {
+                const size_t tail = _tail.load(std::memory_order_relaxed);
+                if (tail - _head.load(std::memory_order_acquire) > _mask)
+                    return false;
+
+                _buffer[tail & _mask] = v;
+                _tail.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+                Remove oldest element.
+
+                \returns false if the queue is empty, true otherwise.
+            */
+            bool pop(T &v) {
+                const size_t head = _head.load(std::memory_order_relaxed);
+                if (head == _tail.load(std::memory_order_acquire))
+                    return false;
+
+                v = _buffer[head & _mask];
+                _head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+                Test if queue is empty. Only reliable when called by the consumer.
+            */
+            bool empty() const {
+                return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+            }
+
+            /**
+                Maximum number of elements.
+            */
+            size_t capacity() const {
+                return _buffer.size();
+            }
+
+        private:
+            SPSCQueue(const SPSCQueue &other);
+            SPSCQueue &operator=(const SPSCQueue &other);
+
+            enum { CacheLineSize = 64 };
+
+            std::vector<T> _buffer;
+            size_t _mask;
+            char _pad0[CacheLineSize];
+            std::atomic<size_t> _head;
+            char _pad1[CacheLineSize];
+            std::atomic<size_t> _tail;
+            char _pad2[CacheLineSize];
+        };
+
+    }
+}
+
+#endif
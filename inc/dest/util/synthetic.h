@@ -0,0 +1,163 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_SYNTHETIC_H
+#define DEST_SYNTHETIC_H
+
+#include <dest/core/shape.h>
+#include <dest/core/image.h>
+#include <dest/core/training_data.h>
+#include <random>
+
+namespace dest {
+    namespace util {
+
+        /**
+            Mean landmark configuration of a synthetic face.
+
+            The synthetic face consists of 22 landmarks (contour, eyebrows, eyes, nose and mouth)
+            given in normalized shape space, i.e. roughly covering the unit rectangle.
+        */
+        core::Shape syntheticMeanFace();
+
+        /**
+            Randomly deform the synthetic mean face.
+
+            Applies small per-landmark jitter and expression like deformations (mouth opening,
+            eye size, jaw width) to the mean face.
+
+            \param rnd Random number generator.
+            \returns Deformed shape in normalized shape space.
+        */
+        core::Shape randomSyntheticFace(std::mt19937 &rnd);
+
+        /**
+            Render a synthetic face into the given image.
+
+            Draws a bright face ellipse bounded by the contour landmarks and dark blobs centered at
+            each landmark, so that intensities are correlated with landmark positions. Existing image
+            content outside of the face is preserved.
+
+            \param shape Landmarks in image space.
+            \param img Image to render into.
+        */
+        void renderSyntheticFace(const core::Shape &shape, core::Image &img);
+
+        /**
+            Fill the given image with a smooth random background texture.
+        */
+        void renderSyntheticBackground(std::mt19937 &rnd, core::Image &img);
+
+        /**
+            Create input data consisting of synthetic faces.
+
+            Each image contains a single face at random position, scale and rotation. Rectangles are
+            set to the tight shape bounds. Use InputData::normalizeShapes afterwards as usual.
+
+            \param numImages Number of images to generate.
+            \param imageSize Width and height of each image in pixels.
+            \param rnd Random number generator.
+            \param input Input data to append to.
+        */
+        void createSyntheticInputData(int numImages, int imageSize, std::mt19937 &rnd, core::InputData &input);
+
+        /**
+            Parameters to control synthetic video sequences.
+        */
+        struct SyntheticVideoParameters {
+            /** Frame width in pixels. Defaults to 320. */
+            int width;
+
+            /** Frame height in pixels. Defaults to 240. */
+            int height;
+
+            /** Number of frames. Defaults to 300. */
+            int numFrames;
+
+            /** Mean face size as fraction of the smaller frame dimension. Defaults to 0.5. */
+            float faceSize;
+
+            /** Peak face translation in pixels per frame. Defaults to 4. */
+            float maxSpeed;
+
+            /** Peak in-plane rotation in radians. Defaults to pi / 12. */
+            float maxRotation;
+
+            /** Number of frames of one full rotation cycle. Defaults to 90. */
+            int rotationPeriod;
+
+            /**
+                Number of consecutive frames the face is visible before it disappears for hiddenFrames
+                frames. Defaults to 300.
+            */
+            int visibleFrames;
+
+            /** Number of consecutive frames without face. Zero keeps the face always visible. Defaults to 0. */
+            int hiddenFrames;
+
+            /** Standard deviation of per-frame intensity noise. Defaults to 2. */
+            float noise;
+
+            /** Seed of random number generator. Defaults to 10. */
+            unsigned int seed;
+
+            SyntheticVideoParameters();
+        };
+
+        /**
+            Video sequence of a synthetic face moving smoothly over a static textured background.
+
+            Position, rotation, scale and mouth opening of the face vary smoothly with known landmark
+            trajectories. Frames are rendered on demand and are deterministic for a given frame index,
+            so that sequences of arbitrary length do not need to be kept in memory.
+        */
+        class SyntheticVideo {
+        public:
+            SyntheticVideo(const SyntheticVideoParameters &params = SyntheticVideoParameters());
+
+            /**
+                Number of frames in sequence.
+            */
+            int numFrames() const;
+
+            /**
+                True if the face is visible in the given frame.
+            */
+            bool faceVisible(int frame) const;
+
+            /**
+                Ground truth landmarks of the given frame in image space. Defined for all frames,
+                also when the face is not visible.
+            */
+            core::Shape shape(int frame) const;
+
+            /**
+                Render a frame.
+
+                \param frame Index of frame.
+                \param img Image to render into. Resized as necessary.
+                \returns True if the face is visible in the frame.
+            */
+            bool render(int frame, core::Image &img) const;
+
+        private:
+            SyntheticVideoParameters _params;
+            core::Image _background;
+            core::Shape _face;
+            Eigen::Vector2f _amplitude;
+            Eigen::Vector2f _frequency;
+            Eigen::Vector2f _phase;
+            float _scalePhase;
+            float _mouthPhase;
+        };
+    }
+}
+
+#endif
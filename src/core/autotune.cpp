@@ -0,0 +1,424 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/autotune.h>
+#include <dest/core/config.h>
+#include <dest/util/log.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#ifdef DEST_WITH_OPENMP
+#include <omp.h>
+#endif
+
+namespace dest {
+    namespace core {
+
+        const char *predictEngineName(PredictEngine e)
+        {
+            switch (e) {
+            case ENGINE_SINGLE: return "single";
+            case ENGINE_PIPELINED: return "pipelined";
+            default: return "batched";
+            }
+        }
+
+        bool parsePredictEngine(const std::string &name, PredictEngine &e)
+        {
+            const PredictEngine all[] = { ENGINE_SINGLE, ENGINE_BATCHED, ENGINE_PIPELINED };
+            for (int i = 0; i < 3; ++i) {
+                if (name == predictEngineName(all[i])) {
+                    e = all[i];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline const char *samplingStrategyName(SamplingStrategy s)
+        {
+            switch (s) {
+            case SAMPLING_EAGER: return "eager";
+            case SAMPLING_LAZY: return "lazy";
+            default: return "auto";
+            }
+        }
+
+        inline bool parseSamplingStrategy(const std::string &name, SamplingStrategy &s)
+        {
+            const SamplingStrategy all[] = { SAMPLING_EAGER, SAMPLING_LAZY, SAMPLING_AUTO };
+            for (int i = 0; i < 3; ++i) {
+                if (name == samplingStrategyName(all[i])) {
+                    s = all[i];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline int hardwareThreads()
+        {
+            return std::max<int>(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+
+        inline int currentNumThreads()
+        {
+#ifdef DEST_WITH_OPENMP
+            return omp_get_max_threads();
+#else
+            return 1;
+#endif
+        }
+
+        inline void setNumThreads(int n)
+        {
+#ifdef DEST_WITH_OPENMP
+            if (n > 0)
+                omp_set_num_threads(n);
+#else
+            (void)n;
+#endif
+        }
+
+        RuntimeProfile::RuntimeProfile()
+        {
+            isa = util::detectInstructionSet();
+            samplingStrategy = SAMPLING_AUTO;
+            engine = ENGINE_BATCHED;
+            batchSize = 32;
+            numThreads = 0;
+            pipelineStages = 2;
+            facesPerSecond = 0.f;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const RuntimeProfile &obj) {
+            stream << std::setw(30) << std::left << "Instruction set" << std::setw(10) << util::instructionSetName(obj.isa) << std::endl
+                   << std::setw(30) << std::left << "Sampling strategy" << std::setw(10) << samplingStrategyName(obj.samplingStrategy) << std::endl
+                   << std::setw(30) << std::left << "Engine" << std::setw(10) << predictEngineName(obj.engine) << std::endl
+                   << std::setw(30) << std::left << "Batch size" << std::setw(10) << obj.batchSize << std::endl
+                   << std::setw(30) << std::left << "Number of threads" << std::setw(10) << obj.numThreads << std::endl
+                   << std::setw(30) << std::left << "Pipeline stages" << std::setw(10) << obj.pipelineStages << std::endl
+                   << std::setw(30) << std::left << "Faces per second" << std::setw(10) << obj.facesPerSecond;
+            return stream;
+        }
+
+        bool saveRuntimeProfile(const std::string &path, const RuntimeProfile &p)
+        {
+            std::ofstream ofs(path.c_str());
+            if (!ofs.is_open())
+                return false;
+
+            ofs << "# DEST runtime profile" << std::endl
+                << "isa=" << util::instructionSetName(p.isa) << std::endl
+                << "sampling=" << samplingStrategyName(p.samplingStrategy) << std::endl
+                << "engine=" << predictEngineName(p.engine) << std::endl
+                << "batch_size=" << p.batchSize << std::endl
+                << "threads=" << p.numThreads << std::endl
+                << "pipeline_stages=" << p.pipelineStages << std::endl
+                << "faces_per_second=" << p.facesPerSecond << std::endl;
+
+            return !ofs.bad();
+        }
+
+        template<class T>
+        inline bool parseNumber(const std::string &str, T &value)
+        {
+            std::istringstream iss(str);
+            T v;
+            if (!(iss >> v) || !iss.eof())
+                return false;
+            value = v;
+            return true;
+        }
+
+        bool loadRuntimeProfile(const std::string &path, RuntimeProfile &p)
+        {
+            std::ifstream ifs(path.c_str());
+            if (!ifs.is_open())
+                return false;
+
+            RuntimeProfile r = p;
+            std::string line;
+            while (std::getline(ifs, line)) {
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                    line.erase(line.size() - 1);
+                if (line.empty() || line[0] == '#')
+                    continue;
+
+                const size_t eq = line.find('=');
+                if (eq == std::string::npos)
+                    return false;
+
+                const std::string key = line.substr(0, eq);
+                const std::string value = line.substr(eq + 1);
+
+                bool ok = true;
+                if (key == "isa") {
+                    ok = util::parseInstructionSet(value, r.isa);
+                } else if (key == "sampling") {
+                    ok = parseSamplingStrategy(value, r.samplingStrategy);
+                } else if (key == "engine") {
+                    ok = parsePredictEngine(value, r.engine);
+                } else if (key == "batch_size") {
+                    ok = parseNumber(value, r.batchSize) && r.batchSize > 0;
+                } else if (key == "threads") {
+                    ok = parseNumber(value, r.numThreads) && r.numThreads >= 0;
+                } else if (key == "pipeline_stages") {
+                    ok = parseNumber(value, r.pipelineStages) && r.pipelineStages > 0;
+                } else if (key == "faces_per_second") {
+                    ok = parseNumber(value, r.facesPerSecond);
+                }
+
+                if (!ok) {
+                    DEST_LOG("Invalid value for " << key << " in runtime profile." << std::endl);
+                    return false;
+                }
+            }
+
+            p = r;
+            return true;
+        }
+
+        std::string runtimeProfilePath(const std::string &trackerPath)
+        {
+            return trackerPath + ".profile";
+        }
+
+        void applyRuntimeProfile(const RuntimeProfile &p, Tracker &t)
+        {
+            util::setActiveInstructionSet(std::min<util::InstructionSet>(p.isa, util::detectInstructionSet()));
+            setNumThreads(p.numThreads);
+            t.setSamplingStrategy(p.samplingStrategy);
+        }
+
+        void applyRuntimeProfile(const RuntimeProfile &p, CoalescerParameters &params)
+        {
+            params.maxBatchSize = p.batchSize;
+        }
+
+        void applyRuntimeProfile(const RuntimeProfile &p, PipelineParameters &params)
+        {
+            params.numStages = p.pipelineStages;
+        }
+
+        struct ProfiledPredictor::data {
+            RuntimeProfile profile;
+            const Tracker *tracker;
+            std::unique_ptr<PipelinedTracker> pipeline;
+        };
+
+        ProfiledPredictor::ProfiledPredictor(const RuntimeProfile &p, const Tracker &t)
+        : _data(new data())
+        {
+            _data->profile = p;
+            _data->tracker = &t;
+
+            if (p.engine == ENGINE_PIPELINED) {
+                PipelineParameters pp;
+                applyRuntimeProfile(p, pp);
+                _data->pipeline.reset(new PipelinedTracker(t, pp));
+            }
+        }
+
+        ProfiledPredictor::~ProfiledPredictor()
+        {}
+
+        const RuntimeProfile &ProfiledPredictor::profile() const
+        {
+            return _data->profile;
+        }
+
+        void ProfiledPredictor::predict(const std::vector<MappedImage> &imgs,
+                                        const std::vector<ShapeTransform> &shapeToImage,
+                                        std::vector<Shape> &shapes)
+        {
+            eigen_assert(imgs.size() == shapeToImage.size());
+
+            const RuntimeProfile &p = _data->profile;
+            const Tracker &t = *_data->tracker;
+            const size_t numFaces = imgs.size();
+            shapes.resize(numFaces);
+
+            if (p.engine == ENGINE_SINGLE) {
+                for (size_t i = 0; i < numFaces; ++i) {
+                    shapes[i] = t.predict(imgs[i], shapeToImage[i]);
+                }
+            } else if (p.engine == ENGINE_BATCHED) {
+                const size_t batchSize = static_cast<size_t>(std::max<int>(1, p.batchSize));
+                std::vector<Shape> batchShapes;
+                for (size_t i = 0; i < numFaces; i += batchSize) {
+                    const size_t end = std::min<size_t>(numFaces, i + batchSize);
+                    std::vector<MappedImage> batchImgs(imgs.begin() + i, imgs.begin() + end);
+                    std::vector<ShapeTransform> batchTransforms(shapeToImage.begin() + i, shapeToImage.begin() + end);
+                    t.predict(batchImgs, batchTransforms, batchShapes);
+                    std::copy(batchShapes.begin(), batchShapes.end(), shapes.begin() + i);
+                }
+            } else {
+                std::vector< std::future<Shape> > results;
+                results.reserve(numFaces);
+                for (size_t i = 0; i < numFaces; ++i) {
+                    results.push_back(_data->pipeline->submit(imgs[i], shapeToImage[i]));
+                }
+                for (size_t i = 0; i < numFaces; ++i) {
+                    shapes[i] = results[i].get();
+                }
+            }
+        }
+
+        void predictWithRuntimeProfile(const RuntimeProfile &p, const Tracker &t,
+                                       const std::vector<MappedImage> &imgs,
+                                       const std::vector<ShapeTransform> &shapeToImage,
+                                       std::vector<Shape> &shapes)
+        {
+            ProfiledPredictor predictor(p, t);
+            predictor.predict(imgs, shapeToImage, shapes);
+        }
+
+        AutotuneParameters::AutotuneParameters()
+        {
+            const int sizes[] = { 4, 8, 16, 32, 64 };
+            batchSizes.assign(sizes, sizes + 5);
+
+            const int n = hardwareThreads();
+            for (int i = 1; i < n; i *= 2)
+                threadCounts.push_back(i);
+            threadCounts.push_back(n);
+
+            maxPipelineStages = n;
+            numRepetitions = 3;
+        }
+
+        typedef std::chrono::steady_clock Clock;
+
+        /** Faces per second of the fastest of several passes over all faces. */
+        inline float measureThroughput(const Tracker &t,
+                                       const std::vector<MappedImage> &imgs,
+                                       const std::vector<ShapeTransform> &shapeToImage,
+                                       const RuntimeProfile &p,
+                                       int numRepetitions)
+        {
+            const size_t numFaces = imgs.size();
+            double best = 0.0;
+
+            // Engine setup, such as starting pipeline threads, is not part of the measurement.
+            ProfiledPredictor predictor(p, t);
+
+            std::vector<Shape> shapes;
+            for (int r = 0; r < numRepetitions; ++r) {
+                Clock::time_point start = Clock::now();
+                predictor.predict(imgs, shapeToImage, shapes);
+                const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                best = std::max<double>(best, numFaces / std::max<double>(seconds, 1e-9));
+            }
+
+            return static_cast<float>(best);
+        }
+
+        RuntimeProfile autotune(const Tracker &tracker,
+                                const std::vector<Image> &imgs,
+                                const std::vector<ShapeTransform> &shapeToImage,
+                                const AutotuneParameters &params,
+                                std::vector<RuntimeProfile> *trials)
+        {
+            eigen_assert(imgs.size() == shapeToImage.size());
+
+            RuntimeProfile best;
+            if (imgs.empty() || tracker.numCascades() == 0)
+                return best;
+
+            const util::InstructionSet initialIsa = util::activeInstructionSet();
+            const int initialThreads = currentNumThreads();
+            const int numRepetitions = std::max<int>(1, params.numRepetitions);
+
+            // Work on a copy, sampling strategies are switched during tuning.
+            Tracker t(tracker);
+
+            std::vector<MappedImage> mapped;
+            for (size_t i = 0; i < imgs.size(); ++i) {
+                mapped.push_back(MappedImage(imgs[i].data(), imgs[i].rows(), imgs[i].cols(), Eigen::OuterStride<Eigen::Dynamic>(imgs[i].cols())));
+            }
+
+            // Evaluate trial and keep it if faster than the best one so far.
+            auto evaluate = [&](RuntimeProfile p) {
+                util::setActiveInstructionSet(p.isa);
+                setNumThreads(p.numThreads > 0 ? p.numThreads : initialThreads);
+                t.setSamplingStrategy(p.samplingStrategy);
+
+                p.facesPerSecond = measureThroughput(t, mapped, shapeToImage, p, numRepetitions);
+
+                // Format locally, stream flags must not leak into the shared log stream.
+                std::ostringstream rate;
+                rate << std::setprecision(0) << std::fixed << p.facesPerSecond;
+                DEST_LOG("Autotune " << predictEngineName(p.engine)
+                         << " isa=" << util::instructionSetName(p.isa)
+                         << " sampling=" << samplingStrategyName(p.samplingStrategy)
+                         << " batch=" << p.batchSize
+                         << " threads=" << p.numThreads
+                         << " stages=" << p.pipelineStages
+                         << ": " << rate.str() << " faces/s" << std::endl);
+
+                if (trials)
+                    trials->push_back(p);
+                if (p.facesPerSecond > best.facesPerSecond)
+                    best = p;
+            };
+
+            // Instruction set and sampling strategy by single face throughput.
+            const SamplingStrategy strategies[] = { SAMPLING_EAGER, SAMPLING_LAZY, SAMPLING_AUTO };
+            const util::InstructionSet maxIsa = util::detectInstructionSet();
+
+            RuntimeProfile p;
+            p.engine = ENGINE_SINGLE;
+            p.numThreads = 0;
+            for (int isa = util::ISA_GENERIC; isa <= maxIsa; ++isa) {
+                for (int s = 0; s < 3; ++s) {
+                    p.isa = static_cast<util::InstructionSet>(isa);
+                    p.samplingStrategy = strategies[s];
+                    evaluate(p);
+                }
+            }
+
+            // Engines, keeping instruction set and sampling strategy.
+            p = best;
+
+            p.engine = ENGINE_BATCHED;
+#ifdef DEST_WITH_OPENMP
+            const std::vector<int> threadCounts = params.threadCounts;
+#else
+            const std::vector<int> threadCounts(1, 0);
+#endif
+            for (size_t b = 0; b < params.batchSizes.size(); ++b) {
+                for (size_t n = 0; n < threadCounts.size(); ++n) {
+                    p.batchSize = std::max<int>(1, params.batchSizes[b]);
+                    p.numThreads = threadCounts[n];
+                    evaluate(p);
+                }
+            }
+
+            p.engine = ENGINE_PIPELINED;
+            p.numThreads = 0;
+            const int maxStages = std::min<int>(params.maxPipelineStages, t.numCascades());
+            for (int s = 2; s <= maxStages; ++s) {
+                p.pipelineStages = s;
+                evaluate(p);
+            }
+
+            util::setActiveInstructionSet(initialIsa);
+            setNumThreads(initialThreads);
+
+            return best;
+        }
+
+    }
+}
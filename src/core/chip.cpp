@@ -0,0 +1,151 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/chip.h>
+#include <dest/core/config.h>
+#include "image_kernels.h"
+#include <algorithm>
+
+namespace dest {
+    namespace core {
+
+        ChipParameters::ChipParameters()
+        {
+            width = 112;
+            height = 112;
+            padding = 0.1f;
+        }
+
+        Shape chipReferenceShape(const Shape &s, const ChipParameters &params)
+        {
+            const Eigen::Vector2f minC = s.rowwise().minCoeff();
+            const Eigen::Vector2f maxC = s.rowwise().maxCoeff();
+            const Eigen::Vector2f extent = (maxC - minC).cwiseMax(Eigen::Vector2f::Constant(1e-6f));
+
+            const Eigen::Vector2f chipSize(static_cast<float>(params.width), static_cast<float>(params.height));
+            const Eigen::Vector2f usable = chipSize * (1.f - 2.f * params.padding);
+            const float scale = usable.cwiseQuotient(extent).minCoeff();
+
+            const Eigen::Vector2f center = (minC + maxC) * 0.5f;
+            const Eigen::Vector2f chipCenter = (chipSize - Eigen::Vector2f::Ones()) * 0.5f;
+
+            return ((s.colwise() - center) * scale).colwise() + chipCenter;
+        }
+
+        /** Sampling source of a chip. */
+        struct ChipSource {
+            const unsigned char *data;
+            int rows, cols, stride;
+            ShapeTransform chipToImage;
+        };
+
+        inline void extractChips(const std::vector<ChipSource> &sources, const ChipParameters &params, float *chips)
+        {
+            const int numChips = static_cast<int>(sources.size());
+            const int width = params.width;
+            const int height = params.height;
+            const int numRows = numChips * height;
+
+            kernels::ReadImageFn fn = kernels::readImageKernel();
+
+#ifdef DEST_WITH_OPENMP
+            #pragma omp parallel
+#endif
+            {
+                std::vector<float> coords(2 * width);
+
+#ifdef DEST_WITH_OPENMP
+                #pragma omp for schedule(static)
+#endif
+                for (int r = 0; r < numRows; ++r) {
+                    const ChipSource &src = sources[r / height];
+                    const int y = r % height;
+                    float *dst = chips + static_cast<size_t>(r) * width;
+
+                    if (src.rows == 0 || src.cols == 0) {
+                        std::fill(dst, dst + width, 0.f);
+                        continue;
+                    }
+
+                    // Image coordinates along a chip row are an arithmetic progression.
+                    const Eigen::Vector2f start = src.chipToImage * Eigen::Vector2f(0.f, static_cast<float>(y));
+                    const Eigen::Vector2f step = src.chipToImage.linear().col(0);
+
+                    for (int x = 0; x < width; ++x) {
+                        coords[2 * x + 0] = start.x() + x * step.x();
+                        coords[2 * x + 1] = start.y() + x * step.y();
+                    }
+
+                    fn(src.data, src.rows, src.cols, src.stride, coords.data(), width, dst);
+                }
+            }
+        }
+
+        /**
+            Least squares similarity transform taking reference onto shape in closed form.
+
+            Unlike estimateSimilarityTransform, whose rotation convention trained trackers depend on,
+            this always rotates in the direction from reference to shape, as chips need to follow the face.
+        */
+        inline ShapeTransform estimateChipTransform(const Shape &reference, const Shape &shape) {
+            const Eigen::Vector2f meanFrom = reference.rowwise().mean();
+            const Eigen::Vector2f meanTo = shape.rowwise().mean();
+
+            const Shape from = reference.colwise() - meanFrom;
+            const Shape to = shape.colwise() - meanTo;
+
+            // Similarity as complex multiplication z -> (a + ib) z minimizing squared distances.
+            const float norm = std::max<float>(from.squaredNorm(), 1e-12f);
+            const float a = (from.row(0).dot(to.row(0)) + from.row(1).dot(to.row(1))) / norm;
+            const float b = (from.row(0).dot(to.row(1)) - from.row(1).dot(to.row(0))) / norm;
+
+            Eigen::Matrix2f linear;
+            linear << a, -b,
+                      b, a;
+
+            ShapeTransform t;
+            t.linear() = linear;
+            t.translation() = meanTo - linear * meanFrom;
+            return t;
+        }
+
+        inline ChipSource createChipSource(const Eigen::Ref<const Image> &img, const Shape &shape, const Shape &reference) {
+            ChipSource src;
+            src.data = img.data();
+            src.rows = static_cast<int>(img.rows());
+            src.cols = static_cast<int>(img.cols());
+            src.stride = static_cast<int>(img.outerStride());
+            src.chipToImage = estimateChipTransform(reference, shape);
+            return src;
+        }
+
+        void extractChips(const Eigen::Ref<const Image> &img, const std::vector<Shape> &shapes, const Shape &reference, const ChipParameters &params, float *chips)
+        {
+            std::vector<ChipSource> sources;
+            for (size_t i = 0; i < shapes.size(); ++i) {
+                sources.push_back(createChipSource(img, shapes[i], reference));
+            }
+
+            extractChips(sources, params, chips);
+        }
+
+        void extractChips(const std::vector<MappedImage> &imgs, const std::vector<Shape> &shapes, const Shape &reference, const ChipParameters &params, float *chips)
+        {
+            eigen_assert(imgs.size() == shapes.size());
+
+            std::vector<ChipSource> sources;
+            for (size_t i = 0; i < shapes.size(); ++i) {
+                sources.push_back(createChipSource(imgs[i], shapes[i], reference));
+            }
+
+            extractChips(sources, params, chips);
+        }
+    }
+}
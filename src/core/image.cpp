@@ -9,48 +9,375 @@
 */
 
 #include <dest/core/image.h>
+#include "image_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 namespace dest {
     namespace core {
-        
-        inline int clampToEdge(int v, Image::Index len) {
-            return std::min<int>(static_cast<int>(len) - 1, std::max<int>(0, v));
-        }
-        
-        inline float bilinearSample(const Eigen::Ref<const Image> &img, float x, float y) {
-            
-            const int ix = static_cast<int>(std::floor(x));
-            const int iy = static_cast<int>(std::floor(y));
-            
-            int x0 = clampToEdge(ix, img.cols());
-            int x1 = clampToEdge(ix + 1, img.cols());
-            int y0 = clampToEdge(iy, img.rows());
-            int y1 = clampToEdge(iy + 1, img.rows());
-
-            float a = x - (float)ix;
-            float b = y - (float)iy;
-            
-            const unsigned char *ptrY0 = img.row(y0).data();
-            const unsigned char *ptrY1 = img.row(y1).data();
-            
-            const float f0 = static_cast<float>(ptrY0[x0]);
-            const float f1 = static_cast<float>(ptrY0[x1]);
-            const float f2 = static_cast<float>(ptrY1[x0]);
-            const float f3 = static_cast<float>(ptrY1[x1]);
-            
-            return (f0 * (float(1) - a) + f1 * a) * (float(1) - b) +
-                   (f2 * (float(1) - a) + f3 * a) * b;
-        }
-        
+        namespace kernels {
+
+            inline int clampToEdge(int v, int len) {
+                return std::min<int>(len - 1, std::max<int>(0, v));
+            }
+
+            inline float bilinearSample(const unsigned char *data, int rows, int cols, int stride, float x, float y) {
+
+                // Restrict to one pixel outside of image, sampling beyond is clamped to edge anyway.
+                x = std::min<float>(static_cast<float>(cols), std::max<float>(-1.f, x));
+                y = std::min<float>(static_cast<float>(rows), std::max<float>(-1.f, y));
+
+                const int ix = static_cast<int>(std::floor(x));
+                const int iy = static_cast<int>(std::floor(y));
+
+                int x0 = clampToEdge(ix, cols);
+                int x1 = clampToEdge(ix + 1, cols);
+                int y0 = clampToEdge(iy, rows);
+                int y1 = clampToEdge(iy + 1, rows);
+
+                float a = x - (float)ix;
+                float b = y - (float)iy;
+
+                const unsigned char *ptrY0 = data + static_cast<size_t>(y0) * stride;
+                const unsigned char *ptrY1 = data + static_cast<size_t>(y1) * stride;
+
+                const float f0 = static_cast<float>(ptrY0[x0]);
+                const float f1 = static_cast<float>(ptrY0[x1]);
+                const float f2 = static_cast<float>(ptrY1[x0]);
+                const float f3 = static_cast<float>(ptrY1[x1]);
+
+                return (f0 * (float(1) - a) + f1 * a) * (float(1) - b) +
+                       (f2 * (float(1) - a) + f3 * a) * b;
+            }
+
+            void readImageGeneric(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities)
+            {
+                for (int i = 0; i < numCoords; ++i) {
+                    intensities[i] = bilinearSample(data, rows, cols, stride, coords[2 * i + 0], coords[2 * i + 1]);
+                }
+            }
+
+            ReadImageFn readImageKernel(util::InstructionSet isa)
+            {
+#ifdef DEST_WITH_ISA_DISPATCH
+                switch (isa) {
+                case util::ISA_AVX512: return readImageAVX512;
+                case util::ISA_AVX2: return readImageAVX2;
+                case util::ISA_SSE2: return readImageSSE2;
+                default: return readImageGeneric;
+                }
+#else
+                return readImageGeneric;
+#endif
+            }
+        }
+
+        /** Compute the i-th location given relative to anchor points. */
+        inline void relativeLocation(float a00, float a01, float a10, float a11,
+                                     const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors,
+                                     int i, float &x, float &y)
+        {
+            const float ox = offsets(0, i);
+            const float oy = offsets(1, i);
+            const int a = anchorIds(i);
+            x = a00 * ox + a01 * oy + anchors(0, a);
+            y = a10 * ox + a11 * oy + anchors(1, a);
+        }
+
         void readImage(const Eigen::Ref<const Image> &img, const PixelCoordinates &coords, PixelIntensities &intensities) {
-            const int numCoords = static_cast<int>(coords.cols());
-            
             intensities.resize(coords.cols());
-            
+
+            if (img.size() == 0 || coords.cols() == 0)
+                return;
+
+            kernels::ReadImageFn fn = kernels::readImageKernel();
+
+            fn(img.data(),
+               static_cast<int>(img.rows()),
+               static_cast<int>(img.cols()),
+               static_cast<int>(img.outerStride()),
+               coords.data(),
+               static_cast<int>(coords.cols()),
+               intensities.data());
+        }
+
+        void readImage(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors, PixelIntensities &intensities)
+        {
+            const int numCoords = static_cast<int>(offsets.cols());
+
+            PixelCoordinates coords(2, numCoords);
             for (int i = 0; i < numCoords; ++i) {
-                intensities(i) = bilinearSample(img, coords(0, i), coords(1, i));
+                relativeLocation(A(0, 0), A(0, 1), A(1, 0), A(1, 1), offsets, anchorIds, anchors, i, coords(0, i), coords(1, i));
+            }
+
+            readImage(img, coords, intensities);
+        }
+
+        ImagePyramid::ImagePyramid()
+        : _data(0), _stride(0), _x(0), _y(0), _width(0), _height(0), _tileSize(0), _tileShift(0), _tileRows(0), _tileCols(0)
+        {}
+
+        void ImagePyramid::prepare(const Eigen::Ref<const Image> &img, int x, int y, int width, int height, int numLevels)
+        {
+            // Clip region to image
+            const int x0 = std::max<int>(0, x);
+            const int y0 = std::max<int>(0, y);
+            const int x1 = std::min<int>(static_cast<int>(img.cols()), x + width);
+            const int y1 = std::min<int>(static_cast<int>(img.rows()), y + height);
+
+            _x = x0;
+            _y = y0;
+            _width = std::max<int>(0, x1 - x0);
+            _height = std::max<int>(0, y1 - y0);
+            _levels.clear();
+            _tileComputed.clear();
+            _tileRows = _tileCols = 0;
+
+            if (_width == 0 || _height == 0 || numLevels <= 0)
+                return;
+
+            _data = img.data() + static_cast<size_t>(y0) * img.outerStride() + x0;
+            _stride = static_cast<int>(img.outerStride());
+
+            _levels.resize(numLevels);
+            int rows = _height;
+            int cols = _width;
+            for (int l = 0; l < numLevels; ++l) {
+                rows = (rows + 1) / 2;
+                cols = (cols + 1) / 2;
+                _levels[l].resize(rows, cols);
             }
+
+            // Tiles are aligned to pixels of the coarsest level, so that no tile depends on pixels of another.
+            _tileShift = std::max<int>(6, numLevels);
+            _tileSize = 1 << _tileShift;
+            _tileRows = (_height + _tileSize - 1) / _tileSize;
+            _tileCols = (_width + _tileSize - 1) / _tileSize;
+            _tileComputed.assign(static_cast<size_t>(_tileRows) * _tileCols, 0);
         }
-        
+
+        void ImagePyramid::computeTile(int tu, int tv)
+        {
+            const unsigned char *src = _data;
+            int srcRows = _height;
+            int srcCols = _width;
+            size_t srcStride = static_cast<size_t>(_stride);
+
+            for (int l = 0; l < static_cast<int>(_levels.size()); ++l) {
+                Image &dst = _levels[l];
+
+                const int n = _tileSize >> (l + 1);
+                const int r0 = tv * n;
+                const int c0 = tu * n;
+                const int r1 = std::min<int>(r0 + n, static_cast<int>(dst.rows()));
+                const int c1 = std::min<int>(c0 + n, static_cast<int>(dst.cols()));
+                // Columns whose 2x2 block lies inside the source. Only the last column of odd sources replicates.
+                const int cInner = std::max<int>(c0, std::min<int>(c1, srcCols / 2));
+
+                // 2x2 box filter, odd borders replicate the last row / column.
+                for (int r = r0; r < r1; ++r) {
+                    const unsigned char *row0 = src + static_cast<size_t>(2 * r) * srcStride;
+                    const unsigned char *row1 = src + static_cast<size_t>(std::min<int>(2 * r + 1, srcRows - 1)) * srcStride;
+                    unsigned char *out = dst.data() + static_cast<size_t>(r) * dst.cols();
+
+                    for (int c = c0; c < cInner; ++c) {
+                        out[c] = static_cast<unsigned char>((row0[2 * c] + row0[2 * c + 1] + row1[2 * c] + row1[2 * c + 1] + 2) >> 2);
+                    }
+                    for (int c = cInner; c < c1; ++c) {
+                        const int cl = std::min<int>(2 * c + 1, srcCols - 1);
+                        out[c] = static_cast<unsigned char>((row0[2 * c] + row0[cl] + row1[2 * c] + row1[cl] + 2) >> 2);
+                    }
+                }
+
+                src = dst.data();
+                srcRows = static_cast<int>(dst.rows());
+                srcCols = static_cast<int>(dst.cols());
+                srcStride = static_cast<size_t>(dst.cols());
+            }
+
+            _tileComputed[static_cast<size_t>(tv) * _tileCols + tu] = 1;
+        }
+
+        void ImagePyramid::create(const Eigen::Ref<const Image> &img, int x, int y, int width, int height, int numLevels)
+        {
+            prepare(img, x, y, width, height, numLevels);
+
+            for (int tv = 0; tv < _tileRows; ++tv) {
+                for (int tu = 0; tu < _tileCols; ++tu) {
+                    computeTile(tu, tv);
+                }
+            }
+
+            // Fully computed, no bookkeeping required.
+            _tileComputed.clear();
+        }
+
+        void ImagePyramid::createLazy(const Eigen::Ref<const Image> &img, int x, int y, int width, int height, int numLevels)
+        {
+            prepare(img, x, y, width, height, numLevels);
+        }
+
+        int ImagePyramid::numLevels() const
+        {
+            return static_cast<int>(_levels.size());
+        }
+
+        const Image &ImagePyramid::level(int l) const
+        {
+            return _levels[l - 1];
+        }
+
+        const Image &ImagePyramid::level(int l, const Eigen::AlignedBox2f &bounds)
+        {
+            if (_tileComputed.empty() || bounds.isEmpty())
+                return _levels[l - 1];
+
+            const Image &level = _levels[l - 1];
+            const int rows = static_cast<int>(level.rows());
+            const int cols = static_cast<int>(level.cols());
+            const int shift = _tileShift - l;
+
+            // Pixels read by kernels::bilinearSample, clamped to [-1, size] as there. Ranges are widened by a pixel
+            // so that locations computed with different rounding by a sampling kernel find their pixels computed.
+            const Eigen::Vector2f lo = bounds.min().cwiseMax(-1.f).cwiseMin(Eigen::Vector2f(cols, rows));
+            const Eigen::Vector2f hi = bounds.max().cwiseMax(-1.f).cwiseMin(Eigen::Vector2f(cols, rows));
+
+            const int tu0 = kernels::clampToEdge(static_cast<int>(std::floor(lo.x())) - 1, cols) >> shift;
+            const int tu1 = kernels::clampToEdge(static_cast<int>(std::floor(hi.x())) + 2, cols) >> shift;
+            const int tv0 = kernels::clampToEdge(static_cast<int>(std::floor(lo.y())) - 1, rows) >> shift;
+            const int tv1 = kernels::clampToEdge(static_cast<int>(std::floor(hi.y())) + 2, rows) >> shift;
+
+            for (int tv = tv0; tv <= tv1; ++tv) {
+                for (int tu = tu0; tu <= tu1; ++tu) {
+                    if (!_tileComputed[static_cast<size_t>(tv) * _tileCols + tu])
+                        computeTile(tu, tv);
+                }
+            }
+
+            return level;
+        }
+
+        Eigen::AffineCompact2f ImagePyramid::imageToLevel(int l) const
+        {
+            // Center of level pixel u corresponds to image coordinate x + 2^l * u + (2^l - 1) / 2.
+            const float s = std::ldexp(1.f, l);
+            Eigen::AffineCompact2f t;
+            t.setIdentity();
+            t.linear() *= 1.f / s;
+            t.translation() = -Eigen::Vector2f(_x + 0.5f * (s - 1.f), _y + 0.5f * (s - 1.f)) / s;
+            return t;
+        }
+
+        LazyPixelIntensities::LazyPixelIntensities(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors)
+        : _data(img.data()),
+          _rows(static_cast<int>(img.rows())),
+          _cols(static_cast<int>(img.cols())),
+          _stride(static_cast<int>(img.outerStride())),
+          _a00(A(0, 0)), _a01(A(0, 1)), _a10(A(1, 0)), _a11(A(1, 1)),
+          _offsets(offsets),
+          _anchorIds(anchorIds),
+          _anchors(anchors),
+          _values(_own.values),
+          _valid(_own.valid)
+        {
+            _values.resize(offsets.cols());
+            _valid.assign((offsets.cols() + 31) / 32, 0u);
+        }
+
+        LazyPixelIntensities::LazyPixelIntensities(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &offsets, const Eigen::VectorXi &anchorIds, const PixelCoordinates &anchors, Buffer &buffer)
+        : _data(img.data()),
+          _rows(static_cast<int>(img.rows())),
+          _cols(static_cast<int>(img.cols())),
+          _stride(static_cast<int>(img.outerStride())),
+          _a00(A(0, 0)), _a01(A(0, 1)), _a10(A(1, 0)), _a11(A(1, 1)),
+          _offsets(offsets),
+          _anchorIds(anchorIds),
+          _anchors(anchors),
+          _values(buffer.values),
+          _valid(buffer.valid)
+        {
+            _values.resize(offsets.cols());
+            _valid.assign((offsets.cols() + 31) / 32, 0u);
+        }
+
+        float LazyPixelIntensities::sample(int idx) const
+        {
+            if (_rows == 0 || _cols == 0)
+                return 0.f;
+
+            float x, y;
+            relativeLocation(_a00, _a01, _a10, _a11, _offsets, _anchorIds, _anchors, idx, x, y);
+            return kernels::bilinearSample(_data, _rows, _cols, _stride, x, y);
+        }
+
+        int LazyPixelIntensities::numSampled() const
+        {
+            int count = 0;
+            for (size_t i = 0; i < _valid.size(); ++i) {
+                unsigned int w = _valid[i];
+                for (; w; w &= w - 1)
+                    ++count;
+            }
+            return count;
+        }
+
+        float measureLazySamplingCost(int numLocations, int numRepetitions)
+        {
+            typedef std::chrono::high_resolution_clock Clock;
+
+            const int size = 256;
+            const int numAnchors = 68;
+            numLocations = std::max<int>(1, numLocations);
+            numRepetitions = std::max<int>(1, numRepetitions);
+
+            std::mt19937 rnd(10);
+            std::uniform_int_distribution<int> intensity(0, 255);
+            std::uniform_int_distribution<int> anchor(0, numAnchors - 1);
+            std::uniform_real_distribution<float> position(0.25f * size, 0.75f * size);
+            std::uniform_real_distribution<float> offset(-0.2f * size, 0.2f * size);
+
+            Image img(size, size);
+            for (int i = 0; i < img.size(); ++i)
+                img.data()[i] = static_cast<unsigned char>(intensity(rnd));
+
+            PixelCoordinates anchors(2, numAnchors);
+            for (int i = 0; i < numAnchors; ++i)
+                anchors.col(i) = Eigen::Vector2f(position(rnd), position(rnd));
+
+            PixelCoordinates offsets(2, numLocations);
+            Eigen::VectorXi anchorIds(numLocations);
+            for (int i = 0; i < numLocations; ++i) {
+                offsets.col(i) = Eigen::Vector2f(offset(rnd), offset(rnd));
+                anchorIds(i) = anchor(rnd);
+            }
+
+            const Eigen::Matrix2f A = Eigen::Rotation2Df(0.1f).toRotationMatrix();
+            float sink = 0.f;
+
+            PixelIntensities intensities;
+            Clock::time_point start = Clock::now();
+            for (int r = 0; r < numRepetitions; ++r) {
+                readImage(img, A, offsets, anchorIds, anchors, intensities);
+                sink += intensities(r % numLocations);
+            }
+            const double eager = std::chrono::duration<double>(Clock::now() - start).count();
+
+            LazyPixelIntensities::Buffer buffer;
+            start = Clock::now();
+            for (int r = 0; r < numRepetitions; ++r) {
+                LazyPixelIntensities lazy(img, A, offsets, anchorIds, anchors, buffer);
+                for (int i = 0; i < numLocations; ++i)
+                    sink += lazy(i);
+            }
+            const double lazy = std::chrono::duration<double>(Clock::now() - start).count();
+
+            // Keep the compiler from dropping the sampling.
+            volatile float keep = sink;
+            (void)keep;
+
+            return eager > 0.0 ? static_cast<float>(lazy / eager) : 1.f;
+        }
+
     }
-}
\ No newline at end of file
+}
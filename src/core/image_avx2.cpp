@@ -0,0 +1,108 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+/*
+    Compiled with AVX2 code generation. Avoid including headers with inline functions
+    other than intrinsics, as their out-of-line copies might be picked by the linker
+    for callers compiled for lower instruction set levels.
+*/
+
+#include "image_kernels.h"
+
+#ifdef DEST_WITH_ISA_DISPATCH
+
+#include <immintrin.h>
+#include <stddef.h>
+
+namespace dest {
+    namespace core {
+        namespace kernels {
+
+            void readImageAVX2(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities)
+            {
+                // Gathers are limited to 32 bit offsets.
+                if (static_cast<long long>(rows) * stride >= 0x7FFFFFF0LL) {
+                    readImageSSE2(data, rows, cols, stride, coords, numCoords, intensities);
+                    return;
+                }
+
+                // Bytes are gathered as the unaligned 32 bit word starting at the byte. Near the end of
+                // the image the word is moved back to stay in bounds and the byte is shifted out of it.
+                const int lastWord = (rows - 1) * stride + cols - 4;
+                if (lastWord < 0) {
+                    readImageGeneric(data, rows, cols, stride, coords, numCoords, intensities);
+                    return;
+                }
+                const int *base = reinterpret_cast<const int*>(data);
+
+                const __m256 one = _mm256_set1_ps(1.f);
+                const __m256 zero = _mm256_setzero_ps();
+                const __m256 minusOne = _mm256_set1_ps(-1.f);
+                const __m256 maxX = _mm256_set1_ps(static_cast<float>(cols - 1));
+                const __m256 maxY = _mm256_set1_ps(static_cast<float>(rows - 1));
+                const __m256 outX = _mm256_set1_ps(static_cast<float>(cols));
+                const __m256 outY = _mm256_set1_ps(static_cast<float>(rows));
+                const __m256i vstride = _mm256_set1_epi32(stride);
+                const __m256i vlastWord = _mm256_set1_epi32(lastWord);
+                const __m256i byteMask = _mm256_set1_epi32(0xFF);
+
+                int i = 0;
+                for (; i + 8 <= numCoords; i += 8) {
+                    const __m256 p0 = _mm256_loadu_ps(coords + 2 * i);
+                    const __m256 p1 = _mm256_loadu_ps(coords + 2 * i + 8);
+
+                    // Deinterleave (x,y) pairs, shuffles operate per 128 bit lane.
+                    __m256 x = _mm256_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+                    __m256 y = _mm256_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+                    x = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(x), _MM_SHUFFLE(3, 1, 2, 0)));
+                    y = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(y), _MM_SHUFFLE(3, 1, 2, 0)));
+
+                    x = _mm256_min_ps(outX, _mm256_max_ps(minusOne, x));
+                    y = _mm256_min_ps(outY, _mm256_max_ps(minusOne, y));
+
+                    const __m256 fx = _mm256_floor_ps(x);
+                    const __m256 fy = _mm256_floor_ps(y);
+                    const __m256 a = _mm256_sub_ps(x, fx);
+                    const __m256 b = _mm256_sub_ps(y, fy);
+
+                    const __m256i x0 = _mm256_cvttps_epi32(_mm256_min_ps(maxX, _mm256_max_ps(zero, fx)));
+                    const __m256i x1 = _mm256_cvttps_epi32(_mm256_min_ps(maxX, _mm256_max_ps(zero, _mm256_add_ps(fx, one))));
+                    const __m256i y0 = _mm256_mullo_epi32(_mm256_cvttps_epi32(_mm256_min_ps(maxY, _mm256_max_ps(zero, fy))), vstride);
+                    const __m256i y1 = _mm256_mullo_epi32(_mm256_cvttps_epi32(_mm256_min_ps(maxY, _mm256_max_ps(zero, _mm256_add_ps(fy, one)))), vstride);
+
+                    __m256i off[4];
+                    off[0] = _mm256_add_epi32(y0, x0);
+                    off[1] = _mm256_add_epi32(y0, x1);
+                    off[2] = _mm256_add_epi32(y1, x0);
+                    off[3] = _mm256_add_epi32(y1, x1);
+
+                    __m256 f[4];
+                    for (int k = 0; k < 4; ++k) {
+                        const __m256i start = _mm256_min_epi32(off[k], vlastWord);
+                        const __m256i word = _mm256_i32gather_epi32(base, start, 1);
+                        const __m256i shift = _mm256_slli_epi32(_mm256_sub_epi32(off[k], start), 3);
+                        f[k] = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(word, shift), byteMask));
+                    }
+
+                    const __m256 na = _mm256_sub_ps(one, a);
+                    const __m256 nb = _mm256_sub_ps(one, b);
+                    const __m256 top = _mm256_add_ps(_mm256_mul_ps(f[0], na), _mm256_mul_ps(f[1], a));
+                    const __m256 bottom = _mm256_add_ps(_mm256_mul_ps(f[2], na), _mm256_mul_ps(f[3], a));
+
+                    _mm256_storeu_ps(intensities + i, _mm256_add_ps(_mm256_mul_ps(top, nb), _mm256_mul_ps(bottom, b)));
+                }
+
+                readImageGeneric(data, rows, cols, stride, coords + 2 * i, numCoords - i, intensities + i);
+            }
+        }
+    }
+}
+
+#endif
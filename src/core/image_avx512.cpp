@@ -0,0 +1,106 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+/*
+    Compiled with AVX-512 code generation. Avoid including headers with inline functions
+    other than intrinsics, as their out-of-line copies might be picked by the linker
+    for callers compiled for lower instruction set levels.
+*/
+
+#include "image_kernels.h"
+
+#ifdef DEST_WITH_ISA_DISPATCH
+
+#include <immintrin.h>
+#include <stddef.h>
+
+namespace dest {
+    namespace core {
+        namespace kernels {
+
+            void readImageAVX512(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities)
+            {
+                // Gathers are limited to 32 bit offsets.
+                if (static_cast<long long>(rows) * stride >= 0x7FFFFFF0LL) {
+                    readImageSSE2(data, rows, cols, stride, coords, numCoords, intensities);
+                    return;
+                }
+
+                // See readImageAVX2 for gathering bytes as words clamped to the image.
+                const int lastWord = (rows - 1) * stride + cols - 4;
+                if (lastWord < 0) {
+                    readImageGeneric(data, rows, cols, stride, coords, numCoords, intensities);
+                    return;
+                }
+                const int *base = reinterpret_cast<const int*>(data);
+
+                const __m512 one = _mm512_set1_ps(1.f);
+                const __m512 zero = _mm512_setzero_ps();
+                const __m512 minusOne = _mm512_set1_ps(-1.f);
+                const __m512 maxX = _mm512_set1_ps(static_cast<float>(cols - 1));
+                const __m512 maxY = _mm512_set1_ps(static_cast<float>(rows - 1));
+                const __m512 outX = _mm512_set1_ps(static_cast<float>(cols));
+                const __m512 outY = _mm512_set1_ps(static_cast<float>(rows));
+                const __m512i vstride = _mm512_set1_epi32(stride);
+                const __m512i vlastWord = _mm512_set1_epi32(lastWord);
+                const __m512i byteMask = _mm512_set1_epi32(0xFF);
+                const __m512i evenIdx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+                const __m512i oddIdx = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+
+                int i = 0;
+                for (; i + 16 <= numCoords; i += 16) {
+                    const __m512 p0 = _mm512_loadu_ps(coords + 2 * i);
+                    const __m512 p1 = _mm512_loadu_ps(coords + 2 * i + 16);
+
+                    __m512 x = _mm512_permutex2var_ps(p0, evenIdx, p1);
+                    __m512 y = _mm512_permutex2var_ps(p0, oddIdx, p1);
+
+                    x = _mm512_min_ps(outX, _mm512_max_ps(minusOne, x));
+                    y = _mm512_min_ps(outY, _mm512_max_ps(minusOne, y));
+
+                    const __m512 fx = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+                    const __m512 fy = _mm512_roundscale_ps(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+                    const __m512 a = _mm512_sub_ps(x, fx);
+                    const __m512 b = _mm512_sub_ps(y, fy);
+
+                    const __m512i x0 = _mm512_cvttps_epi32(_mm512_min_ps(maxX, _mm512_max_ps(zero, fx)));
+                    const __m512i x1 = _mm512_cvttps_epi32(_mm512_min_ps(maxX, _mm512_max_ps(zero, _mm512_add_ps(fx, one))));
+                    const __m512i y0 = _mm512_mullo_epi32(_mm512_cvttps_epi32(_mm512_min_ps(maxY, _mm512_max_ps(zero, fy))), vstride);
+                    const __m512i y1 = _mm512_mullo_epi32(_mm512_cvttps_epi32(_mm512_min_ps(maxY, _mm512_max_ps(zero, _mm512_add_ps(fy, one)))), vstride);
+
+                    __m512i off[4];
+                    off[0] = _mm512_add_epi32(y0, x0);
+                    off[1] = _mm512_add_epi32(y0, x1);
+                    off[2] = _mm512_add_epi32(y1, x0);
+                    off[3] = _mm512_add_epi32(y1, x1);
+
+                    __m512 f[4];
+                    for (int k = 0; k < 4; ++k) {
+                        const __m512i start = _mm512_min_epi32(off[k], vlastWord);
+                        const __m512i word = _mm512_i32gather_epi32(start, base, 1);
+                        const __m512i shift = _mm512_slli_epi32(_mm512_sub_epi32(off[k], start), 3);
+                        f[k] = _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srlv_epi32(word, shift), byteMask));
+                    }
+
+                    const __m512 na = _mm512_sub_ps(one, a);
+                    const __m512 nb = _mm512_sub_ps(one, b);
+                    const __m512 top = _mm512_add_ps(_mm512_mul_ps(f[0], na), _mm512_mul_ps(f[1], a));
+                    const __m512 bottom = _mm512_add_ps(_mm512_mul_ps(f[2], na), _mm512_mul_ps(f[3], a));
+
+                    _mm512_storeu_ps(intensities + i, _mm512_add_ps(_mm512_mul_ps(top, nb), _mm512_mul_ps(bottom, b)));
+                }
+
+                readImageAVX2(data, rows, cols, stride, coords + 2 * i, numCoords - i, intensities + i);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,57 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_IMAGE_KERNELS_H
+#define DEST_IMAGE_KERNELS_H
+
+#include <dest/core/config.h>
+#include <dest/util/cpu.h>
+
+namespace dest {
+    namespace core {
+        namespace kernels {
+
+            /**
+                Bilinear sampling kernel with clamp to edge.
+
+                \param data Pointer to first pixel of row-major 8 bit image.
+                \param rows Number of rows.
+                \param cols Number of columns.
+                \param stride Distance between rows in bytes.
+                \param coords Interleaved (x,y) sub-pixel coordinates.
+                \param numCoords Number of coordinates.
+                \param intensities Output intensities, one per coordinate.
+            */
+            typedef void (*ReadImageFn)(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities);
+
+            void readImageGeneric(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities);
+
+#ifdef DEST_WITH_ISA_DISPATCH
+            void readImageSSE2(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities);
+            void readImageAVX2(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities);
+            void readImageAVX512(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities);
+#endif
+
+            /**
+                Select sampling kernel for the given instruction set level.
+            */
+            ReadImageFn readImageKernel(util::InstructionSet isa);
+
+            /**
+                Select sampling kernel for the active instruction set level.
+            */
+            inline ReadImageFn readImageKernel() {
+                return readImageKernel(util::activeInstructionSet());
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+/*
+    Compiled with SSE2 code generation. Avoid including headers with inline functions
+    other than intrinsics, as their out-of-line copies might be picked by the linker
+    for callers compiled for lower instruction set levels.
+*/
+
+#include "image_kernels.h"
+
+#ifdef DEST_WITH_ISA_DISPATCH
+
+#include <emmintrin.h>
+#include <stddef.h>
+
+namespace dest {
+    namespace core {
+        namespace kernels {
+
+            void readImageSSE2(const unsigned char *data, int rows, int cols, int stride, const float *coords, int numCoords, float *intensities)
+            {
+                const __m128 one = _mm_set1_ps(1.f);
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 minusOne = _mm_set1_ps(-1.f);
+                const __m128 maxX = _mm_set1_ps(static_cast<float>(cols - 1));
+                const __m128 maxY = _mm_set1_ps(static_cast<float>(rows - 1));
+                const __m128 outX = _mm_set1_ps(static_cast<float>(cols));
+                const __m128 outY = _mm_set1_ps(static_cast<float>(rows));
+
+                int ix0[4], ix1[4], iy0[4], iy1[4];
+                float f0[4], f1[4], f2[4], f3[4];
+
+                int i = 0;
+                for (; i + 4 <= numCoords; i += 4) {
+                    const __m128 p0 = _mm_loadu_ps(coords + 2 * i);
+                    const __m128 p1 = _mm_loadu_ps(coords + 2 * i + 4);
+
+                    __m128 x = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+                    __m128 y = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+
+                    x = _mm_min_ps(outX, _mm_max_ps(minusOne, x));
+                    y = _mm_min_ps(outY, _mm_max_ps(minusOne, y));
+
+                    // Floor via truncation, correcting negative fractions.
+                    __m128 fx = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+                    __m128 fy = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+                    fx = _mm_sub_ps(fx, _mm_and_ps(_mm_cmpgt_ps(fx, x), one));
+                    fy = _mm_sub_ps(fy, _mm_and_ps(_mm_cmpgt_ps(fy, y), one));
+
+                    const __m128 a = _mm_sub_ps(x, fx);
+                    const __m128 b = _mm_sub_ps(y, fy);
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(ix0), _mm_cvttps_epi32(_mm_min_ps(maxX, _mm_max_ps(zero, fx))));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(ix1), _mm_cvttps_epi32(_mm_min_ps(maxX, _mm_max_ps(zero, _mm_add_ps(fx, one)))));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(iy0), _mm_cvttps_epi32(_mm_min_ps(maxY, _mm_max_ps(zero, fy))));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(iy1), _mm_cvttps_epi32(_mm_min_ps(maxY, _mm_max_ps(zero, _mm_add_ps(fy, one)))));
+
+                    for (int k = 0; k < 4; ++k) {
+                        const unsigned char *ptrY0 = data + static_cast<size_t>(iy0[k]) * stride;
+                        const unsigned char *ptrY1 = data + static_cast<size_t>(iy1[k]) * stride;
+                        f0[k] = static_cast<float>(ptrY0[ix0[k]]);
+                        f1[k] = static_cast<float>(ptrY0[ix1[k]]);
+                        f2[k] = static_cast<float>(ptrY1[ix0[k]]);
+                        f3[k] = static_cast<float>(ptrY1[ix1[k]]);
+                    }
+
+                    const __m128 na = _mm_sub_ps(one, a);
+                    const __m128 nb = _mm_sub_ps(one, b);
+                    const __m128 top = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f0), na), _mm_mul_ps(_mm_loadu_ps(f1), a));
+                    const __m128 bottom = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f2), na), _mm_mul_ps(_mm_loadu_ps(f3), a));
+
+                    _mm_storeu_ps(intensities + i, _mm_add_ps(_mm_mul_ps(top, nb), _mm_mul_ps(bottom, b)));
+                }
+
+                readImageGeneric(data, rows, cols, stride, coords + 2 * i, numCoords - i, intensities + i);
+            }
+        }
+    }
+}
+
+#endif
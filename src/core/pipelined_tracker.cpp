@@ -0,0 +1,201 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/pipelined_tracker.h>
+#include <dest/util/spsc_queue.h>
+#include <dest/util/log.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dest {
+    namespace core {
+
+        PipelineParameters::PipelineParameters()
+        {
+            numStages = 2;
+            queueCapacity = 64;
+            firstCore = 0;
+        }
+
+        struct PipelineJob {
+            MappedImage img;
+            ShapeTransform shapeToImage;
+            Shape estimate;
+            ImagePyramid pyr;
+            std::promise<Shape> result;
+
+            PipelineJob(const Eigen::Ref<const Image> &i, const ShapeTransform &t, const Shape &meanShape)
+            : img(i.data(), i.rows(), i.cols(), Eigen::OuterStride<Eigen::Dynamic>(i.outerStride())),
+              shapeToImage(t),
+              estimate(meanShape)
+            {}
+        };
+
+        typedef util::SPSCQueue<PipelineJob*> JobQueue;
+
+        /** Back off from busy polling when a queue stayed empty or full for a while. */
+        inline void backoff(int &spins) {
+            if (++spins < 1000) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        inline void pinToCore(std::thread &t, int core) {
+#if defined(__linux__)
+            const int numCores = static_cast<int>(std::thread::hardware_concurrency());
+            if (numCores <= 0)
+                return;
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core % numCores, &set);
+            if (pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &set) != 0) {
+                DEST_LOG("Failed to pin pipeline stage to core " << core % numCores << std::endl);
+            }
+#else
+            (void)t;
+            (void)core;
+#endif
+        }
+
+        struct PipelinedTracker::data {
+            const Tracker *tracker;
+            PipelineParameters params;
+            PipelineStageFunction stageFunction;
+
+            std::vector< std::pair<int, int> > ranges;
+            // queues[i] feeds stage i.
+            std::vector< std::unique_ptr<JobQueue> > queues;
+            // done[i] is set once stage i will no longer push to queues[i+1]. done[0] refers to the producer.
+            std::unique_ptr< std::atomic<bool>[] > done;
+            std::vector<std::thread> threads;
+
+            void runStage(int stage) {
+                JobQueue &in = *queues[stage];
+                JobQueue *out = (stage + 1 < static_cast<int>(queues.size())) ? queues[stage + 1].get() : 0;
+                const int first = ranges[stage].first;
+                const int last = ranges[stage].second;
+
+                int spins = 0;
+                while (true) {
+                    PipelineJob *job = 0;
+                    if (!in.pop(job)) {
+                        // Upstream flag must be read before the emptiness check to not miss final jobs.
+                        if (done[stage].load(std::memory_order_acquire) && in.empty())
+                            break;
+                        backoff(spins);
+                        continue;
+                    }
+                    spins = 0;
+
+                    try {
+                        // The pyramid travels with the job, so pixels computed by one stage are reused by the next.
+                        if (stage == 0)
+                            tracker->createPyramid(job->img, job->shapeToImage, job->pyr);
+                        if (stageFunction)
+                            stageFunction(job->img, job->pyr, job->shapeToImage, first, last, job->estimate);
+                        else
+                            tracker->predictCascades(job->img, job->pyr, job->shapeToImage, first, last, job->estimate);
+                    } catch (...) {
+                        // Hand the failure to the caller of this face and keep draining instead of terminating.
+                        job->result.set_exception(std::current_exception());
+                        delete job;
+                        continue;
+                    }
+
+                    if (out) {
+                        int pushSpins = 0;
+                        while (!out->push(job))
+                            backoff(pushSpins);
+                    } else {
+                        job->result.set_value(job->shapeToImage * job->estimate.colwise().homogeneous());
+                        delete job;
+                    }
+                }
+
+                if (stage + 1 < static_cast<int>(queues.size()))
+                    done[stage + 1].store(true, std::memory_order_release);
+            }
+        };
+
+        PipelinedTracker::PipelinedTracker(const Tracker &t, const PipelineParameters &params, const PipelineStageFunction &stage)
+        : _data(new data())
+        {
+            data &d = *_data;
+            d.tracker = &t;
+            d.params = params;
+            d.stageFunction = stage;
+
+            const int numCascades = t.numCascades();
+            const int numStages = std::max<int>(1, std::min<int>(params.numStages, numCascades));
+
+            for (int i = 0; i < numStages; ++i) {
+                d.ranges.push_back(std::make_pair(
+                    (i * numCascades) / numStages,
+                    ((i + 1) * numCascades) / numStages));
+                d.queues.push_back(std::unique_ptr<JobQueue>(new JobQueue(std::max<int>(1, params.queueCapacity))));
+            }
+
+            d.done.reset(new std::atomic<bool>[numStages]);
+            for (int i = 0; i < numStages; ++i) {
+                d.done[i].store(false);
+            }
+
+            for (int i = 0; i < numStages; ++i) {
+                d.threads.push_back(std::thread(&data::runStage, &d, i));
+                if (params.firstCore >= 0)
+                    pinToCore(d.threads.back(), params.firstCore + i);
+            }
+        }
+
+        PipelinedTracker::~PipelinedTracker()
+        {
+            // Signal end of input, stages drain their queues and shut down front to back.
+            _data->done[0].store(true, std::memory_order_release);
+            for (size_t i = 0; i < _data->threads.size(); ++i) {
+                _data->threads[i].join();
+            }
+        }
+
+        std::future<Shape> PipelinedTracker::submit(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage)
+        {
+            data &d = *_data;
+
+            PipelineJob *job = new PipelineJob(img, shapeToImage, d.tracker->meanShape());
+            std::future<Shape> f = job->result.get_future();
+
+            int spins = 0;
+            while (!d.queues.front()->push(job))
+                backoff(spins);
+
+            return f;
+        }
+
+        int PipelinedTracker::numStages() const
+        {
+            return static_cast<int>(_data->ranges.size());
+        }
+
+        std::pair<int, int> PipelinedTracker::stageCascades(int stage) const
+        {
+            return _data->ranges[stage];
+        }
+
+    }
+}
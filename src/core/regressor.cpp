@@ -10,26 +10,80 @@
 
 #include <dest/core/regressor.h>
 #include <dest/core/tree.h>
+#include <dest/core/config.h>
 #include <dest/util/log.h>
 #include <dest/io/dest_io_generated.h>
 #include <dest/io/matrix_io.h>
+#include <Eigen/Eigenvalues>
+#include <Eigen/QR>
+#include <algorithm>
+#include <cmath>
 
 namespace dest {
     namespace core {
         
+        RegressorTrackState::RegressorTrackState()
+        : numPatches(0), treesEvaluated(0), treesReused(0)
+        {}
+
+        const float Regressor::DefaultLazySamplingCost = 6.f;
+
+        /** Memo storage of lazy sampling, kept per thread to avoid allocations in each prediction. */
+        inline LazyPixelIntensities::Buffer &lazyPixelBuffer() {
+            static thread_local LazyPixelIntensities::Buffer buffer;
+            return buffer;
+        }
+
         struct Regressor::data {
             
             PixelCoordinates shapeRelativePixelCoordinates;
             Eigen::VectorXi closestShapeLandmark;
+            Eigen::Vector2f maxPixelOffset;
             
             ShapeResidual meanResidual;
             Shape meanShape;
             std::vector<Tree> trees;
             float learningRate;
+            float samplingSpacing;
+
+            SamplingStrategy samplingStrategy;
+            float lazySamplingCost;
+            bool lazySampling;
             
             data()
+            : maxPixelOffset(Eigen::Vector2f::Zero()), learningRate(0.f), samplingSpacing(0.f), samplingStrategy(SAMPLING_AUTO), lazySamplingCost(Regressor::DefaultLazySamplingCost), lazySampling(false)
             {}
 
+            float expectedPixelReads() const {
+                const int numPixels = static_cast<int>(shapeRelativePixelCoordinates.cols());
+
+                Eigen::VectorXf rates = Eigen::VectorXf::Zero(numPixels);
+                for (size_t i = 0; i < trees.size(); ++i) {
+                    trees[i].accumulatePixelAccessRates(rates);
+                }
+
+                // Probability of a pixel being referenced at least once, assuming independent accesses.
+                float reads = 0.f;
+                for (int i = 0; i < numPixels; ++i) {
+                    reads += 1.f - std::exp(-rates(i));
+                }
+                return reads;
+            }
+
+            void updateSamplingMode() {
+                switch (samplingStrategy) {
+                case SAMPLING_EAGER:
+                    lazySampling = false;
+                    break;
+                case SAMPLING_LAZY:
+                    lazySampling = true;
+                    break;
+                default:
+                    lazySampling = expectedPixelReads() * lazySamplingCost < static_cast<float>(shapeRelativePixelCoordinates.cols());
+                    break;
+                }
+            }
+
             flatbuffers::Offset<io::Regressor> save(flatbuffers::FlatBufferBuilder &fbb) const {
                 flatbuffers::Offset<io::MatrixF> lpixels = io::toFbs(fbb, shapeRelativePixelCoordinates);
                 flatbuffers::Offset<io::MatrixI> lcosest = io::toFbs(fbb, closestShapeLandmark);
@@ -50,6 +104,7 @@ namespace dest {
                 b.add_meanShape(lmeans);
                 b.add_forest(vtrees);
                 b.add_learningRate(learningRate);
+                b.add_samplingSpacing(samplingSpacing);
 
                 return b.Finish();
             }
@@ -58,14 +113,18 @@ namespace dest {
 
                 io::fromFbs(*fbs.closestLandmarks(), closestShapeLandmark);
                 io::fromFbs(*fbs.pixelCoordinates(), shapeRelativePixelCoordinates);
+                maxPixelOffset = shapeRelativePixelCoordinates.cwiseAbs().rowwise().maxCoeff();
                 io::fromFbs(*fbs.meanShapeResidual(), meanResidual);
                 io::fromFbs(*fbs.meanShape(), meanShape);
                 learningRate = fbs.learningRate();
+                samplingSpacing = fbs.samplingSpacing();
 
                 trees.resize(fbs.forest()->size());
                 for (flatbuffers::uoffset_t i = 0; i < fbs.forest()->size(); ++i) {
                     trees[i].load(*fbs.forest()->Get(i));
                 }
+
+                updateSamplingMode();
             }
 
 
@@ -103,6 +162,10 @@ namespace dest {
             SampleData &tdata = *t.training;
 
             data.learningRate = t.training->params.learningRate;
+            data.samplingSpacing = 0.f;
+            if (t.training->params.pyramidSamplesPerLambda > 0.f) {
+                data.samplingSpacing = t.training->params.exponentialLambda / t.training->params.pyramidSamplesPerLambda;
+            }
             data.trees.resize(t.training->params.numTrees);
             data.meanShape = t.meanShape;
             
@@ -117,6 +180,7 @@ namespace dest {
             
             // Encode them with respect to the mean shape
             shapeRelativePixelCoordinates(t.meanShape, tt.pixelCoordinates, data.shapeRelativePixelCoordinates, data.closestShapeLandmark);
+            data.maxPixelOffset = data.shapeRelativePixelCoordinates.cwiseAbs().rowwise().maxCoeff();
             
             // Compute the mean residual, to be used as base learner
             data.meanResidual = ShapeResidual::Zero(2, t.numLandmarks);
@@ -125,17 +189,58 @@ namespace dest {
                 tt.samples[i].residual = tdata.samples[i].target - tdata.samples[i].estimate;
                 data.meanResidual += tt.samples[i].residual;
                 
-                Eigen::AffineCompact2f tShapeToShape = estimateSimilarityTransform(t.meanShape, tdata.samples[i].estimate);
-                Eigen::AffineCompact2f tShapeToImage = tdata.samples[i].shapeToImage;
-
-                readPixelIntensities(tShapeToShape,
-                                     tShapeToImage,
-                                     tdata.samples[i].estimate,
-                                     t.input->images[tdata.samples[i].inputIdx],
-                                     tt.samples[i].intensities);
+                readSampleIntensities(t, tdata.samples[i], tt.samples[i].intensities);
                 
             }
             data.meanResidual /= static_cast<float>(tdata.samples.size());
+
+            if (t.training->params.splitSelection == SPLIT_CORRELATION) {
+                // Intensities are fixed per stage, so their covariance is shared by all trees. Estimated
+                // from an evenly spaced subset of samples, which bounds the cost per stage.
+                const size_t maxCovarianceSamples = 256;
+                const size_t numSamples = tt.samples.size();
+                const size_t numCovSamples = std::min<size_t>(numSamples, maxCovarianceSamples);
+
+                Eigen::MatrixXf intensities(numCovSamples, tt.pixelCoordinates.cols());
+                for (size_t i = 0; i < numCovSamples; ++i) {
+                    intensities.row(i) = tt.samples[(i * numSamples) / numCovSamples].intensities;
+                }
+                intensities.rowwise() -= intensities.colwise().mean();
+                tt.pixelCovariance = (intensities.transpose() * intensities) / static_cast<float>(numCovSamples);
+
+                // Covariances between pixels and residuals of a node are computed through the leading
+                // principal components of the intensities. Per node this costs samples times components
+                // times tests plus pixels times components times tests, so fewer components train faster
+                // at slightly higher error.
+                const int maxPixelComponents = 16;
+                const int numComponents = std::min<int>(maxPixelComponents, static_cast<int>(tt.pixelCoordinates.cols()));
+
+                // Leading eigenvectors by subspace iteration from a random start, a full decomposition
+                // of the covariance would dominate the cost of the stage.
+                const int numPixels = static_cast<int>(tt.pixelCoordinates.cols());
+                const int numOversampled = std::min<int>(numComponents + 8, numPixels);
+                const int numPowerIterations = 2;
+
+                std::normal_distribution<float> dn(0.f, 1.f);
+                Eigen::MatrixXf q(numPixels, numOversampled);
+                for (int c = 0; c < numOversampled; ++c) {
+                    for (int r = 0; r < numPixels; ++r) {
+                        q(r, c) = dn(t.input->rnd);
+                    }
+                }
+
+                const Eigen::MatrixXf thin = Eigen::MatrixXf::Identity(numPixels, numOversampled);
+                for (int i = 0; i <= numPowerIterations; ++i) {
+                    q = Eigen::HouseholderQR<Eigen::MatrixXf>(tt.pixelCovariance * q).householderQ() * thin;
+                }
+
+                const Eigen::MatrixXf projected = q.transpose() * tt.pixelCovariance * q;
+                Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> eig(projected);
+                tt.pixelBasis = q * eig.eigenvectors().rightCols(numComponents);
+                for (size_t i = 0; i < numSamples; ++i) {
+                    tt.samples[i].components = tt.samples[i].intensities * tt.pixelBasis;
+                }
+            }
             
             for (int k = 0; k < t.training->params.numTrees; ++k) {
                 DEST_LOG("Building tree " << std::setw(5) << k + 1 << "\r" << std::flush);
@@ -149,12 +254,59 @@ namespace dest {
                 }
                 data.trees[k].fit(tt);
             }
-            
-            
+
+            data.updateSamplingMode();
             
             return false;
         }
         
+        bool Regressor::refit(RegressorTraining &t)
+        {
+            Regressor::data &data = *_data;
+            SampleData &tdata = *t.training;
+
+            if (tdata.samples.empty())
+                return false;
+
+            TreeTraining tt;
+            tt.numLandmarks = t.numLandmarks;
+            tt.training = t.training;
+            tt.input = t.input;
+            tt.samples.resize(tdata.samples.size());
+
+            const int numSamples = static_cast<int>(tdata.samples.size());
+
+            // Sample intensities once per stage at the fixed pixel coordinates.
+#ifdef DEST_WITH_OPENMP
+            #pragma omp parallel for schedule(static)
+#endif
+            for (int i = 0; i < numSamples; ++i) {
+                tt.samples[i].residual = tdata.samples[i].target - tdata.samples[i].estimate;
+
+                readSampleIntensities(t, tdata.samples[i], tt.samples[i].intensities);
+            }
+
+            data.meanResidual = ShapeResidual::Zero(2, t.numLandmarks);
+            for (int i = 0; i < numSamples; ++i) {
+                data.meanResidual += tt.samples[i].residual;
+            }
+            data.meanResidual /= static_cast<float>(numSamples);
+
+            const int numTrees = static_cast<int>(data.trees.size());
+            for (int k = 0; k < numTrees; ++k) {
+                for (int i = 0; i < numSamples; ++i) {
+                    if (k == 0) {
+                        tt.samples[i].residual -= data.meanResidual;
+                    } else {
+                        tt.samples[i].residual -= data.learningRate * data.trees[k - 1].predict(tt.samples[i].intensities);
+                    }
+                }
+                data.trees[k].refitLeaves(tt);
+            }
+
+            return true;
+        }
+
         PixelCoordinates Regressor::sampleCoordinates(RegressorTraining &t) const {
             
             Eigen::Vector2f minC = t.meanShape.rowwise().minCoeff() - Eigen::Vector2f::Constant(t.training->params.expansionRandomPixelCoordinates);
@@ -175,38 +327,249 @@ namespace dest {
         }
         
         
-        void Regressor::readPixelIntensities(const Eigen::AffineCompact2f &shapeToShape, const Eigen::AffineCompact2f &shapeToImage, const Shape &s, const Image &img, PixelIntensities &intensities) const
+        void Regressor::readSampleIntensities(const RegressorTraining &t, const SampleData::Sample &s, PixelIntensities &intensities) const
         {
             Regressor::data &data = *_data;
-            
-            PixelCoordinates coords = shapeToShape.matrix().block<2,2>(0,0) * data.shapeRelativePixelCoordinates;
-            
-            const Shape::Index numCoords = data.shapeRelativePixelCoordinates.cols();
-            for(Shape::Index i = 0; i < numCoords; ++i) {
-                coords.col(i) += s.col(data.closestShapeLandmark(i));
+
+            Eigen::AffineCompact2f shapeToShape = estimateSimilarityTransform(data.meanShape, s.estimate);
+            const Image &img = t.input->images[s.inputIdx];
+
+            int level = 0;
+            if (t.pyramids) {
+                level = std::min<int>(samplingLevel(s.shapeToImage), (*t.pyramids)[s.inputIdx].numLevels());
             }
-            
-            coords = shapeToImage.matrix() * coords.colwise().homogeneous();
 
-            readImage(img, coords, intensities);
+            if (level > 0) {
+                const ImagePyramid &pyr = (*t.pyramids)[s.inputIdx];
+                readPixelIntensities(shapeToShape, pyr.imageToLevel(level) * s.shapeToImage, s.estimate, pyr.level(level), intensities);
+            } else {
+                readPixelIntensities(shapeToShape, s.shapeToImage, s.estimate, img, intensities);
+            }
+        }
+
+        void Regressor::readPixelIntensities(const Eigen::AffineCompact2f &shapeToShape, const Eigen::AffineCompact2f &shapeToImage, const Shape &s, const Eigen::Ref<const Image> &img, PixelIntensities &intensities) const
+        {
+            Regressor::data &data = *_data;
+
+            // Pixels are offsets relative to their closest landmark, so in image space they are offsets
+            // transformed by the combined linear part relative to the landmarks in image space.
+            const Eigen::Matrix2f A = shapeToImage.linear() * shapeToShape.linear();
+            const PixelCoordinates anchors = shapeToImage * s.colwise().homogeneous();
+
+            readImage(img, A, data.shapeRelativePixelCoordinates, data.closestShapeLandmark, anchors, intensities);
         }
         
         ShapeResidual Regressor::predict(const Eigen::Ref<const Image> &img, const Shape &shape, const ShapeTransform &shapeToImage) const
+        {
+            Eigen::AffineCompact2f shapeToShape = estimateSimilarityTransform(_data->meanShape, shape);
+            const Eigen::Matrix2f A = shapeToImage.linear() * shapeToShape.linear();
+            const PixelCoordinates anchors = shapeToImage * shape.colwise().homogeneous();
+
+            return predictAt(img, A, anchors);
+        }
+
+        ShapeResidual Regressor::predictAt(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &anchors) const
         {
             Regressor::data &data = *_data;
             
-            PixelIntensities intensities;
-            Eigen::AffineCompact2f shapeToShape = estimateSimilarityTransform(data.meanShape, shape);
-            readPixelIntensities(shapeToShape, shapeToImage, shape, img, intensities);
-            
             const size_t numTrees = data.trees.size();
             
             ShapeResidual sr = data.meanResidual;
-            for(size_t i = 0; i < numTrees; ++i) {
-                sr += data.trees[i].predict(intensities) * data.learningRate;
+
+            if (data.lazySampling) {
+                LazyPixelIntensities intensities(img, A, data.shapeRelativePixelCoordinates, data.closestShapeLandmark, anchors, lazyPixelBuffer());
+                for (size_t i = 0; i < numTrees; ++i) {
+                    sr += data.trees[i].predict(intensities) * data.learningRate;
+                }
+            } else {
+                PixelIntensities intensities;
+                readImage(img, A, data.shapeRelativePixelCoordinates, data.closestShapeLandmark, anchors, intensities);
+
+                for (size_t i = 0; i < numTrees; ++i) {
+                    sr += data.trees[i].predict(intensities) * data.learningRate;
+                }
             }
             
             return sr;
         }
+
+        /** Update the leaves of all trees and patch the sum of leaf residuals where leaves changed. */
+        template<class Intensities>
+        inline void updateLeaves(const std::vector<Tree> &trees, Intensities &intensities, int stride, RegressorTrackState &state)
+        {
+            const int numTrees = static_cast<int>(trees.size());
+
+            state.treesEvaluated = 0;
+            for (int i = 0; i < numTrees; ++i) {
+                const int prev = state.leaves(i);
+                if (!trees[i].findLeaf(intensities, state.leaves(i), state.margins(i), state.pathIntensities.data() + i * stride))
+                    continue;
+
+                ++state.treesEvaluated;
+
+                const int leaf = state.leaves(i);
+                if (leaf != prev) {
+                    if (prev >= 0) {
+                        state.leafSum -= trees[i].leafResidual(prev);
+                        ++state.numPatches;
+                    }
+                    state.leafSum += trees[i].leafResidual(leaf);
+                }
+            }
+            state.treesReused = numTrees - state.treesEvaluated;
+        }
+
+        ShapeResidual Regressor::predict(const Eigen::Ref<const Image> &img, const Shape &shape, const ShapeTransform &shapeToImage, RegressorTrackState &state) const
+        {
+            Eigen::AffineCompact2f shapeToShape = estimateSimilarityTransform(_data->meanShape, shape);
+            const Eigen::Matrix2f A = shapeToImage.linear() * shapeToShape.linear();
+            const PixelCoordinates anchors = shapeToImage * shape.colwise().homogeneous();
+
+            return predictAt(img, A, anchors, state);
+        }
+
+        ShapeResidual Regressor::predictAt(const Eigen::Ref<const Image> &img, const Eigen::Matrix2f &A, const PixelCoordinates &anchors, RegressorTrackState &state) const
+        {
+            Regressor::data &data = *_data;
+
+            const int numTrees = static_cast<int>(data.trees.size());
+
+            int maxDepth = 1;
+            for (int i = 0; i < numTrees; ++i) {
+                maxDepth = std::max<int>(maxDepth, data.trees[i].depth());
+            }
+            const int stride = 2 * (maxDepth - 1);
+
+            if (state.leaves.size() != numTrees || state.pathIntensities.size() != numTrees * stride) {
+                state.leaves.setConstant(numTrees, -1);
+                state.margins.setZero(numTrees);
+                state.pathIntensities.setZero(numTrees * stride);
+                state.leafSum = ShapeResidual::Zero(2, anchors.cols());
+                state.numPatches = 0;
+            }
+
+            if (data.lazySampling) {
+                LazyPixelIntensities intensities(img, A, data.shapeRelativePixelCoordinates, data.closestShapeLandmark, anchors, lazyPixelBuffer());
+                updateLeaves(data.trees, intensities, stride, state);
+            } else {
+                PixelIntensities intensities;
+                readImage(img, A, data.shapeRelativePixelCoordinates, data.closestShapeLandmark, anchors, intensities);
+                updateLeaves(data.trees, intensities, stride, state);
+            }
+
+            // Bound accumulation of rounding errors from patching.
+            if (state.numPatches > numTrees) {
+                state.leafSum.setZero();
+                for (int i = 0; i < numTrees; ++i) {
+                    state.leafSum += data.trees[i].leafResidual(state.leaves(i));
+                }
+                state.numPatches = 0;
+            }
+
+            return data.meanResidual + state.leafSum * data.learningRate;
+        }
+
+        /**
+            Compute the level pixels read for the given face and return the level to sample from. Sampling
+            locations are returned in coordinates of that level.
+        */
+        int Regressor::prepareLevel(ImagePyramid &pyr, const Shape &shape, const ShapeTransform &shapeToImage, Eigen::Matrix2f &A, PixelCoordinates &anchors) const
+        {
+            Regressor::data &data = *_data;
+
+            const int level = std::min<int>(samplingLevel(shapeToImage), pyr.numLevels());
+            const ShapeTransform shapeToLevel = (level > 0) ? ShapeTransform(pyr.imageToLevel(level) * shapeToImage) : shapeToImage;
+            const Eigen::AffineCompact2f shapeToShape = estimateSimilarityTransform(data.meanShape, shape);
+            A = shapeToLevel.linear() * shapeToShape.linear();
+            anchors = shapeToLevel * shape.colwise().homogeneous();
+
+            if (level > 0) {
+                // Pixel locations lie within the largest offset from any landmark.
+                const Eigen::Vector2f radius = A.cwiseAbs() * data.maxPixelOffset;
+                const Eigen::AlignedBox2f bounds(anchors.rowwise().minCoeff() - radius, anchors.rowwise().maxCoeff() + radius);
+
+                pyr.level(level, bounds);
+            }
+            return level;
+        }
+
+        ShapeResidual Regressor::predict(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const Shape &shape, const ShapeTransform &shapeToImage) const
+        {
+            Eigen::Matrix2f A;
+            PixelCoordinates anchors;
+            const int level = prepareLevel(pyr, shape, shapeToImage, A, anchors);
+            if (level > 0) {
+                return predictAt(pyr.level(level), A, anchors);
+            }
+            return predictAt(img, A, anchors);
+        }
+
+        ShapeResidual Regressor::predict(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const Shape &shape, const ShapeTransform &shapeToImage, RegressorTrackState &state) const
+        {
+            Eigen::Matrix2f A;
+            PixelCoordinates anchors;
+            const int level = prepareLevel(pyr, shape, shapeToImage, A, anchors);
+            if (level > 0) {
+                return predictAt(pyr.level(level), A, anchors, state);
+            }
+            return predictAt(img, A, anchors, state);
+        }
+
+        void Regressor::setSamplingStrategy(SamplingStrategy s)
+        {
+            _data->samplingStrategy = s;
+            _data->updateSamplingMode();
+        }
+
+        int Regressor::samplingLevel(const ShapeTransform &shapeToImage) const
+        {
+            return samplingLevel(_data->samplingSpacing, shapeToImage);
+        }
+
+        void Regressor::setLazySamplingCost(float cost)
+        {
+            _data->lazySamplingCost = std::max<float>(0.f, cost);
+            _data->updateSamplingMode();
+        }
+
+        float Regressor::lazySamplingCost() const
+        {
+            return _data->lazySamplingCost;
+        }
+
+        float Regressor::samplingSpacing() const
+        {
+            return _data->samplingSpacing;
+        }
+
+        int Regressor::samplingLevel(float spacing, const ShapeTransform &shapeToImage)
+        {
+            if (spacing <= 0.f)
+                return 0;
+
+            // Image pixels per normalized shape space unit.
+            const float scale = std::sqrt(std::abs(shapeToImage.linear().determinant()));
+            const float pixels = spacing * scale;
+            if (pixels < 2.f)
+                return 0;
+
+            const int level = static_cast<int>(std::floor(std::log2(pixels)));
+            return std::max<int>(0, std::min<int>(static_cast<int>(MaxSamplingLevel), level));
+        }
+
+        bool Regressor::lazySampling() const
+        {
+            return _data->lazySampling;
+        }
+
+        float Regressor::expectedPixelReads() const
+        {
+            return _data->expectedPixelReads();
+        }
+
+        int Regressor::numPixels() const
+        {
+            return static_cast<int>(_data->shapeRelativePixelCoordinates.cols());
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,220 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/request_coalescer.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <iomanip>
+
+namespace dest {
+    namespace core {
+
+        CoalescerParameters::CoalescerParameters()
+        {
+            maxBatchSize = 32;
+            batchWindowMs = 2.f;
+            latencyTargetMs = 10.f;
+            numWorkers = 1;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const CoalescerParameters &obj) {
+            stream << std::setw(30) << std::left << "Maximum batch size" << std::setw(10) << obj.maxBatchSize << std::endl
+                   << std::setw(30) << std::left << "Batch window (ms)" << std::setw(10) << obj.batchWindowMs << std::endl
+                   << std::setw(30) << std::left << "Latency target (ms)" << std::setw(10) << obj.latencyTargetMs << std::endl
+                   << std::setw(30) << std::left << "Number of workers" << std::setw(10) << obj.numWorkers;
+            return stream;
+        }
+
+        typedef std::chrono::steady_clock Clock;
+
+        struct Request {
+            MappedImage img;
+            ShapeTransform shapeToImage;
+            std::promise<Shape> result;
+            Clock::time_point arrival;
+
+            Request(const Eigen::Ref<const Image> &i, const ShapeTransform &t)
+            : img(i.data(), i.rows(), i.cols(), Eigen::OuterStride<Eigen::Dynamic>(i.outerStride())),
+              shapeToImage(t),
+              arrival(Clock::now())
+            {}
+        };
+
+        struct RequestCoalescer::data {
+            const Tracker *tracker;
+            CoalescerParameters params;
+            BatchPredictFunction predictFunction;
+
+            mutable std::mutex mutex;
+            std::condition_variable cond;
+            std::deque< std::unique_ptr<Request> > queue;
+            std::vector<std::thread> workers;
+            bool stop;
+
+            CoalescerStats stats;
+
+            void updateBatchLimit(int batchSize, float batchMs) {
+                // Exponentially smoothed evaluation cost per request.
+                const float msPerRequest = batchMs / static_cast<float>(batchSize);
+                if (stats.numBatches == 0) {
+                    stats.msPerRequest = msPerRequest;
+                } else {
+                    stats.msPerRequest = 0.8f * stats.msPerRequest + 0.2f * msPerRequest;
+                }
+
+                if (params.latencyTargetMs <= 0.f || stats.msPerRequest <= 0.f) {
+                    stats.batchSizeLimit = params.maxBatchSize;
+                    return;
+                }
+
+                const float budgetMs = std::max<float>(0.f, params.latencyTargetMs - params.batchWindowMs);
+                const int limit = static_cast<int>(budgetMs / stats.msPerRequest);
+                stats.batchSizeLimit = std::max<int>(1, std::min<int>(params.maxBatchSize, limit));
+            }
+
+            void run() {
+                std::vector< std::unique_ptr<Request> > batch;
+                std::vector<MappedImage> imgs;
+                std::vector<ShapeTransform> transforms;
+                std::vector<Shape> shapes;
+
+                while (true) {
+                    batch.clear();
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cond.wait(lock, [this]() { return stop || !queue.empty(); });
+
+                        if (queue.empty())
+                            return; // Stopped and drained.
+
+                        // Wait for the batch to fill up until the window of the oldest request expires.
+                        const Clock::time_point deadline = queue.front()->arrival +
+                            std::chrono::microseconds(static_cast<long long>(params.batchWindowMs * 1000.f));
+                        cond.wait_until(lock, deadline, [this]() {
+                            return stop || static_cast<int>(queue.size()) >= stats.batchSizeLimit;
+                        });
+
+                        const int n = std::min<int>(stats.batchSizeLimit, static_cast<int>(queue.size()));
+                        for (int i = 0; i < n; ++i) {
+                            batch.push_back(std::move(queue.front()));
+                            queue.pop_front();
+                        }
+                    }
+
+                    // Let another worker start gathering the remaining requests.
+                    cond.notify_one();
+
+                    if (batch.empty())
+                        continue;
+
+                    imgs.clear();
+                    transforms.clear();
+                    for (size_t i = 0; i < batch.size(); ++i) {
+                        imgs.push_back(batch[i]->img);
+                        transforms.push_back(batch[i]->shapeToImage);
+                    }
+
+                    Clock::time_point start = Clock::now();
+                    try {
+                        if (predictFunction)
+                            predictFunction(imgs, transforms, shapes);
+                        else
+                            tracker->predict(imgs, transforms, shapes);
+                    } catch (...) {
+                        // Hand the failure to every caller of this batch instead of terminating the worker.
+                        const std::exception_ptr e = std::current_exception();
+                        for (size_t i = 0; i < batch.size(); ++i) {
+                            batch[i]->result.set_exception(e);
+                        }
+                        continue;
+                    }
+                    const float batchMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        updateBatchLimit(static_cast<int>(batch.size()), batchMs);
+                        stats.numRequests += batch.size();
+                        stats.numBatches += 1;
+                    }
+
+                    for (size_t i = 0; i < batch.size(); ++i) {
+                        batch[i]->result.set_value(shapes[i]);
+                    }
+                }
+            }
+        };
+
+        RequestCoalescer::RequestCoalescer(const Tracker &t, const CoalescerParameters &params, const BatchPredictFunction &predict)
+        : _data(new data())
+        {
+            _data->tracker = &t;
+            _data->params = params;
+            _data->predictFunction = predict;
+            _data->params.maxBatchSize = std::max<int>(1, params.maxBatchSize);
+            _data->params.batchWindowMs = std::max<float>(0.f, params.batchWindowMs);
+            _data->stop = false;
+
+            _data->stats.numRequests = 0;
+            _data->stats.numBatches = 0;
+            _data->stats.batchSizeLimit = _data->params.maxBatchSize;
+            _data->stats.msPerRequest = 0.f;
+
+            const int numWorkers = std::max<int>(1, params.numWorkers);
+            for (int i = 0; i < numWorkers; ++i) {
+                _data->workers.push_back(std::thread(&data::run, _data.get()));
+            }
+        }
+
+        RequestCoalescer::~RequestCoalescer()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_data->mutex);
+                _data->stop = true;
+            }
+            _data->cond.notify_all();
+
+            for (size_t i = 0; i < _data->workers.size(); ++i) {
+                _data->workers[i].join();
+            }
+        }
+
+        std::future<Shape> RequestCoalescer::submit(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage)
+        {
+            std::unique_ptr<Request> r(new Request(img, shapeToImage));
+            std::future<Shape> f = r->result.get_future();
+
+            bool wake;
+            {
+                std::lock_guard<std::mutex> lock(_data->mutex);
+                _data->queue.push_back(std::move(r));
+
+                // Wake a worker waiting for its first request or for a full batch.
+                const int queued = static_cast<int>(_data->queue.size());
+                wake = (queued == 1) || (queued >= _data->stats.batchSizeLimit);
+            }
+
+            if (wake)
+                _data->cond.notify_one();
+
+            return f;
+        }
+
+        CoalescerStats RequestCoalescer::stats() const
+        {
+            std::lock_guard<std::mutex> lock(_data->mutex);
+            return _data->stats;
+        }
+    }
+}
@@ -0,0 +1,371 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/result_cache.h>
+#include <dest/util/hash.h>
+#include <dest/util/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dest {
+    namespace core {
+
+        ResultCacheParameters::ResultCacheParameters()
+        {
+            maxEntries = 10000;
+            hashFaceRegion = false;
+        }
+
+        ResultCacheStats::ResultCacheStats()
+        : numHits(0), numDiskHits(0), numMisses(0), numEvictions(0), numEntries(0), numDiskEntries(0)
+        {}
+
+        /** Hash rows of a region one after another, so that the result does not depend on stride. */
+        inline uint64_t hashRegion(const Eigen::Ref<const Image> &img, int x, int y, int width, int height)
+        {
+            uint64_t h = util::hashCombine(static_cast<uint64_t>(width), static_cast<uint64_t>(height));
+            for (int r = y; r < y + height; ++r) {
+                h = util::hashBytes(img.data() + static_cast<size_t>(r) * img.outerStride() + x, static_cast<size_t>(width), h);
+            }
+            return h;
+        }
+
+        /**
+            Hash of transform quantized to 1/256 pixel, so that transforms differing only by floating
+            point rounding map to the same key.
+        */
+        inline uint64_t hashTransform(const ShapeTransform &t)
+        {
+            int64_t values[6];
+            for (int c = 0; c < 3; ++c) {
+                values[2 * c + 0] = static_cast<int64_t>(std::floor(t.matrix()(0, c) * 256.f + 0.5f));
+                values[2 * c + 1] = static_cast<int64_t>(std::floor(t.matrix()(1, c) * 256.f + 0.5f));
+            }
+            return util::hashBytes(values, sizeof(values));
+        }
+
+        uint64_t hashImage(const Eigen::Ref<const Image> &img)
+        {
+            return hashRegion(img, 0, 0, static_cast<int>(img.cols()), static_cast<int>(img.rows()));
+        }
+
+        uint64_t trackerFingerprint(const Tracker &t)
+        {
+            flatbuffers::FlatBufferBuilder fbb;
+            io::FinishTrackerBuffer(fbb, t.save(fbb));
+            return util::hashBytes(fbb.GetBufferPointer(), fbb.GetSize());
+        }
+
+        struct ResultCacheKeyHash {
+            size_t operator()(const ResultCacheKey &k) const {
+                return static_cast<size_t>(util::hashCombine(util::hashCombine(k.image, k.transform), k.model));
+            }
+        };
+
+        /** Magic number at the start of cache files. */
+        static const char DiskMagic[8] = { 'D', 'E', 'S', 'T', 'R', 'C', '0', '1' };
+
+        struct ResultCache::data {
+            typedef std::pair<ResultCacheKey, Shape> Entry;
+            typedef std::list<Entry> EntryList;
+            typedef std::unordered_map<ResultCacheKey, EntryList::iterator, ResultCacheKeyHash> EntryIndex;
+            typedef std::unordered_map<ResultCacheKey, std::streamoff, ResultCacheKeyHash> DiskIndex;
+
+            const Tracker *tracker;
+            ResultCacheParameters params;
+            uint64_t model;
+            Shape meanShapeRectCorners;
+
+            mutable std::mutex mutex;
+            EntryList entries;
+            EntryIndex index;
+
+            std::fstream disk;
+            DiskIndex diskIndex;
+            std::streamoff diskEnd;
+
+            ResultCacheStats stats;
+
+            bool openDisk(const std::string &path) {
+                {
+                    // Create file if not existing.
+                    std::ifstream ifs(path.c_str(), std::ios::binary);
+                    if (!ifs.is_open()) {
+                        std::ofstream ofs(path.c_str(), std::ios::binary);
+                        ofs.write(DiskMagic, sizeof(DiskMagic));
+                        if (!ofs.good())
+                            return false;
+                    }
+                }
+
+                disk.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+                if (!disk.is_open())
+                    return false;
+
+                char magic[sizeof(DiskMagic)];
+                if (!disk.read(magic, sizeof(magic)) || std::memcmp(magic, DiskMagic, sizeof(magic)) != 0) {
+                    disk.close();
+                    return false;
+                }
+
+                // Index all complete records, a truncated last record is overwritten by the next insert.
+                diskEnd = disk.tellg();
+                for (;;) {
+                    ResultCacheKey k;
+                    uint32_t numLandmarks;
+                    if (!disk.read(reinterpret_cast<char*>(&k), sizeof(k)) ||
+                        !disk.read(reinterpret_cast<char*>(&numLandmarks), sizeof(numLandmarks)) ||
+                        !disk.seekg(static_cast<std::streamoff>(numLandmarks) * 2 * sizeof(float), std::ios::cur))
+                    {
+                        break;
+                    }
+
+                    const std::streamoff next = disk.tellg();
+                    disk.seekg(0, std::ios::end);
+                    const std::streamoff size = disk.tellg();
+                    if (next > size)
+                        break;
+                    disk.seekg(next);
+
+                    diskIndex[k] = diskEnd;
+                    diskEnd = next;
+                }
+                disk.clear();
+
+                return true;
+            }
+
+            bool readDisk(std::streamoff offset, Shape &shape) {
+                disk.clear();
+                disk.seekg(offset + static_cast<std::streamoff>(sizeof(ResultCacheKey)));
+
+                uint32_t numLandmarks;
+                if (!disk.read(reinterpret_cast<char*>(&numLandmarks), sizeof(numLandmarks)))
+                    return false;
+
+                shape.resize(2, numLandmarks);
+                return static_cast<bool>(disk.read(reinterpret_cast<char*>(shape.data()), static_cast<std::streamsize>(shape.size() * sizeof(float))));
+            }
+
+            void writeDisk(const ResultCacheKey &k, const Shape &shape) {
+                const uint32_t numLandmarks = static_cast<uint32_t>(shape.cols());
+
+                disk.clear();
+                disk.seekp(diskEnd);
+                disk.write(reinterpret_cast<const char*>(&k), sizeof(k));
+                disk.write(reinterpret_cast<const char*>(&numLandmarks), sizeof(numLandmarks));
+                disk.write(reinterpret_cast<const char*>(shape.data()), static_cast<std::streamsize>(shape.size() * sizeof(float)));
+                disk.flush();
+
+                if (disk.good()) {
+                    diskIndex[k] = diskEnd;
+                    diskEnd = disk.tellp();
+                }
+            }
+
+            /** Insert into memory tier, caller holds lock. */
+            void insertMemory(const ResultCacheKey &k, const Shape &shape) {
+                EntryIndex::iterator i = index.find(k);
+                if (i != index.end()) {
+                    i->second->second = shape;
+                    entries.splice(entries.begin(), entries, i->second);
+                    return;
+                }
+
+                entries.push_front(Entry(k, shape));
+                index[k] = entries.begin();
+
+                while (entries.size() > std::max<size_t>(1, params.maxEntries)) {
+                    index.erase(entries.back().first);
+                    entries.pop_back();
+                    ++stats.numEvictions;
+                }
+            }
+        };
+
+        ResultCache::ResultCache(const Tracker &t, const ResultCacheParameters &params)
+        : _data(new data())
+        {
+            _data->tracker = &t;
+            _data->params = params;
+            _data->model = trackerFingerprint(t);
+            _data->meanShapeRectCorners = shapeBounds(t.meanShape());
+            _data->diskEnd = 0;
+
+            if (!params.diskPath.empty() && !_data->openDisk(params.diskPath)) {
+                DEST_LOG("Failed to open result cache " << params.diskPath << ", using memory only." << std::endl);
+            }
+        }
+
+        ResultCache::~ResultCache()
+        {}
+
+        ResultCacheKey ResultCache::key(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage) const
+        {
+            ResultCacheKey k;
+            k.model = _data->model;
+
+            if (!_data->params.hashFaceRegion) {
+                k.image = hashImage(img);
+                k.transform = hashTransform(shapeToImage);
+                return k;
+            }
+
+            // Bounds of twice the mean shape extent in image space, clipped to image.
+            const Shape &c = _data->meanShapeRectCorners;
+            const Eigen::Vector2f center = c.rowwise().mean();
+            const Shape expanded = ((c.colwise() - center) * 2.f).colwise() + center;
+            const Shape corners = shapeToImage * expanded.colwise().homogeneous();
+
+            const Eigen::Vector2f minC = corners.rowwise().minCoeff();
+            const Eigen::Vector2f maxC = corners.rowwise().maxCoeff();
+
+            const int x0 = std::max<int>(0, static_cast<int>(std::floor(minC.x())));
+            const int y0 = std::max<int>(0, static_cast<int>(std::floor(minC.y())));
+            const int x1 = std::min<int>(static_cast<int>(img.cols()), static_cast<int>(std::ceil(maxC.x())) + 1);
+            const int y1 = std::min<int>(static_cast<int>(img.rows()), static_cast<int>(std::ceil(maxC.y())) + 1);
+
+            k.image = hashRegion(img, x0, y0, std::max<int>(0, x1 - x0), std::max<int>(0, y1 - y0));
+
+            // Transform relative to the region, so equal crops at different positions match.
+            ShapeTransform relative = shapeToImage;
+            relative.translation() -= Eigen::Vector2f(static_cast<float>(x0), static_cast<float>(y0));
+            k.transform = hashTransform(relative);
+
+            return k;
+        }
+
+        bool ResultCache::lookup(const ResultCacheKey &key, Shape &shape)
+        {
+            ResultCache::data &data = *_data;
+            std::lock_guard<std::mutex> lock(data.mutex);
+
+            data::EntryIndex::iterator i = data.index.find(key);
+            if (i != data.index.end()) {
+                data.entries.splice(data.entries.begin(), data.entries, i->second);
+                shape = i->second->second;
+                ++data.stats.numHits;
+                return true;
+            }
+
+            data::DiskIndex::iterator d = data.diskIndex.find(key);
+            if (d != data.diskIndex.end() && data.readDisk(d->second, shape)) {
+                data.insertMemory(key, shape);
+                ++data.stats.numDiskHits;
+                return true;
+            }
+
+            ++data.stats.numMisses;
+            return false;
+        }
+
+        void ResultCache::insert(const ResultCacheKey &key, const Shape &shape)
+        {
+            ResultCache::data &data = *_data;
+            std::lock_guard<std::mutex> lock(data.mutex);
+
+            data.insertMemory(key, shape);
+            if (data.disk.is_open() && data.diskIndex.find(key) == data.diskIndex.end()) {
+                data.writeDisk(key, shape);
+            }
+        }
+
+        Shape ResultCache::predict(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage)
+        {
+            const ResultCacheKey k = key(img, shapeToImage);
+
+            Shape s;
+            if (lookup(k, s)) {
+                return shapeToImage * s.colwise().homogeneous();
+            }
+
+            s = _data->tracker->predict(img, shapeToImage);
+            insert(k, shapeToImage.inverse() * s.colwise().homogeneous());
+            return s;
+        }
+
+        void ResultCache::predict(const std::vector<MappedImage> &imgs, const std::vector<ShapeTransform> &shapeToImage, std::vector<Shape> &shapes)
+        {
+            eigen_assert(imgs.size() == shapeToImage.size());
+
+            const size_t numInputs = imgs.size();
+            shapes.resize(numInputs);
+
+            // Inputs to evaluate, each unseen key once. Duplicates refer to the evaluated input.
+            std::vector<ResultCacheKey> keys(numInputs);
+            std::unordered_map<ResultCacheKey, size_t, ResultCacheKeyHash> pending;
+            std::vector<size_t> evaluated;
+            std::vector< std::pair<size_t, size_t> > duplicates;
+
+            for (size_t i = 0; i < numInputs; ++i) {
+                keys[i] = key(imgs[i], shapeToImage[i]);
+                if (lookup(keys[i], shapes[i])) {
+                    shapes[i] = shapeToImage[i] * shapes[i].colwise().homogeneous();
+                    continue;
+                }
+
+                std::pair<std::unordered_map<ResultCacheKey, size_t, ResultCacheKeyHash>::iterator, bool> r = pending.insert(std::make_pair(keys[i], i));
+                if (r.second) {
+                    evaluated.push_back(i);
+                } else {
+                    duplicates.push_back(std::make_pair(i, r.first->second));
+                }
+            }
+
+            if (evaluated.empty())
+                return;
+
+            std::vector<MappedImage> batchImgs;
+            std::vector<ShapeTransform> batchTransforms;
+            for (size_t i = 0; i < evaluated.size(); ++i) {
+                batchImgs.push_back(imgs[evaluated[i]]);
+                batchTransforms.push_back(shapeToImage[evaluated[i]]);
+            }
+
+            std::vector<Shape> batchShapes;
+            _data->tracker->predict(batchImgs, batchTransforms, batchShapes);
+
+            std::vector<Shape> normalized(numInputs);
+            for (size_t i = 0; i < evaluated.size(); ++i) {
+                const size_t idx = evaluated[i];
+                shapes[idx] = batchShapes[i];
+                normalized[idx] = shapeToImage[idx].inverse() * batchShapes[i].colwise().homogeneous();
+                insert(keys[idx], normalized[idx]);
+            }
+
+            for (size_t i = 0; i < duplicates.size(); ++i) {
+                const size_t idx = duplicates[i].first;
+                shapes[idx] = shapeToImage[idx] * normalized[duplicates[i].second].colwise().homogeneous();
+            }
+        }
+
+        void ResultCache::clear()
+        {
+            std::lock_guard<std::mutex> lock(_data->mutex);
+            _data->entries.clear();
+            _data->index.clear();
+        }
+
+        ResultCacheStats ResultCache::stats() const
+        {
+            std::lock_guard<std::mutex> lock(_data->mutex);
+            ResultCacheStats s = _data->stats;
+            s.numEntries = _data->entries.size();
+            s.numDiskEntries = _data->diskIndex.size();
+            return s;
+        }
+
+    }
+}
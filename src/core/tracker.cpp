@@ -10,19 +10,99 @@
 
 #include <dest/core/tracker.h>
 #include <dest/core/regressor.h>
+#include <dest/core/config.h>
 #include <dest/util/log.h>
+#include <dest/util/perf_counters.h>
 #include <dest/io/matrix_io.h>
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 
 namespace dest {
     namespace core {
         
+        TrackState::TrackState()
+        : treesEvaluated(0), treesReused(0)
+        {}
+
+        void TrackState::reset()
+        {
+            cascade.clear();
+            treesEvaluated = 0;
+            treesReused = 0;
+        }
+
+        /** Coarsest pyramid level any regressor samples from for the given face. */
+        inline int cascadeSamplingLevel(const std::vector<Regressor> &cascade, const ShapeTransform &shapeToImage)
+        {
+            int level = 0;
+            for (size_t i = 0; i < cascade.size(); ++i) {
+                level = std::max<int>(level, cascade[i].samplingLevel(shapeToImage));
+            }
+            return level;
+        }
+
+        /**
+            Prepare a lazy pyramid of the image region cascades [first, last) sample from for a face. The region spans
+            twice the extent of the mean shape bounds. Its origin is aligned to the coarsest level, so that levels
+            equal those of a pyramid built from the entire image. No pixels are computed until regressors sample from it.
+        */
+        inline void createFacePyramid(const Eigen::Ref<const Image> &img, const Shape &meanShapeRectCorners, const std::vector<Regressor> &cascade, int first, int last, const ShapeTransform &shapeToImage, ImagePyramid &pyr)
+        {
+            int numLevels = 0;
+            for (int i = first; i < last; ++i) {
+                numLevels = std::max<int>(numLevels, cascade[i].samplingLevel(shapeToImage));
+            }
+
+            if (numLevels <= 0) {
+                pyr.createLazy(img, 0, 0, 0, 0, 0);
+                return;
+            }
+
+            const Eigen::Vector2f center = meanShapeRectCorners.rowwise().mean();
+            const Shape expanded = ((meanShapeRectCorners.colwise() - center) * 2.f).colwise() + center;
+            const Shape corners = shapeToImage * expanded.colwise().homogeneous();
+
+            const int block = 1 << numLevels;
+            const Eigen::Vector2f minC = corners.rowwise().minCoeff();
+            const Eigen::Vector2f maxC = corners.rowwise().maxCoeff();
+
+            const int x0 = std::max<int>(0, static_cast<int>(std::floor(minC.x())) - block) / block * block;
+            const int y0 = std::max<int>(0, static_cast<int>(std::floor(minC.y())) - block) / block * block;
+            const int x1 = static_cast<int>(std::ceil(maxC.x())) + block;
+            const int y1 = static_cast<int>(std::ceil(maxC.y())) + block;
+
+            pyr.createLazy(img, x0, y0, x1 - x0, y1 - y0, numLevels);
+        }
+
+        /** Build a pyramid of each entire training image with the given number of levels. */
+        inline const std::vector<ImagePyramid> *createPyramids(const std::vector<Image> &images, const std::vector<int> &levels, std::vector<ImagePyramid> &pyramids)
+        {
+            const int numImages = static_cast<int>(images.size());
+            pyramids.resize(numImages);
+
+#ifdef DEST_WITH_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < numImages; ++i) {
+                const Image &img = images[i];
+                pyramids[i].create(img, 0, 0, static_cast<int>(img.cols()), static_cast<int>(img.rows()), levels[i]);
+            }
+
+            return &pyramids;
+        }
+
         struct Tracker::data {
             typedef std::vector<Regressor> RegressorVector;            
             RegressorVector cascade;
             Shape meanShape;
-            Shape meanShapeRectCorners;            
+            Shape meanShapeRectCorners;
+            SamplingStrategy samplingStrategy;
+            float lazySamplingCost;
+
+            data()
+            : samplingStrategy(SAMPLING_AUTO), lazySamplingCost(Regressor::DefaultLazySamplingCost)
+            {}
 
             flatbuffers::Offset<io::Tracker> save(flatbuffers::FlatBufferBuilder &fbb) const {
                 flatbuffers::Offset<io::MatrixF> lmeans = io::toFbs(fbb, meanShape);
@@ -51,6 +131,8 @@ namespace dest {
                 cascade.resize(fbs.cascade()->size());
                 for (flatbuffers::uoffset_t i = 0; i < fbs.cascade()->size(); ++i) {
                     cascade[i].load(*fbs.cascade()->Get(i));
+                    cascade[i].setLazySamplingCost(lazySamplingCost);
+                    cascade[i].setSamplingStrategy(samplingStrategy);
                 }
             }
         };
@@ -116,6 +198,8 @@ namespace dest {
         }
         
         bool Tracker::fit(SampleData &t) {
+            util::PerfScope perf(util::PERF_PHASE_FIT);
+
             eigen_assert(!t.samples.empty());
             
             DEST_LOG("Starting to fit tracker on " << t.samples.size() << " samples." << std::endl);
@@ -130,6 +214,21 @@ namespace dest {
             rt.numLandmarks = static_cast<int>(t.samples.front().estimate.cols());
             rt.input = t.input;
             
+            // Pyramids to sample coarse stages from.
+            std::vector<ImagePyramid> pyramids;
+            if (t.params.pyramidSamplesPerLambda > 0.f) {
+                std::vector<int> levels(t.input->images.size(), 0);
+                float lambda = t.params.exponentialLambda;
+                for (int i = 0; i < t.params.numCascades; ++i) {
+                    const float spacing = lambda / t.params.pyramidSamplesPerLambda;
+                    for (int s = 0; s < numSamples; ++s) {
+                        int &l = levels[t.samples[s].inputIdx];
+                        l = std::max<int>(l, Regressor::samplingLevel(spacing, t.samples[s].shapeToImage));
+                    }
+                    lambda *= t.params.exponentialLambdaDecreaseFactor;
+                }
+                rt.pyramids = createPyramids(t.input->images, levels, pyramids);
+            }
             
             // Re-eval mean shape here.
             rt.meanShape = Shape::Zero(2, rt.numLandmarks);
@@ -140,6 +239,7 @@ namespace dest {
             
             // Build cascade
             data.cascade.resize(t.params.numCascades);
+            ImagePyramid empty;
             
             float initialLambda = rt.training->params.exponentialLambda;
             
@@ -148,12 +248,16 @@ namespace dest {
                 
                 // Fit gradient boosted trees.
                 data.cascade[i].fit(rt);
+                data.cascade[i].setLazySamplingCost(data.lazySamplingCost);
+                data.cascade[i].setSamplingStrategy(data.samplingStrategy);
                 
                 // Update shape estimate
                 double error = 0.0;
                 for (int s = 0; s < numSamples; ++s) {
+                    const int idx = t.samples[s].inputIdx;
                     t.samples[s].estimate +=
-                        data.cascade[i].predict(t.input->images[t.samples[s].inputIdx],
+                        data.cascade[i].predict(t.input->images[idx],
+                                                pyramids.empty() ? empty : pyramids[idx],
                                                 t.samples[s].estimate,
                                                 t.samples[s].shapeToImage);
                     
@@ -174,17 +278,77 @@ namespace dest {
 
         }
         
+        bool Tracker::refit(SampleData &t) {
+            util::PerfScope perf(util::PERF_PHASE_FIT);
+
+            eigen_assert(!t.samples.empty());
+
+            Tracker::data &data = *_data;
+            if (data.cascade.empty())
+                return false;
+
+            DEST_LOG("Starting to refit tracker on " << t.samples.size() << " samples." << std::endl);
+
+            const int numSamples = static_cast<int>(t.samples.size());
+
+            RegressorTraining rt;
+            rt.training = &t;
+            rt.numLandmarks = static_cast<int>(data.meanShape.cols());
+            rt.input = t.input;
+            rt.meanShape = data.meanShape;
+
+            std::vector<ImagePyramid> pyramids;
+            std::vector<int> levels(t.input->images.size(), 0);
+            for (int s = 0; s < numSamples; ++s) {
+                int &l = levels[t.samples[s].inputIdx];
+                l = std::max<int>(l, cascadeSamplingLevel(data.cascade, t.samples[s].shapeToImage));
+            }
+            if (*std::max_element(levels.begin(), levels.end()) > 0) {
+                rt.pyramids = createPyramids(t.input->images, levels, pyramids);
+            }
+            ImagePyramid empty;
+
+            const int numCascades = static_cast<int>(data.cascade.size());
+            for (int i = 0; i < numCascades; ++i) {
+                DEST_LOG("Refitting cascade " << i + 1 << std::endl);
+
+                data.cascade[i].refit(rt);
+
+                // Update shape estimate
+                double error = 0.0;
+                for (int s = 0; s < numSamples; ++s) {
+                    const int idx = t.samples[s].inputIdx;
+                    t.samples[s].estimate +=
+                        data.cascade[i].predict(t.input->images[idx],
+                                                pyramids.empty() ? empty : pyramids[idx],
+                                                t.samples[s].estimate,
+                                                t.samples[s].shapeToImage);
+
+                    error += (t.samples[s].target - t.samples[s].estimate).colwise().norm().sum();
+                }
+                error /= rt.numLandmarks * numSamples;
+                DEST_LOG("Average error " << std::setprecision(3) << std::fixed << error << std::endl);
+            }
+
+            return true;
+        }
+
         Shape Tracker::predict(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, std::vector<Shape> *stepResults) const
         {
+            util::PerfScope perf(util::PERF_PHASE_PREDICT);
+
             Tracker::data &data = *_data;
 
+            ImagePyramid pyr;
+            createFacePyramid(img, data.meanShapeRectCorners, data.cascade, 0, static_cast<int>(data.cascade.size()), shapeToImage, pyr);
+
             Shape estimate = data.meanShape;
             const int numCascades = static_cast<int>(data.cascade.size());
             for (int i = 0; i < numCascades; ++i) {
                 if (stepResults) {
                     stepResults->push_back(shapeToImage * estimate.colwise().homogeneous());
                 }
-                estimate += data.cascade[i].predict(img, estimate, shapeToImage);
+                estimate += data.cascade[i].predict(img, pyr, estimate, shapeToImage);
             }
 
             Shape final = shapeToImage * estimate.colwise().homogeneous();
@@ -194,6 +358,152 @@ namespace dest {
             }
 
             return final;
-        }        
+        }
+
+        Shape Tracker::predict(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, TrackState &state) const
+        {
+            util::PerfScope perf(util::PERF_PHASE_PREDICT);
+
+            Tracker::data &data = *_data;
+
+            const int numCascades = static_cast<int>(data.cascade.size());
+            if (static_cast<int>(state.cascade.size()) != numCascades) {
+                state.reset();
+                state.cascade.resize(numCascades);
+            }
+
+            state.treesEvaluated = 0;
+            state.treesReused = 0;
+
+            ImagePyramid pyr;
+            createFacePyramid(img, data.meanShapeRectCorners, data.cascade, 0, static_cast<int>(data.cascade.size()), shapeToImage, pyr);
+
+            Shape estimate = data.meanShape;
+            for (int i = 0; i < numCascades; ++i) {
+                estimate += data.cascade[i].predict(img, pyr, estimate, shapeToImage, state.cascade[i]);
+                state.treesEvaluated += state.cascade[i].treesEvaluated;
+                state.treesReused += state.cascade[i].treesReused;
+            }
+
+            return shapeToImage * estimate.colwise().homogeneous();
+        }
+
+        void Tracker::predict(const std::vector<MappedImage> &imgs, const std::vector<ShapeTransform> &shapeToImage, std::vector<Shape> &shapes) const
+        {
+            util::PerfScope perf(util::PERF_PHASE_PREDICT);
+
+            eigen_assert(imgs.size() == shapeToImage.size());
+
+            Tracker::data &data = *_data;
+
+            const int numInputs = static_cast<int>(imgs.size());
+            std::vector<Shape> estimates(numInputs, data.meanShape);
+            std::vector<ImagePyramid> pyramids(numInputs);
+            for (int j = 0; j < numInputs; ++j) {
+                createFacePyramid(imgs[j], data.meanShapeRectCorners, data.cascade, 0, static_cast<int>(data.cascade.size()), shapeToImage[j], pyramids[j]);
+            }
+
+            const int numCascades = static_cast<int>(data.cascade.size());
+            for (int i = 0; i < numCascades; ++i) {
+#ifdef DEST_WITH_OPENMP
+                #pragma omp parallel for schedule(static)
+#endif
+                for (int j = 0; j < numInputs; ++j) {
+                    estimates[j] += data.cascade[i].predict(imgs[j], pyramids[j], estimates[j], shapeToImage[j]);
+                }
+            }
+
+            shapes.resize(numInputs);
+            for (int j = 0; j < numInputs; ++j) {
+                shapes[j] = shapeToImage[j] * estimates[j].colwise().homogeneous();
+            }
+        }
+
+        void Tracker::predictCascades(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, int first, int last, Shape &estimate) const
+        {
+            util::PerfScope perf(util::PERF_PHASE_PREDICT);
+
+            Tracker::data &data = *_data;
+
+            first = std::max<int>(0, first);
+            last = std::min<int>(static_cast<int>(data.cascade.size()), last);
+
+            ImagePyramid pyr;
+            createFacePyramid(img, data.meanShapeRectCorners, data.cascade, first, last, shapeToImage, pyr);
+
+            for (int i = first; i < last; ++i) {
+                estimate += data.cascade[i].predict(img, pyr, estimate, shapeToImage);
+            }
+        }
+
+        void Tracker::createPyramid(const Eigen::Ref<const Image> &img, const ShapeTransform &shapeToImage, ImagePyramid &pyr) const
+        {
+            createFacePyramid(img, _data->meanShapeRectCorners, _data->cascade, 0, static_cast<int>(_data->cascade.size()), shapeToImage, pyr);
+        }
+
+        void Tracker::predictCascades(const Eigen::Ref<const Image> &img, ImagePyramid &pyr, const ShapeTransform &shapeToImage, int first, int last, Shape &estimate) const
+        {
+            util::PerfScope perf(util::PERF_PHASE_PREDICT);
+
+            Tracker::data &data = *_data;
+
+            first = std::max<int>(0, first);
+            last = std::min<int>(static_cast<int>(data.cascade.size()), last);
+
+            for (int i = first; i < last; ++i) {
+                estimate += data.cascade[i].predict(img, pyr, estimate, shapeToImage);
+            }
+        }
+
+        void Tracker::setSamplingStrategy(SamplingStrategy s)
+        {
+            _data->samplingStrategy = s;
+            for (size_t i = 0; i < _data->cascade.size(); ++i) {
+                _data->cascade[i].setSamplingStrategy(s);
+            }
+        }
+
+        SamplingStrategy Tracker::samplingStrategy() const
+        {
+            return _data->samplingStrategy;
+        }
+
+        void Tracker::setLazySamplingCost(float cost)
+        {
+            _data->lazySamplingCost = std::max<float>(0.f, cost);
+            for (size_t i = 0; i < _data->cascade.size(); ++i) {
+                _data->cascade[i].setLazySamplingCost(_data->lazySamplingCost);
+            }
+        }
+
+        float Tracker::lazySamplingCost() const
+        {
+            return _data->lazySamplingCost;
+        }
+
+        int Tracker::numLazySamplingCascades() const
+        {
+            int count = 0;
+            for (size_t i = 0; i < _data->cascade.size(); ++i) {
+                if (_data->cascade[i].lazySampling())
+                    ++count;
+            }
+            return count;
+        }
+
+        int Tracker::maxSamplingLevel(const ShapeTransform &shapeToImage) const
+        {
+            return cascadeSamplingLevel(_data->cascade, shapeToImage);
+        }
+
+        int Tracker::numCascades() const
+        {
+            return static_cast<int>(_data->cascade.size());
+        }
+
+        const Shape &Tracker::meanShape() const
+        {
+            return _data->meanShape;
+        }
     }
 }
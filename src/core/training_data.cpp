@@ -26,6 +26,8 @@ namespace dest {
             exponentialLambdaDecreaseFactor = 0.9f;
             learningRate = 0.05f;
             expansionRandomPixelCoordinates = 0.05f;
+            pyramidSamplesPerLambda = 0.f;
+            splitSelection = SPLIT_RANDOM;
         }
         
         std::ostream& operator<<(std::ostream &stream, const TrainingParameters &obj) {
@@ -37,7 +39,9 @@ namespace dest {
                    << std::setw(30) << std::left << "Random pixel expansion" << std::setw(10) << obj.expansionRandomPixelCoordinates << std::endl
                    << std::setw(30) << std::left << "Exponential lambda" << std::setw(10) << obj.exponentialLambda << std::endl
                    << std::setw(30) << std::left << "Exponential lambda decrease" << std::setw(10) << obj.exponentialLambdaDecreaseFactor << std::endl
-                   << std::setw(30) << std::left << "Learning rate" << std::setw(10) << obj.learningRate;
+                   << std::setw(30) << std::left << "Learning rate" << std::setw(10) << obj.learningRate << std::endl
+                   << std::setw(30) << std::left << "Pyramid samples per lambda" << std::setw(10) << obj.pyramidSamplesPerLambda << std::endl
+                   << std::setw(30) << std::left << "Split selection" << std::setw(10) << (obj.splitSelection == SPLIT_CORRELATION ? "correlation" : "random");
             return stream;
         }
         
@@ -135,6 +139,10 @@ namespace dest {
             return meanShape;
         }
         
+        RegressorTraining::RegressorTraining()
+        : input(0), training(0), numLandmarks(0), pyramids(0)
+        {}
+
         void SampleData::createTestingSamples(SampleData &td) {
             const int numSamples = static_cast<int>(td.input->shapes.size());
             td.samples.resize(numSamples);
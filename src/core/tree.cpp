@@ -13,6 +13,9 @@
 #include <dest/util/log.h>
 #include <dest/io/matrix_io.h>
 #include <queue>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 namespace dest {
     namespace core {
@@ -101,6 +104,33 @@ namespace dest {
             
             return std::make_pair(mean, numElements);
         }
+
+        /**
+            Collects indices of the n largest and the n smallest values in a single pass. Candidates
+            are kept sorted by insertion, which is cheap for the small n used during split selection.
+        */
+        inline void extremeIndices(const float *values, int count, int n, int *largest, int *smallest) {
+            for (int i = 0; i < n; ++i) {
+                largest[i] = i;
+            }
+            std::sort(largest, largest + n, [values](int a, int b) { return values[a] > values[b]; });
+            std::reverse_copy(largest, largest + n, smallest);
+
+            for (int i = n; i < count; ++i) {
+                const float v = values[i];
+                if (v > values[largest[n - 1]]) {
+                    int j = n - 1;
+                    for (; j > 0 && v > values[largest[j - 1]]; --j)
+                        largest[j] = largest[j - 1];
+                    largest[j] = i;
+                } else if (v < values[smallest[n - 1]]) {
+                    int j = n - 1;
+                    for (; j > 0 && v < values[smallest[j - 1]]; --j)
+                        smallest[j] = smallest[j - 1];
+                    smallest[j] = i;
+                }
+            }
+        }
         
         struct Tree::data {
             
@@ -158,6 +188,14 @@ namespace dest {
             _data->load(fbs);
         }
         
+        /** True when split candidates are chosen by correlation and the stage provides the required statistics. */
+        inline bool correlationSplits(const TreeTraining &t)
+        {
+            return t.training->params.splitSelection == SPLIT_CORRELATION &&
+                   t.pixelCovariance.rows() == t.pixelCoordinates.cols() &&
+                   t.pixelBasis.rows() == t.pixelCoordinates.cols();
+        }
+
         bool Tree::fit(TreeTraining &t)
         {
             std::vector<Tree::TreeNode> &nodes = _data->nodes;
@@ -167,6 +205,25 @@ namespace dest {
             const int numNodes = (int)std::pow(2.0, depth) - 1;
             nodes.resize(numNodes);
 
+            if (correlationSplits(t)) {
+                // Residuals are projected onto random directions once per tree, all nodes share the projections.
+                const int numDims = 2 * t.numLandmarks;
+                const int numTests = t.training->params.numRandomSplitTestsPerNode;
+
+                std::normal_distribution<float> dn(0.f, 1.f);
+                Eigen::MatrixXf directions(numDims, numTests);
+                for (int k = 0; k < numTests; ++k) {
+                    for (int d = 0; d < numDims; ++d) {
+                        directions(d, k) = dn(t.input->rnd);
+                    }
+                }
+
+                for (size_t i = 0; i < t.samples.size(); ++i) {
+                    TreeTraining::Sample &sample = t.samples[i];
+                    sample.projections = Eigen::Map<const Eigen::RowVectorXf>(sample.residual.data(), numDims) * directions;
+                }
+            }
+
             // Split recursively in BFS
             std::queue<NodeInfo> queue;
             queue.push(NodeInfo(0, 1, std::make_pair(t.samples.begin(), t.samples.end())));
@@ -192,6 +249,54 @@ namespace dest {
             return true;
         }
         
+        template<class Node, class Intensities>
+        inline int traverse(const Node *nodes, int depth, Intensities &intensities)
+        {
+            const int maxTests = depth - 1;
+
+            int n = 0;
+            for (int i = 0; i < maxTests; ++i) {
+                const Node &node = nodes[n];
+
+                if (node.split.idx1 < 0)
+                    break; // premature leaf
+
+                bool left = intensities(node.split.idx1) - intensities(node.split.idx2) > node.split.threshold;
+
+                n = left ? 2 * n + 1 : 2 * n + 2;
+            }
+
+            return n;
+        }
+
+        bool Tree::refitLeaves(TreeTraining &t)
+        {
+            std::vector<Tree::TreeNode> &nodes = _data->nodes;
+            if (nodes.empty())
+                return false;
+
+            std::vector<ShapeResidual> sums(nodes.size());
+            std::vector<int> counts(nodes.size(), 0);
+
+            for (size_t i = 0; i < t.samples.size(); ++i) {
+                const int leaf = traverse(&nodes[0], _data->depth, t.samples[i].intensities);
+                if (counts[leaf] == 0) {
+                    sums[leaf] = t.samples[i].residual;
+                } else {
+                    sums[leaf] += t.samples[i].residual;
+                }
+                ++counts[leaf];
+            }
+
+            for (size_t n = 0; n < nodes.size(); ++n) {
+                if (counts[n] > 0) {
+                    nodes[n].mean = sums[n] / static_cast<float>(counts[n]);
+                }
+            }
+
+            return true;
+        }
+
         struct Tree::PartitionPredicate {
             SplitInfo split;
             
@@ -209,9 +314,13 @@ namespace dest {
                 return false;
             }
             
-            // Generate random split positions
+            // Generate split positions
             std::vector<SplitInfo> splits;
-            sampleSplitPositions(t, splits);
+            if (correlationSplits(t)) {
+                sampleCorrelatedSplitPositions(t, parent, splits);
+            } else {
+                sampleSplitPositions(t, splits);
+            }
 
             if (splits.empty())
                 return false;
@@ -299,6 +408,84 @@ namespace dest {
             }
         }
         
+        void Tree::sampleCorrelatedSplitPositions(TreeTraining &t, const NodeInfo &parent, std::vector<SplitInfo> &splits) const
+        {
+            splits.clear();
+
+            const int numSamples = numElementsInRange(parent.range);
+            const int numPixels = static_cast<int>(t.pixelCoordinates.cols());
+            const int numComponents = static_cast<int>(t.pixelBasis.cols());
+            const int numTests = static_cast<int>(t.samples.front().projections.size());
+
+            if (numSamples < 2 || numPixels < 2)
+                return;
+
+            // Centered principal components of intensities and residual projections of samples in node. Covariances
+            // of large nodes are estimated from an evenly spaced subset, which bounds the cost per node.
+            const int maxCovarianceSamples = 256;
+            const int numCovSamples = std::min<int>(numSamples, maxCovarianceSamples);
+
+            typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+            RowMajorMatrix components(numCovSamples, numComponents);
+            RowMajorMatrix projections(numCovSamples, numTests);
+
+            for (int row = 0; row < numCovSamples; ++row) {
+                const TreeTraining::Sample &sample = *(parent.range.first + (static_cast<size_t>(row) * numSamples) / numCovSamples);
+                components.row(row) = sample.components;
+                projections.row(row) = sample.projections;
+            }
+
+            components.rowwise() -= components.colwise().mean();
+            projections.rowwise() -= projections.colwise().mean();
+
+            // Covariance between each pixel and each projection, mapped back from principal components. Costs
+            // numCovSamples * numComponents * numTests plus numPixels * numComponents * numTests.
+            const Eigen::MatrixXf componentCov = (components.transpose() * projections) / static_cast<float>(numCovSamples);
+            const Eigen::MatrixXf pixelCov = t.pixelBasis * componentCov;
+
+            // Correlation of a pixel difference with the projection is (cov(m) - cov(n)) / std(m - n) up to a
+            // constant. Instead of all pairs, only pairs of pixels with highest and lowest covariance are scored.
+            // Variances of pixel differences are taken from the stage-wide pixel covariance.
+            const Eigen::MatrixXf &sigma = t.pixelCovariance;
+            const int numCandidates = std::min<int>(numPixels / 2, 8);
+
+            int largest[8], smallest[8];
+            std::uniform_int_distribution<int> ds(0, numSamples - 1);
+
+            for (int k = 0; k < numTests; ++k) {
+                const float *cov = pixelCov.col(k).data();
+                extremeIndices(cov, numPixels, numCandidates, largest, smallest);
+
+                float bestScore = 0.f;
+                SplitInfo split;
+                split.idx1 = -1;
+                for (int a = 0; a < numCandidates; ++a) {
+                    const int m = largest[a];
+                    for (int b = 0; b < numCandidates; ++b) {
+                        const int n = smallest[b];
+                        const float var = sigma(m, m) + sigma(n, n) - 2.f * sigma(m, n);
+                        if (var <= 1e-6f)
+                            continue;
+
+                        const float score = (cov[m] - cov[n]) / std::sqrt(var);
+                        if (score > bestScore) {
+                            bestScore = score;
+                            split.idx1 = m;
+                            split.idx2 = n;
+                        }
+                    }
+                }
+
+                if (split.idx1 < 0)
+                    continue;
+
+                // Threshold at the difference of a random sample, so that both children are non-empty in general.
+                const PixelIntensities &sample = (parent.range.first + ds(t.input->rnd))->intensities;
+                split.threshold = sample(split.idx1) - sample(split.idx2);
+                splits.push_back(split);
+            }
+        }
+
         float Tree::splitEnergy(TreeTraining &t, const NodeInfo &parent, const ShapeResidual &parentMeanResidual, const SplitInfo &split) const {
             
             PartitionPredicate pred;
@@ -318,26 +505,106 @@ namespace dest {
         
         ShapeResidual Tree::predict(const PixelIntensities &intensities) const
         {
-            const TreeNode *nodes = &_data->nodes[0];
-            
-            const int maxTests = _data->depth - 1;
-            
+            return _data->nodes[traverse(&_data->nodes[0], _data->depth, intensities)].mean;
+        }
+
+        ShapeResidual Tree::predict(LazyPixelIntensities &intensities) const
+        {
+            return _data->nodes[traverse(&_data->nodes[0], _data->depth, intensities)].mean;
+        }
+
+        template<class Node, class Intensities>
+        inline bool traverseIncremental(const Node *nodes, int depth, Intensities &intensities, int &leaf, float &margin, float *pathIntensities)
+        {
+            if (leaf >= 0) {
+                // Walk up from the previous leaf, level of a node is floor(log2(n + 1)).
+                int level = 0;
+                while ((2 << level) - 1 <= leaf)
+                    ++level;
+
+                float maxChange = 0.f;
+                for (int n = leaf; n > 0; ) {
+                    n = (n - 1) / 2;
+                    --level;
+                    const Node &node = nodes[n];
+                    maxChange = std::max<float>(maxChange, std::abs(intensities(node.split.idx1) - pathIntensities[2 * level + 0]));
+                    maxChange = std::max<float>(maxChange, std::abs(intensities(node.split.idx2) - pathIntensities[2 * level + 1]));
+                }
+
+                // The pixel difference changed by at most twice the largest intensity change.
+                if (2.f * maxChange < margin)
+                    return false;
+            }
+
+            const int maxTests = depth - 1;
+
             int n = 0;
+            margin = std::numeric_limits<float>::max();
             for (int i = 0; i < maxTests; ++i) {
-                const TreeNode &node = nodes[n];
-                
+                const Node &node = nodes[n];
+
                 if (node.split.idx1 < 0)
                     break; // premature leaf
-                
-                bool left = intensities(node.split.idx1) - intensities(node.split.idx2) > node.split.threshold;
-                
-                n = left ? 2 * n + 1 : 2 * n + 2;
+
+                const float i1 = intensities(node.split.idx1);
+                const float i2 = intensities(node.split.idx2);
+                pathIntensities[2 * i + 0] = i1;
+                pathIntensities[2 * i + 1] = i2;
+
+                const float d = i1 - i2 - node.split.threshold;
+                margin = std::min<float>(margin, std::abs(d));
+
+                n = (d > 0.f) ? 2 * n + 1 : 2 * n + 2;
+            }
+
+            leaf = n;
+            return true;
+        }
+
+        bool Tree::findLeaf(const PixelIntensities &intensities, int &leaf, float &margin, float *pathIntensities) const
+        {
+            return traverseIncremental(&_data->nodes[0], _data->depth, intensities, leaf, margin, pathIntensities);
+        }
+
+        bool Tree::findLeaf(LazyPixelIntensities &intensities, int &leaf, float &margin, float *pathIntensities) const
+        {
+            return traverseIncremental(&_data->nodes[0], _data->depth, intensities, leaf, margin, pathIntensities);
+        }
+
+        const ShapeResidual &Tree::leafResidual(int leaf) const
+        {
+            return _data->nodes[leaf].mean;
+        }
+
+        int Tree::depth() const
+        {
+            return _data->depth;
+        }
+
+        void Tree::accumulatePixelAccessRates(Eigen::VectorXf &rates) const
+        {
+            const std::vector<TreeNode> &nodes = _data->nodes;
+            const int maxTests = _data->depth - 1;
+
+            // Visit split nodes reachable from the root, probability of reaching a node halves per level.
+            std::queue< std::pair<int, int> > queue;
+            queue.push(std::make_pair(0, 0));
+
+            while (!queue.empty()) {
+                const std::pair<int, int> nl = queue.front(); queue.pop();
+                const TreeNode &node = nodes[nl.first];
+
+                if (nl.second >= maxTests || node.split.idx1 < 0)
+                    continue;
+
+                const float p = std::ldexp(1.f, -nl.second);
+                rates(node.split.idx1) += p;
+                rates(node.split.idx2) += p;
+
+                queue.push(std::make_pair(2 * nl.first + 1, nl.second + 1));
+                queue.push(std::make_pair(2 * nl.first + 2, nl.second + 1));
             }
-            
-            return nodes[n].mean;
         }
 
-        
-        
     }
-}
\ No newline at end of file
+}
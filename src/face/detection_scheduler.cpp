@@ -0,0 +1,166 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/face/detection_scheduler.h>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+namespace dest {
+    namespace face {
+
+        DetectionSchedulerParameters::DetectionSchedulerParameters()
+        {
+            baseInterval = 5;
+            minInterval = 1;
+            maxInterval = 120;
+            backoffFactor = 2.f;
+            motionThreshold = 6.f;
+            uncertaintyThreshold = 0.05f;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const DetectionSchedulerParameters &obj) {
+            stream << std::setw(30) << std::left << "Base interval" << std::setw(10) << obj.baseInterval << std::endl
+                   << std::setw(30) << std::left << "Minimum interval" << std::setw(10) << obj.minInterval << std::endl
+                   << std::setw(30) << std::left << "Maximum interval" << std::setw(10) << obj.maxInterval << std::endl
+                   << std::setw(30) << std::left << "Backoff factor" << std::setw(10) << obj.backoffFactor << std::endl
+                   << std::setw(30) << std::left << "Motion threshold" << std::setw(10) << obj.motionThreshold << std::endl
+                   << std::setw(30) << std::left << "Uncertainty threshold" << std::setw(10) << obj.uncertaintyThreshold;
+            return stream;
+        }
+
+        DetectionSchedulerStats::DetectionSchedulerStats()
+        : numFrames(0), numDetections(0), numBaselineDetections(0), numMotionTriggers(0), numTrackedFrames(0), interval(1)
+        {}
+
+        int DetectionSchedulerStats::detectionsSaved() const
+        {
+            return numBaselineDetections - numDetections;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const DetectionSchedulerStats &obj) {
+            stream << std::setw(30) << std::left << "Frames" << std::setw(10) << obj.numFrames << std::endl
+                   << std::setw(30) << std::left << "Detections" << std::setw(10) << obj.numDetections << std::endl
+                   << std::setw(30) << std::left << "Fixed cadence detections" << std::setw(10) << obj.numBaselineDetections << std::endl
+                   << std::setw(30) << std::left << "Detections saved" << std::setw(10) << obj.detectionsSaved() << std::endl
+                   << std::setw(30) << std::left << "Motion triggers" << std::setw(10) << obj.numMotionTriggers << std::endl
+                   << std::setw(30) << std::left << "Tracked frames" << std::setw(10) << obj.numTrackedFrames << std::endl
+                   << std::setw(30) << std::left << "Current interval" << std::setw(10) << obj.interval;
+            return stream;
+        }
+
+        DetectionScheduler::DetectionScheduler(const DetectionSchedulerParameters &params)
+        : _params(params), _tracking(false), _uncertain(false), _forced(true), _framesSinceDetection(0)
+        {
+            _params.minInterval = std::max<int>(1, _params.minInterval);
+            _params.baseInterval = std::max<int>(_params.minInterval, _params.baseInterval);
+            _params.maxInterval = std::max<int>(_params.baseInterval, _params.maxInterval);
+            _params.backoffFactor = std::max<float>(1.f, _params.backoffFactor);
+
+            _stats.interval = _params.minInterval;
+        }
+
+        bool DetectionScheduler::shouldDetect(float motion)
+        {
+            if (_stats.numFrames % _params.baseInterval == 0)
+                ++_stats.numBaselineDetections;
+            ++_stats.numFrames;
+            ++_framesSinceDetection;
+
+            if (motion > _params.motionThreshold) {
+                // A confident track follows motion by itself, so detection is only brought forward a bit.
+                const int interval = (_tracking && !_uncertain)
+                    ? std::max<int>(_params.minInterval, _params.baseInterval / 2)
+                    : _params.minInterval;
+
+                if (_stats.interval > interval) {
+                    _stats.interval = interval;
+                    ++_stats.numMotionTriggers;
+                }
+            }
+
+            if (_forced || _framesSinceDetection >= _stats.interval) {
+                _forced = false;
+                _framesSinceDetection = 0;
+                ++_stats.numDetections;
+                return true;
+            }
+
+            return false;
+        }
+
+        void DetectionScheduler::reportDetection(bool faceFound)
+        {
+            _uncertain = false;
+            if (faceFound) {
+                _tracking = true;
+                _stats.interval = _params.baseInterval;
+            } else if (_tracking) {
+                // Face lost, start backing off from the shortest interval.
+                _tracking = false;
+                _stats.interval = _params.minInterval;
+            } else {
+                const float next = std::ceil(static_cast<float>(_stats.interval) * _params.backoffFactor);
+                _stats.interval = static_cast<int>(std::min<float>(static_cast<float>(_params.maxInterval), next));
+            }
+        }
+
+        void DetectionScheduler::reportTrack(float uncertainty)
+        {
+            if (!_tracking)
+                return;
+
+            ++_stats.numTrackedFrames;
+
+            _uncertain = uncertainty > _params.uncertaintyThreshold;
+            if (_uncertain) {
+                _stats.interval = std::max<int>(_params.minInterval, _stats.interval / 2);
+            } else if (_stats.interval < _params.baseInterval) {
+                ++_stats.interval;
+            }
+        }
+
+        void DetectionScheduler::requestDetection()
+        {
+            _forced = true;
+        }
+
+        bool DetectionScheduler::tracking() const
+        {
+            return _tracking;
+        }
+
+        const DetectionSchedulerStats &DetectionScheduler::stats() const
+        {
+            return _stats;
+        }
+
+        float DetectionScheduler::measureMotion(const Eigen::Ref<const core::Image> &prev, const Eigen::Ref<const core::Image> &cur, int step)
+        {
+            if (prev.rows() != cur.rows() || prev.cols() != cur.cols() || cur.size() == 0)
+                return 0.f;
+
+            step = std::max<int>(1, step);
+
+            long long sum = 0;
+            long long count = 0;
+            for (int y = step / 2; y < cur.rows(); y += step) {
+                for (int x = step / 2; x < cur.cols(); x += step) {
+                    sum += std::abs(static_cast<int>(cur(y, x)) - static_cast<int>(prev(y, x)));
+                    ++count;
+                }
+            }
+
+            return count > 0 ? static_cast<float>(sum) / static_cast<float>(count) : 0.f;
+        }
+
+    }
+}
@@ -0,0 +1,325 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/face/tiled_processor.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+namespace dest {
+    namespace face {
+
+        TileSource::~TileSource()
+        {}
+
+        bool TileSource::threadSafe() const
+        {
+            return false;
+        }
+
+        ImageTileSource::ImageTileSource(const Eigen::Ref<const core::Image> &img)
+        : _img(img.data(), img.rows(), img.cols(), Eigen::OuterStride<Eigen::Dynamic>(img.outerStride()))
+        {}
+
+        int ImageTileSource::width() const
+        {
+            return static_cast<int>(_img.cols());
+        }
+
+        int ImageTileSource::height() const
+        {
+            return static_cast<int>(_img.rows());
+        }
+
+        bool ImageTileSource::readRegion(int x, int y, int w, int h, core::Image &dst)
+        {
+            dst = _img.block(y, x, h, w);
+            return true;
+        }
+
+        TiledParameters::TiledParameters()
+        {
+            tileSize = 2048;
+            tileOverlap = 256;
+            nmsOverlap = 0.5f;
+            footprintScale = 2.f;
+            numThreads = 0;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const TiledParameters &obj) {
+            stream << std::setw(30) << std::left << "Tile size" << std::setw(10) << obj.tileSize << std::endl
+                   << std::setw(30) << std::left << "Tile overlap" << std::setw(10) << obj.tileOverlap << std::endl
+                   << std::setw(30) << std::left << "NMS overlap" << std::setw(10) << obj.nmsOverlap << std::endl
+                   << std::setw(30) << std::left << "Footprint scale" << std::setw(10) << obj.footprintScale << std::endl
+                   << std::setw(30) << std::left << "Number of threads" << std::setw(10) << obj.numThreads;
+            return stream;
+        }
+
+        TiledStats::TiledStats()
+        : numTiles(0), numDetections(0), numFaces(0), peakResidentPixels(0)
+        {}
+
+        /** Tracks pixels held by workers and the peak thereof. */
+        struct ResidentCounter {
+            std::atomic<size_t> current;
+            std::atomic<size_t> peak;
+
+            ResidentCounter()
+            : current(0), peak(0)
+            {}
+
+            void acquire(size_t n) {
+                const size_t c = current.fetch_add(n) + n;
+                size_t p = peak.load();
+                while (c > p && !peak.compare_exchange_weak(p, c))
+                    ;
+            }
+
+            void release(size_t n) {
+                current.fetch_sub(n);
+            }
+        };
+
+        /**
+            Run fn(i) for i in [0, count) on the given number of threads. Work items are handed out
+            dynamically, since tiles and faces vary in cost.
+        */
+        template<class Fn>
+        void parallelFor(int count, int numThreads, Fn fn)
+        {
+            std::atomic<int> next(0);
+            auto worker = [&]() {
+                for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                    fn(i);
+                }
+            };
+
+            numThreads = std::max<int>(1, std::min<int>(numThreads, count));
+            std::vector<std::thread> threads;
+            for (int t = 1; t < numThreads; ++t) {
+                threads.push_back(std::thread(worker));
+            }
+            worker();
+            for (size_t t = 0; t < threads.size(); ++t) {
+                threads[t].join();
+            }
+        }
+
+        /** Read region from source, serialized through the given mutex unless the source is thread-safe. */
+        inline bool readRegion(TileSource &src, bool threadSafe, std::mutex &m, int x, int y, int w, int h, core::Image &dst)
+        {
+            if (threadSafe)
+                return src.readRegion(x, y, w, h, dst);
+
+            std::lock_guard<std::mutex> lock(m);
+            return src.readRegion(x, y, w, h, dst);
+        }
+
+        inline int effectiveThreads(int n)
+        {
+            return n > 0 ? n : std::max<int>(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+
+        /** Start positions of tiles along one axis, the last tile is aligned to the image border. */
+        inline std::vector<int> tileStarts(int length, int tileSize, int step)
+        {
+            std::vector<int> starts;
+            if (length <= tileSize) {
+                starts.push_back(0);
+                return starts;
+            }
+
+            for (int s = 0; s + tileSize < length; s += step) {
+                starts.push_back(s);
+            }
+            starts.push_back(length - tileSize);
+            return starts;
+        }
+
+        TiledProcessor::TiledProcessor(const core::Tracker &t, const TiledParameters &params)
+        : _tracker(&t), _params(params)
+        {
+            _meanShapeRectCorners = core::shapeBounds(t.meanShape());
+        }
+
+        bool TiledProcessor::detect(TileSource &src, const TileDetector &detector, std::vector<core::Rect> &faces)
+        {
+            const int tileSize = std::max<int>(1, _params.tileSize);
+            const int step = std::max<int>(1, tileSize - std::max<int>(0, _params.tileOverlap));
+
+            const std::vector<int> xs = tileStarts(src.width(), tileSize, step);
+            const std::vector<int> ys = tileStarts(src.height(), tileSize, step);
+            const int numTiles = static_cast<int>(xs.size() * ys.size());
+
+            std::mutex readMutex;
+            const bool threadSafe = src.threadSafe();
+            std::atomic<bool> ok(true);
+            ResidentCounter resident;
+
+            // Detections per tile, so results do not depend on the order tiles complete in.
+            std::vector< std::vector<core::Rect> > tileFaces(numTiles);
+
+            parallelFor(numTiles, effectiveThreads(_params.numThreads), [&](int i) {
+                const int x = xs[i % xs.size()];
+                const int y = ys[i / xs.size()];
+                const int w = std::min<int>(tileSize, src.width() - x);
+                const int h = std::min<int>(tileSize, src.height() - y);
+
+                resident.acquire(static_cast<size_t>(w) * h);
+
+                core::Image tile;
+                const bool read = readRegion(src, threadSafe, readMutex, x, y, w, h, tile);
+
+                std::vector<core::Rect> &detections = tileFaces[i];
+                if (!read) {
+                    ok = false;
+                } else if (detector(tile, detections)) {
+                    const Eigen::Vector2f offset(static_cast<float>(x), static_cast<float>(y));
+                    for (size_t d = 0; d < detections.size(); ++d) {
+                        detections[d].colwise() += offset;
+                    }
+                } else {
+                    detections.clear();
+                }
+
+                tile.resize(0, 0);
+                resident.release(static_cast<size_t>(w) * h);
+            });
+
+            // Suppression breaks ties by order, collect detections by tile and index within tile.
+            faces.clear();
+            for (int i = 0; i < numTiles; ++i) {
+                faces.insert(faces.end(), tileFaces[i].begin(), tileFaces[i].end());
+            }
+
+            _stats.numTiles = numTiles;
+            _stats.numDetections = static_cast<int>(faces.size());
+            suppressOverlaps(faces, _params.nmsOverlap);
+            _stats.numFaces = static_cast<int>(faces.size());
+            _stats.peakResidentPixels = resident.peak.load();
+
+            return ok;
+        }
+
+        bool TiledProcessor::align(TileSource &src, const std::vector<core::Rect> &faces, std::vector<core::Shape> &shapes)
+        {
+            const int numFaces = static_cast<int>(faces.size());
+            shapes.assign(numFaces, core::Shape());
+
+            std::mutex readMutex;
+            const bool threadSafe = src.threadSafe();
+            std::atomic<bool> ok(true);
+            ResidentCounter resident;
+
+            const core::Shape &c = _meanShapeRectCorners;
+            const Eigen::Vector2f center = c.rowwise().mean();
+            const core::Shape expanded = ((c.colwise() - center) * _params.footprintScale).colwise() + center;
+
+            parallelFor(numFaces, effectiveThreads(_params.numThreads), [&](int i) {
+                const core::ShapeTransform shapeToImage = core::estimateSimilarityTransform(core::unitRectangle(), faces[i]);
+
+                // Region of image covered by pixels sampled for this face.
+                const core::Shape corners = shapeToImage * expanded.colwise().homogeneous();
+                const Eigen::Vector2f minC = corners.rowwise().minCoeff();
+                const Eigen::Vector2f maxC = corners.rowwise().maxCoeff();
+
+                const int x0 = std::max<int>(0, static_cast<int>(std::floor(minC.x())));
+                const int y0 = std::max<int>(0, static_cast<int>(std::floor(minC.y())));
+                const int x1 = std::min<int>(src.width(), static_cast<int>(std::ceil(maxC.x())) + 1);
+                const int y1 = std::min<int>(src.height(), static_cast<int>(std::ceil(maxC.y())) + 1);
+
+                if (x1 <= x0 || y1 <= y0) {
+                    shapes[i] = shapeToImage * _tracker->meanShape().colwise().homogeneous();
+                    return;
+                }
+
+                const size_t numPixels = static_cast<size_t>(x1 - x0) * (y1 - y0);
+                resident.acquire(numPixels);
+
+                core::Image region;
+                const bool read = readRegion(src, threadSafe, readMutex, x0, y0, x1 - x0, y1 - y0, region);
+
+                if (read) {
+                    const Eigen::Vector2f offset(static_cast<float>(x0), static_cast<float>(y0));
+
+                    core::ShapeTransform shapeToRegion = shapeToImage;
+                    shapeToRegion.translation() -= offset;
+
+                    shapes[i] = _tracker->predict(region, shapeToRegion).colwise() + offset;
+                } else {
+                    ok = false;
+                }
+
+                region.resize(0, 0);
+                resident.release(numPixels);
+            });
+
+            _stats.peakResidentPixels = std::max<size_t>(_stats.peakResidentPixels, resident.peak.load());
+
+            return ok;
+        }
+
+        bool TiledProcessor::process(TileSource &src, const TileDetector &detector, std::vector<core::Rect> &faces, std::vector<core::Shape> &shapes)
+        {
+            _stats = TiledStats();
+            const bool detected = detect(src, detector, faces);
+            return align(src, faces, shapes) && detected;
+        }
+
+        const TiledStats &TiledProcessor::stats() const
+        {
+            return _stats;
+        }
+
+        void TiledProcessor::suppressOverlaps(std::vector<core::Rect> &rects, float overlap)
+        {
+            struct Box {
+                Eigen::Vector2f minC, maxC;
+                float area;
+                size_t idx;
+            };
+
+            std::vector<Box> boxes(rects.size());
+            for (size_t i = 0; i < rects.size(); ++i) {
+                boxes[i].minC = rects[i].rowwise().minCoeff();
+                boxes[i].maxC = rects[i].rowwise().maxCoeff();
+                boxes[i].area = (boxes[i].maxC - boxes[i].minC).prod();
+                boxes[i].idx = i;
+            }
+
+            // Larger first, ties by original order for deterministic results.
+            std::sort(boxes.begin(), boxes.end(), [](const Box &a, const Box &b) {
+                return a.area > b.area || (a.area == b.area && a.idx < b.idx);
+            });
+
+            std::vector<Box> kept;
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                bool suppressed = false;
+                for (size_t k = 0; k < kept.size() && !suppressed; ++k) {
+                    const Eigen::Vector2f extent = (boxes[i].maxC.cwiseMin(kept[k].maxC) - boxes[i].minC.cwiseMax(kept[k].minC)).cwiseMax(Eigen::Vector2f::Zero());
+                    const float smaller = std::min<float>(boxes[i].area, kept[k].area);
+                    suppressed = smaller > 0.f && extent.prod() > overlap * smaller;
+                }
+                if (!suppressed)
+                    kept.push_back(boxes[i]);
+            }
+
+            std::vector<core::Rect> result;
+            for (size_t k = 0; k < kept.size(); ++k) {
+                result.push_back(rects[kept[k].idx]);
+            }
+            rects.swap(result);
+        }
+
+    }
+}
@@ -21,6 +21,7 @@
 #include <opencv2/opencv.hpp>
 #include <iomanip>
 #include <fstream>
+#include <chrono>
 
 namespace dest {
     namespace io {
@@ -458,6 +459,36 @@ namespace dest {
             return createPermutationMatrixForMirroredLAND();
         }
 
+        typedef std::chrono::steady_clock Clock;
+
+        inline double elapsedMs(Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        DatabaseLoadStats::DatabaseLoadStats()
+            : globMs(0), parseMs(0), decodeMs(0), scaleMs(0), mirrorMs(0), convertMs(0),
+              numCandidates(0), numLoaded(0), numPixelsDecoded(0)
+        {}
+
+        double DatabaseLoadStats::totalMs() const
+        {
+            return globMs + parseMs + decodeMs + scaleMs + mirrorMs + convertMs;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const DatabaseLoadStats &obj)
+        {
+            stream << std::setw(30) << std::left << "Glob ms" << std::setw(10) << obj.globMs << std::endl
+                   << std::setw(30) << std::left << "Parse ms" << std::setw(10) << obj.parseMs << std::endl
+                   << std::setw(30) << std::left << "Decode ms" << std::setw(10) << obj.decodeMs << std::endl
+                   << std::setw(30) << std::left << "Scale ms" << std::setw(10) << obj.scaleMs << std::endl
+                   << std::setw(30) << std::left << "Mirror ms" << std::setw(10) << obj.mirrorMs << std::endl
+                   << std::setw(30) << std::left << "Convert ms" << std::setw(10) << obj.convertMs << std::endl
+                   << std::setw(30) << std::left << "Candidates" << std::setw(10) << obj.numCandidates << std::endl
+                   << std::setw(30) << std::left << "Loaded" << std::setw(10) << obj.numLoaded << std::endl
+                   << std::setw(30) << std::left << "Pixels decoded" << std::setw(10) << obj.numPixelsDecoded << std::endl;
+            return stream;
+        }
+
         struct ShapeDatabase::data 
         {
             std::vector< std::shared_ptr<DatabaseLoader> > loaders;
@@ -466,6 +497,7 @@ namespace dest {
             int maxLoadSize, minLoadSize;
             size_t maxElementsToLoad;
             std::string type, lastType;
+            DatabaseLoadStats stats;
         };
 
         ShapeDatabase::ShapeDatabase()
@@ -526,10 +558,19 @@ namespace dest {
             return _data->lastType;
         }
 
+        const DatabaseLoadStats &ShapeDatabase::lastLoadStats() const
+        {
+            return _data->stats;
+        }
+
         bool ShapeDatabase::load(const std::string & directory, std::vector<core::Image>& images, std::vector<core::Shape>& shapes, std::vector<core::Rect>& rects, std::vector<float>* scaleFactors)
         {
+            DatabaseLoadStats &stats = _data->stats;
+            stats = DatabaseLoadStats();
+
             std::shared_ptr<DatabaseLoader> loader;
             size_t candidates = 0;
+            Clock::time_point start = Clock::now();
             if (_data->type == std::string("auto")) {
                 for (size_t i = 0; i < _data->loaders.size(); ++i) {
                     loader = _data->loaders[i];
@@ -547,6 +588,8 @@ namespace dest {
                     candidates = loader->glob(directory);
                 }
             }
+            stats.globMs = elapsedMs(start);
+            stats.numCandidates = candidates;
 
             if (candidates == 0) {
                 DEST_LOG("Could not find any loadable items.");
@@ -578,8 +621,14 @@ namespace dest {
                 core::Shape s;
                 core::Rect r;
                 
+                start = Clock::now();
                 bool imageOk = loader->loadImage(i, img);
-                bool shapeOk = loader->loadShape(i, img.size(), s);                
+                stats.decodeMs += elapsedMs(start);
+                stats.numPixelsDecoded += img.total();
+
+                start = Clock::now();
+                bool shapeOk = loader->loadShape(i, img.size(), s);
+                stats.parseMs += elapsedMs(start);
                 bool rectOk = loadedRects.empty() || !loadedRects[i].isZero();
 
                 if (!shapeOk || !imageOk || !rectOk)
@@ -589,11 +638,15 @@ namespace dest {
 
                 float f;
                 if (imageNeedsScaling(img.size(), _data->maxLoadSize, _data->minLoadSize, f)) {
+                    start = Clock::now();
                     scaleImageShapeAndRect(img, s, r, f);
+                    stats.scaleMs += elapsedMs(start);
                 }
 
+                start = Clock::now();
                 core::Image destImg;
                 util::toDest(img, destImg);
+                stats.convertMs += elapsedMs(start);
 
                 images.push_back(destImg);
                 shapes.push_back(s);
@@ -604,11 +657,15 @@ namespace dest {
                 }
 
                 if (_data->mirror && permutShape.size() > 0) {
+                    start = Clock::now();
                     cv::Mat cvFlipped = img.clone();
                     mirrorImageShapeAndRectVertically(cvFlipped, s, r, permutShape, permutRect);
+                    stats.mirrorMs += elapsedMs(start);
 
+                    start = Clock::now();
                     core::Image destImgFlipped;
                     util::toDest(cvFlipped, destImgFlipped);
+                    stats.convertMs += elapsedMs(start);
 
                     images.push_back(destImgFlipped);
                     shapes.push_back(s);
@@ -621,6 +678,7 @@ namespace dest {
 
             }
 
+            stats.numLoaded = shapes.size() - initialSize;
             DEST_LOG("Successfully loaded " << (shapes.size() - initialSize) << " entries from database." << std::endl);
             return (shapes.size() - initialSize) > 0;
         }
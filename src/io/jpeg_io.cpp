@@ -0,0 +1,409 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/config.h>
+#ifdef DEST_WITH_JPEG
+
+#include <dest/io/jpeg_io.h>
+#include <dest/util/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+namespace dest {
+    namespace io {
+
+        /**
+            Error manager returning control to the caller instead of terminating.
+
+            Functions establishing the jump target must not hold objects with non-trivial
+            destructors, since longjmp bypasses them.
+        */
+        struct JpegErrorManager {
+            jpeg_error_mgr pub;
+            std::jmp_buf jump;
+            bool truncated;
+        };
+
+        void jpegErrorExit(j_common_ptr cinfo)
+        {
+            JpegErrorManager *err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+
+            char msg[JMSG_LENGTH_MAX];
+            (*cinfo->err->format_message)(cinfo, msg);
+            DEST_LOG("JPEG error: " << msg << std::endl);
+
+            std::longjmp(err->jump, 1);
+        }
+
+        void jpegEmitMessage(j_common_ptr cinfo, int msgLevel)
+        {
+            // Warnings on corrupt data are tolerated, but missing data would be padded silently.
+            JpegErrorManager *err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+            if (msgLevel < 0 && cinfo->err->msg_code == JWRN_JPEG_EOF)
+                err->truncated = true;
+        }
+
+        inline void setupErrorManager(JpegErrorManager &err)
+        {
+            jpeg_std_error(&err.pub);
+            err.pub.error_exit = jpegErrorExit;
+            err.pub.emit_message = jpegEmitMessage;
+            err.truncated = false;
+        }
+
+        /** Destination manager writing to a growing vector. */
+        struct JpegVectorDestination {
+            jpeg_destination_mgr pub;
+            std::vector<unsigned char> *data;
+        };
+
+        void jpegInitDestination(j_compress_ptr cinfo)
+        {
+            JpegVectorDestination *dst = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+            dst->data->resize(4096);
+            dst->pub.next_output_byte = dst->data->data();
+            dst->pub.free_in_buffer = dst->data->size();
+        }
+
+        boolean jpegEmptyOutputBuffer(j_compress_ptr cinfo)
+        {
+            JpegVectorDestination *dst = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+            const size_t n = dst->data->size();
+            dst->data->resize(n * 2);
+            dst->pub.next_output_byte = dst->data->data() + n;
+            dst->pub.free_in_buffer = n;
+            return TRUE;
+        }
+
+        void jpegTermDestination(j_compress_ptr cinfo)
+        {
+            JpegVectorDestination *dst = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+            dst->data->resize(dst->data->size() - dst->pub.free_in_buffer);
+        }
+
+        inline bool validScaleDenom(int s)
+        {
+            return s == 1 || s == 2 || s == 4 || s == 8;
+        }
+
+        inline bool readFile(const std::string &path, std::vector<unsigned char> &data)
+        {
+            std::ifstream ifs(path.c_str(), std::ios::binary);
+            if (!ifs.is_open())
+                return false;
+
+            data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            return !data.empty();
+        }
+
+        JpegRegion::JpegRegion()
+        : x(0), y(0), scaleDenom(1), imageWidth(0), imageHeight(0)
+        {}
+
+        core::ShapeTransform JpegRegion::imageToRegion() const
+        {
+            const float s = static_cast<float>(scaleDenom);
+
+            core::ShapeTransform t;
+            t.linear() = Eigen::Matrix2f::Identity() / s;
+            t.translation() = -Eigen::Vector2f(x + 0.5f * (s - 1.f), y + 0.5f * (s - 1.f)) / s;
+            return t;
+        }
+
+        bool readJpegSize(const unsigned char *data, size_t size, int &width, int &height)
+        {
+            jpeg_decompress_struct cinfo;
+            JpegErrorManager err;
+            setupErrorManager(err);
+            cinfo.err = &err.pub;
+
+            if (setjmp(err.jump)) {
+                jpeg_destroy_decompress(&cinfo);
+                return false;
+            }
+
+            jpeg_create_decompress(&cinfo);
+            jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), static_cast<unsigned long>(size));
+            jpeg_read_header(&cinfo, TRUE);
+
+            width = static_cast<int>(cinfo.image_width);
+            height = static_cast<int>(cinfo.image_height);
+
+            jpeg_destroy_decompress(&cinfo);
+            return true;
+        }
+
+        bool decodeJpegRegion(const unsigned char *data, size_t size, int x, int y, int w, int h, int scaleDenom, JpegRegion &region)
+        {
+            if (!validScaleDenom(scaleDenom))
+                return false;
+
+            jpeg_decompress_struct cinfo;
+            JpegErrorManager err;
+            setupErrorManager(err);
+            cinfo.err = &err.pub;
+
+            if (setjmp(err.jump)) {
+                jpeg_destroy_decompress(&cinfo);
+                return false;
+            }
+
+            jpeg_create_decompress(&cinfo);
+            jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), static_cast<unsigned long>(size));
+            jpeg_read_header(&cinfo, TRUE);
+
+            // Luminance only, chroma components skip inverse DCT and upsampling.
+            cinfo.out_color_space = JCS_GRAYSCALE;
+            cinfo.scale_num = 1;
+            cinfo.scale_denom = static_cast<unsigned int>(scaleDenom);
+
+            jpeg_start_decompress(&cinfo);
+
+            const int imgW = static_cast<int>(cinfo.image_width);
+            const int imgH = static_cast<int>(cinfo.image_height);
+            const int outW = static_cast<int>(cinfo.output_width);
+            const int outH = static_cast<int>(cinfo.output_height);
+
+            // Region in scaled pixels.
+            const int x0 = std::max<int>(0, x) / scaleDenom;
+            const int y0 = std::max<int>(0, y) / scaleDenom;
+            const int x1 = std::min<int>(outW, (std::min<int>(imgW, x + w) + scaleDenom - 1) / scaleDenom);
+            const int y1 = std::min<int>(outH, (std::min<int>(imgH, y + h) + scaleDenom - 1) / scaleDenom);
+
+            if (x1 <= x0 || y1 <= y0) {
+                jpeg_destroy_decompress(&cinfo);
+                return false;
+            }
+
+            // Cropping widens the scanline to iMCU boundaries.
+            JDIMENSION cropX = static_cast<JDIMENSION>(x0);
+            JDIMENSION cropW = static_cast<JDIMENSION>(x1 - x0);
+            jpeg_crop_scanline(&cinfo, &cropX, &cropW);
+
+            if (y0 > 0)
+                jpeg_skip_scanlines(&cinfo, static_cast<JDIMENSION>(y0));
+
+            region.x = x0 * scaleDenom;
+            region.y = y0 * scaleDenom;
+            region.scaleDenom = scaleDenom;
+            region.imageWidth = imgW;
+            region.imageHeight = imgH;
+            region.image.resize(y1 - y0, x1 - x0);
+
+            JSAMPARRAY row = (*cinfo.mem->alloc_sarray)(reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, cropW, 1);
+            const int offset = x0 - static_cast<int>(cropX);
+            for (int r = y0; r < y1; ++r) {
+                jpeg_read_scanlines(&cinfo, row, 1);
+                std::memcpy(region.image.row(r - y0).data(), row[0] + offset, static_cast<size_t>(x1 - x0));
+            }
+
+            // Rows below the region are never decoded.
+            jpeg_destroy_decompress(&cinfo);
+            return !err.truncated;
+        }
+
+        bool decodeJpegRegion(const std::string &path, int x, int y, int w, int h, int scaleDenom, JpegRegion &region)
+        {
+            std::vector<unsigned char> data;
+            if (!readFile(path, data))
+                return false;
+
+            return decodeJpegRegion(data.data(), data.size(), x, y, w, h, scaleDenom, region);
+        }
+
+        JpegTileSource::JpegTileSource()
+        : _width(0), _height(0)
+        {}
+
+        bool JpegTileSource::open(const unsigned char *data, size_t size)
+        {
+            _data.assign(data, data + size);
+            if (!readJpegSize(_data.data(), _data.size(), _width, _height)) {
+                _data.clear();
+                _width = _height = 0;
+                return false;
+            }
+            return true;
+        }
+
+        bool JpegTileSource::open(const std::string &path)
+        {
+            std::vector<unsigned char> data;
+            if (!readFile(path, data))
+                return false;
+
+            return open(data.data(), data.size());
+        }
+
+        int JpegTileSource::width() const
+        {
+            return _width;
+        }
+
+        int JpegTileSource::height() const
+        {
+            return _height;
+        }
+
+        bool JpegTileSource::readRegion(int x, int y, int w, int h, core::Image &dst)
+        {
+            JpegRegion r;
+            if (!decodeJpegRegion(_data.data(), _data.size(), x, y, w, h, 1, r))
+                return false;
+
+            dst.swap(r.image);
+            return dst.rows() == h && dst.cols() == w;
+        }
+
+        bool JpegTileSource::threadSafe() const
+        {
+            // Each read decodes with its own decompressor from the immutable compressed data.
+            return true;
+        }
+
+        bool encodeJpeg(const Eigen::Ref<const core::Image> &img, int quality, std::vector<unsigned char> &data)
+        {
+            if (img.size() == 0)
+                return false;
+
+            jpeg_compress_struct cinfo;
+            JpegErrorManager err;
+            setupErrorManager(err);
+            cinfo.err = &err.pub;
+
+            if (setjmp(err.jump)) {
+                jpeg_destroy_compress(&cinfo);
+                return false;
+            }
+
+            jpeg_create_compress(&cinfo);
+
+            JpegVectorDestination *dst = reinterpret_cast<JpegVectorDestination*>(
+                (*cinfo.mem->alloc_small)(reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_PERMANENT, sizeof(JpegVectorDestination)));
+            dst->pub.init_destination = jpegInitDestination;
+            dst->pub.empty_output_buffer = jpegEmptyOutputBuffer;
+            dst->pub.term_destination = jpegTermDestination;
+            dst->data = &data;
+            cinfo.dest = &dst->pub;
+
+            cinfo.image_width = static_cast<JDIMENSION>(img.cols());
+            cinfo.image_height = static_cast<JDIMENSION>(img.rows());
+            cinfo.input_components = 1;
+            cinfo.in_color_space = JCS_GRAYSCALE;
+            jpeg_set_defaults(&cinfo);
+            jpeg_set_quality(&cinfo, std::max<int>(1, std::min<int>(100, quality)), TRUE);
+
+            jpeg_start_compress(&cinfo, TRUE);
+            while (cinfo.next_scanline < cinfo.image_height) {
+                JSAMPROW row = const_cast<JSAMPROW>(img.row(cinfo.next_scanline).data());
+                jpeg_write_scanlines(&cinfo, &row, 1);
+            }
+            jpeg_finish_compress(&cinfo);
+
+            jpeg_destroy_compress(&cinfo);
+            return true;
+        }
+
+        JpegRealignParameters::JpegRealignParameters()
+        {
+            footprintScale = 2.f;
+            scaleDenom = 1;
+            minFaceSize = 128;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const JpegRealignParameters &obj) {
+            stream << std::setw(30) << std::left << "Footprint scale" << std::setw(10) << obj.footprintScale << std::endl
+                   << std::setw(30) << std::left << "Scale denominator" << std::setw(10) << obj.scaleDenom << std::endl
+                   << std::setw(30) << std::left << "Minimum face size" << std::setw(10) << obj.minFaceSize;
+            return stream;
+        }
+
+        bool decodeJpegFootprint(const core::Tracker &t, const unsigned char *data, size_t size, const core::Rect &rect,
+                                 const JpegRealignParameters &params, JpegRegion &region, core::ShapeTransform &shapeToRegion)
+        {
+            const core::ShapeTransform shapeToImage = core::estimateSimilarityTransform(core::unitRectangle(), rect);
+
+            int scaleDenom = params.scaleDenom;
+            if (scaleDenom == 0) {
+                const float faceSize = (rect.rowwise().maxCoeff() - rect.rowwise().minCoeff()).minCoeff();
+                scaleDenom = 8;
+                while (scaleDenom > 1 && faceSize / scaleDenom < params.minFaceSize)
+                    scaleDenom /= 2;
+            }
+
+            // Region of image covered by pixels sampled for this face.
+            const core::Shape c = core::shapeBounds(t.meanShape());
+            const Eigen::Vector2f center = c.rowwise().mean();
+            const core::Shape expanded = ((c.colwise() - center) * params.footprintScale).colwise() + center;
+            const core::Shape corners = shapeToImage * expanded.colwise().homogeneous();
+            const Eigen::Vector2f minC = corners.rowwise().minCoeff();
+            const Eigen::Vector2f maxC = corners.rowwise().maxCoeff();
+
+            const int x0 = static_cast<int>(std::floor(minC.x()));
+            const int y0 = static_cast<int>(std::floor(minC.y()));
+            const int x1 = static_cast<int>(std::ceil(maxC.x())) + 1;
+            const int y1 = static_cast<int>(std::ceil(maxC.y())) + 1;
+
+            if (!decodeJpegRegion(data, size, x0, y0, x1 - x0, y1 - y0, scaleDenom, region))
+                return false;
+
+            shapeToRegion = region.imageToRegion() * shapeToImage;
+            return true;
+        }
+
+        bool decodeJpegFootprint(const core::Tracker &t, const std::string &path, const core::Rect &rect,
+                                 const JpegRealignParameters &params, JpegRegion &region, core::ShapeTransform &shapeToRegion)
+        {
+            std::vector<unsigned char> data;
+            if (!readFile(path, data))
+                return false;
+
+            return decodeJpegFootprint(t, data.data(), data.size(), rect, params, region, shapeToRegion);
+        }
+
+        bool realignJpeg(const core::Tracker &t, const unsigned char *data, size_t size, const core::Rect &rect,
+                         const JpegRealignParameters &params, core::Shape &shape, JpegRegion *region)
+        {
+            JpegRegion r;
+            core::ShapeTransform shapeToRegion;
+            if (!decodeJpegFootprint(t, data, size, rect, params, r, shapeToRegion))
+                return false;
+
+            shape = r.imageToRegion().inverse() * t.predict(r.image, shapeToRegion).colwise().homogeneous();
+
+            if (region)
+                *region = r;
+
+            return true;
+        }
+
+        bool realignJpeg(const core::Tracker &t, const std::string &path, const core::Rect &rect,
+                         const JpegRealignParameters &params, core::Shape &shape, JpegRegion *region)
+        {
+            std::vector<unsigned char> data;
+            if (!readFile(path, data))
+                return false;
+
+            return realignJpeg(t, data.data(), data.size(), rect, params, shape, region);
+        }
+
+    }
+}
+
+#endif
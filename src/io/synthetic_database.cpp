@@ -0,0 +1,207 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/config.h>
+#ifdef DEST_WITH_OPENCV
+
+#include <dest/io/synthetic_database.h>
+#include <dest/util/synthetic.h>
+#include <dest/util/convert.h>
+#include <dest/util/log.h>
+#include <opencv2/opencv.hpp>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+
+namespace dest {
+    namespace io {
+
+        SyntheticDatabaseParameters::SyntheticDatabaseParameters()
+        {
+            format = "ibug";
+            imageExtension = "jpg";
+            numImages = 100;
+            imageSize = 512;
+            seed = 10;
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const SyntheticDatabaseParameters &obj)
+        {
+            stream << std::setw(30) << std::left << "Format" << std::setw(10) << obj.format << std::endl
+                   << std::setw(30) << std::left << "Image extension" << std::setw(10) << obj.imageExtension << std::endl
+                   << std::setw(30) << std::left << "Number of images" << std::setw(10) << obj.numImages << std::endl
+                   << std::setw(30) << std::left << "Image size" << std::setw(10) << obj.imageSize << std::endl
+                   << std::setw(30) << std::left << "Seed" << std::setw(10) << obj.seed << std::endl;
+            return stream;
+        }
+
+        int syntheticDatabaseLandmarkCount(const std::string &format)
+        {
+            if (format == "imm")
+                return 58;
+            else if (format == "ibug")
+                return 68;
+            else if (format == "land")
+                return 74;
+            else
+                return 0;
+        }
+
+        bool syntheticDatabaseSupportsImageExtension(const std::string &extension)
+        {
+            // Extensions tried by DatabaseLoader::loadImageFromFilePrefix.
+            return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "bmp";
+        }
+
+        /** Linearly resample landmarks along the landmark sequence. */
+        inline core::Shape resampleLandmarks(const core::Shape &s, int count)
+        {
+            core::Shape r(2, count);
+            const float step = static_cast<float>(s.cols() - 1) / static_cast<float>(std::max<int>(count - 1, 1));
+
+            for (int i = 0; i < count; ++i) {
+                const float t = i * step;
+                const int i0 = std::min<int>(static_cast<int>(t), static_cast<int>(s.cols()) - 1);
+                const int i1 = std::min<int>(i0 + 1, static_cast<int>(s.cols()) - 1);
+                const float w = t - i0;
+                r.col(i) = (1.f - w) * s.col(i0) + w * s.col(i1);
+            }
+
+            return r;
+        }
+
+        inline bool writeShapeIMM(const std::string &path, const core::Shape &s, int width, int height)
+        {
+            std::ofstream ofs(path.c_str());
+            if (!ofs.is_open())
+                return false;
+
+            ofs << "# Synthetic DEST database" << std::endl
+                << "#" << std::endl
+                << s.cols() << std::endl
+                << "#" << std::endl
+                << "# path type x y point from to" << std::endl;
+
+            const int n = static_cast<int>(s.cols());
+            for (int i = 0; i < n; ++i) {
+                ofs << "0 \t0 \t" << std::fixed << std::setprecision(6)
+                    << s(0, i) / width << "\t" << s(1, i) / height << "\t"
+                    << i << " \t" << (i + n - 1) % n << " \t" << (i + 1) % n << std::endl;
+            }
+
+            // Image file name is omitted, the loader only skips names of jpg images.
+
+            return ofs.good();
+        }
+
+        inline bool writeShapeIBug(const std::string &path, const core::Shape &s)
+        {
+            std::ofstream ofs(path.c_str());
+            if (!ofs.is_open())
+                return false;
+
+            ofs << "version: 1" << std::endl
+                << "n_points:  " << s.cols() << std::endl
+                << "{" << std::endl;
+
+            for (core::Shape::Index i = 0; i < s.cols(); ++i) {
+                // C++ to Matlab offset
+                ofs << std::fixed << std::setprecision(3) << s(0, i) + 1.f << " " << s(1, i) + 1.f << std::endl;
+            }
+
+            ofs << "}" << std::endl;
+
+            return ofs.good();
+        }
+
+        inline bool writeShapeLAND(const std::string &path, const core::Shape &s, int height)
+        {
+            std::ofstream ofs(path.c_str());
+            if (!ofs.is_open())
+                return false;
+
+            ofs << s.cols() << std::endl;
+
+            for (core::Shape::Index i = 0; i < s.cols(); ++i) {
+                // Origin at bottom left
+                ofs << std::fixed << std::setprecision(3) << s(0, i) << " " << height - s(1, i) - 1.f << std::endl;
+            }
+
+            return ofs.good();
+        }
+
+        bool writeSyntheticDatabase(const std::string &directory, const SyntheticDatabaseParameters &params, std::vector<std::string> *files)
+        {
+            const int numLandmarks = syntheticDatabaseLandmarkCount(params.format);
+            if (numLandmarks == 0) {
+                DEST_LOG("Unknown database format " << params.format << std::endl);
+                return false;
+            }
+
+            if (!syntheticDatabaseSupportsImageExtension(params.imageExtension)) {
+                DEST_LOG("Image extension " << params.imageExtension << " is not found by database loaders" << std::endl);
+                return false;
+            }
+
+            std::mt19937 rnd(params.seed);
+
+            for (int i = 0; i < params.numImages; ++i) {
+                // Generate one image at a time to keep memory bounded for large databases.
+                core::InputData input;
+                util::createSyntheticInputData(1, params.imageSize, rnd, input);
+
+                const core::Shape s = resampleLandmarks(input.shapes.front(), numLandmarks);
+
+                std::ostringstream name;
+                name << "synthetic_" << std::setw(6) << std::setfill('0') << i;
+
+                const std::string prefix = directory + "/" + name.str();
+                const std::string imagePath = prefix + "." + params.imageExtension;
+
+                cv::Mat img;
+                util::toCV(input.images.front(), img);
+                if (!cv::imwrite(imagePath, img)) {
+                    DEST_LOG("Failed to write image " << imagePath << std::endl);
+                    return false;
+                }
+
+                std::string shapePath;
+                bool shapeOk = false;
+                if (params.format == "imm") {
+                    shapePath = prefix + ".asf";
+                    shapeOk = writeShapeIMM(shapePath, s, img.cols, img.rows);
+                } else if (params.format == "ibug") {
+                    shapePath = prefix + ".pts";
+                    shapeOk = writeShapeIBug(shapePath, s);
+                } else {
+                    shapePath = prefix + ".land";
+                    shapeOk = writeShapeLAND(shapePath, s, img.rows);
+                }
+
+                if (!shapeOk) {
+                    DEST_LOG("Failed to write annotation " << shapePath << std::endl);
+                    return false;
+                }
+
+                if (files) {
+                    files->push_back(imagePath);
+                    files->push_back(shapePath);
+                }
+            }
+
+            return true;
+        }
+
+    }
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/util/cpu.h>
+#include <dest/core/config.h>
+#include <dest/util/log.h>
+#include <atomic>
+#include <cstdlib>
+
+#ifdef DEST_WITH_ISA_DISPATCH
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #include <immintrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+namespace dest {
+    namespace util {
+
+#ifdef DEST_WITH_ISA_DISPATCH
+
+        inline void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; ++i)
+                regs[i] = static_cast<unsigned int>(r[i]);
+#else
+            if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+                regs[0] = regs[1] = regs[2] = regs[3] = 0;
+            }
+#endif
+        }
+
+        inline unsigned long long xgetbv() {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned int eax, edx;
+            __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+        }
+
+        InstructionSet detectInstructionSet()
+        {
+            unsigned int r1[4], r7[4];
+            cpuid(0, 0, r1);
+            const unsigned int maxLeaf = r1[0];
+
+            cpuid(1, 0, r1);
+            if (maxLeaf >= 7) {
+                cpuid(7, 0, r7);
+            } else {
+                r7[0] = r7[1] = r7[2] = r7[3] = 0;
+            }
+
+            const bool sse2 = (r1[3] & (1u << 26)) != 0;
+            if (!sse2)
+                return ISA_GENERIC;
+
+            // Wider registers require the OS to save their state on context switches.
+            const bool osxsave = (r1[2] & (1u << 27)) != 0;
+            const bool avx = (r1[2] & (1u << 28)) != 0;
+            const unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+
+            const bool osYmm = (xcr0 & 0x6) == 0x6;
+            const bool osZmm = (xcr0 & 0xE6) == 0xE6;
+
+            const bool avx2 = avx && osYmm && (r7[1] & (1u << 5)) != 0;
+            const bool avx512 = avx2 && osZmm && (r7[1] & (1u << 16)) != 0;
+
+            if (avx512)
+                return ISA_AVX512;
+            else if (avx2)
+                return ISA_AVX2;
+            else
+                return ISA_SSE2;
+        }
+
+#else
+
+        InstructionSet detectInstructionSet()
+        {
+            return ISA_GENERIC;
+        }
+
+#endif
+
+        inline InstructionSet initialInstructionSet() {
+            InstructionSet isa = detectInstructionSet();
+
+            const char *env = std::getenv("DEST_ISA");
+            InstructionSet requested;
+            if (env && parseInstructionSet(env, requested)) {
+                if (requested > isa) {
+                    DEST_LOG("Requested instruction set " << env << " not supported, using " << instructionSetName(isa) << std::endl);
+                } else {
+                    isa = requested;
+                }
+            }
+
+            return isa;
+        }
+
+        inline std::atomic<int> &activeLevel() {
+            static std::atomic<int> _level(static_cast<int>(initialInstructionSet()));
+            return _level;
+        }
+
+        InstructionSet activeInstructionSet()
+        {
+            return static_cast<InstructionSet>(activeLevel().load(std::memory_order_relaxed));
+        }
+
+        bool setActiveInstructionSet(InstructionSet isa)
+        {
+            if (isa < ISA_GENERIC || isa > detectInstructionSet())
+                return false;
+
+            activeLevel().store(static_cast<int>(isa));
+            return true;
+        }
+
+        const char *instructionSetName(InstructionSet isa)
+        {
+            switch (isa) {
+            case ISA_SSE2: return "sse2";
+            case ISA_AVX2: return "avx2";
+            case ISA_AVX512: return "avx512";
+            default: return "generic";
+            }
+        }
+
+        bool parseInstructionSet(const std::string &name, InstructionSet &isa)
+        {
+            const InstructionSet all[] = { ISA_GENERIC, ISA_SSE2, ISA_AVX2, ISA_AVX512 };
+            for (int i = 0; i < 4; ++i) {
+                if (name == instructionSetName(all[i])) {
+                    isa = all[i];
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/util/hash.h>
+#include <cstring>
+
+namespace dest {
+    namespace util {
+
+        static const uint64_t Prime1 = 11400714785074694791ULL;
+        static const uint64_t Prime2 = 14029467366897019727ULL;
+        static const uint64_t Prime3 = 1609587929392839161ULL;
+        static const uint64_t Prime4 = 9650029242287828579ULL;
+        static const uint64_t Prime5 = 2870177450012600261ULL;
+
+        inline uint64_t rotl(uint64_t x, int r) {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        // Unaligned little endian loads. Byte order only affects hash values, not their quality.
+        inline uint64_t read64(const unsigned char *p) {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint32_t read32(const unsigned char *p) {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t round(uint64_t acc, uint64_t input) {
+            acc += input * Prime2;
+            acc = rotl(acc, 31);
+            return acc * Prime1;
+        }
+
+        inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+            acc ^= round(0, val);
+            return acc * Prime1 + Prime4;
+        }
+
+        uint64_t hashBytes(const void *data, size_t len, uint64_t seed)
+        {
+            const unsigned char *p = static_cast<const unsigned char*>(data);
+            const unsigned char *end = p + len;
+            uint64_t h;
+
+            if (len >= 32) {
+                const unsigned char *limit = end - 32;
+                uint64_t v1 = seed + Prime1 + Prime2;
+                uint64_t v2 = seed + Prime2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed - Prime1;
+
+                do {
+                    v1 = round(v1, read64(p)); p += 8;
+                    v2 = round(v2, read64(p)); p += 8;
+                    v3 = round(v3, read64(p)); p += 8;
+                    v4 = round(v4, read64(p)); p += 8;
+                } while (p <= limit);
+
+                h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+                h = mergeRound(h, v1);
+                h = mergeRound(h, v2);
+                h = mergeRound(h, v3);
+                h = mergeRound(h, v4);
+            } else {
+                h = seed + Prime5;
+            }
+
+            h += static_cast<uint64_t>(len);
+
+            while (p + 8 <= end) {
+                h ^= round(0, read64(p));
+                h = rotl(h, 27) * Prime1 + Prime4;
+                p += 8;
+            }
+
+            if (p + 4 <= end) {
+                h ^= static_cast<uint64_t>(read32(p)) * Prime1;
+                h = rotl(h, 23) * Prime2 + Prime3;
+                p += 4;
+            }
+
+            while (p < end) {
+                h ^= static_cast<uint64_t>(*p) * Prime5;
+                h = rotl(h, 11) * Prime1;
+                ++p;
+            }
+
+            h ^= h >> 33;
+            h *= Prime2;
+            h ^= h >> 29;
+            h *= Prime3;
+            h ^= h >> 32;
+            return h;
+        }
+
+    }
+}
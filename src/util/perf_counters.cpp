@@ -0,0 +1,335 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/util/perf_counters.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #define DEST_HAS_PERF_EVENT
+#endif
+
+namespace dest {
+    namespace util {
+
+        /** Raw values read from a counter group: event counts, followed by time enabled and time running. */
+        enum { NumRawValues = PERF_NUM_EVENTS + 2 };
+
+#ifdef DEST_HAS_PERF_EVENT
+
+        /** Counters of a single thread. Events are opened as a group so they are read consistently. */
+        struct CounterGroup {
+            int fds[PERF_NUM_EVENTS];
+            int order[PERF_NUM_EVENTS];
+            int numOpen;
+            bool initialized;
+
+            CounterGroup()
+            : numOpen(0), initialized(false)
+            {
+                for (int i = 0; i < PERF_NUM_EVENTS; ++i)
+                    fds[i] = -1;
+            }
+
+            ~CounterGroup() {
+                for (int i = 0; i < PERF_NUM_EVENTS; ++i) {
+                    if (fds[i] >= 0)
+                        close(fds[i]);
+                }
+            }
+
+            static void eventConfig(int e, perf_event_attr &attr) {
+                switch (e) {
+                case PERF_CYCLES:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case PERF_INSTRUCTIONS:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case PERF_L1D_MISSES:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = PERF_COUNT_HW_CACHE_L1D |
+                                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+                case PERF_LLC_MISSES:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                    break;
+                default:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                    break;
+                }
+            }
+
+            void open() {
+                initialized = true;
+
+                int leader = -1;
+                for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    eventConfig(e, attr);
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                    // Events not supported by the PMU are skipped, the remaining ones are still counted.
+                    const int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+                    if (fd < 0)
+                        continue;
+
+                    fds[e] = fd;
+                    order[numOpen++] = e;
+                    if (leader < 0)
+                        leader = fd;
+                }
+            }
+
+            bool read(uint64_t *raw) {
+                if (!initialized)
+                    open();
+                if (numOpen == 0)
+                    return false;
+
+                uint64_t buf[3 + PERF_NUM_EVENTS];
+                const ssize_t expected = static_cast<ssize_t>((3 + numOpen) * sizeof(uint64_t));
+                if (::read(fds[order[0]], buf, sizeof(buf)) != expected)
+                    return false;
+
+                for (int i = 0; i < PERF_NUM_EVENTS; ++i)
+                    raw[i] = 0;
+                for (int i = 0; i < numOpen; ++i)
+                    raw[order[i]] = buf[3 + i];
+                raw[PERF_NUM_EVENTS + 0] = buf[1];
+                raw[PERF_NUM_EVENTS + 1] = buf[2];
+                return true;
+            }
+
+            bool opened(int e) const {
+                return fds[e] >= 0;
+            }
+        };
+
+        inline CounterGroup &threadCounters() {
+            static thread_local CounterGroup group;
+            return group;
+        }
+
+#endif
+
+        /** Statistics of a phase, accumulated atomically across threads. */
+        struct PhaseAccumulator {
+            std::atomic<uint64_t> numScopes;
+            std::atomic<uint64_t> nanoseconds;
+            std::atomic<uint64_t> counts[PERF_NUM_EVENTS];
+            std::atomic<unsigned int> validMask;
+        };
+
+        inline PhaseAccumulator *accumulators() {
+            static PhaseAccumulator _acc[PERF_NUM_PHASES];
+            return _acc;
+        }
+
+        inline std::atomic<bool> &enabledFlag() {
+            static std::atomic<bool> _enabled(std::getenv("DEST_PERF_COUNTERS") != 0 && std::atoi(std::getenv("DEST_PERF_COUNTERS")) != 0);
+            return _enabled;
+        }
+
+        inline int &scopeDepth() {
+            static thread_local int depth = 0;
+            return depth;
+        }
+
+        PerfStats::PerfStats()
+        : numScopes(0), milliseconds(0.0)
+        {
+            for (int i = 0; i < PERF_NUM_EVENTS; ++i) {
+                counts[i] = 0;
+                valid[i] = false;
+            }
+        }
+
+        double PerfStats::instructionsPerCycle() const
+        {
+            if (!valid[PERF_CYCLES] || !valid[PERF_INSTRUCTIONS] || counts[PERF_CYCLES] == 0)
+                return 0.0;
+            return static_cast<double>(counts[PERF_INSTRUCTIONS]) / static_cast<double>(counts[PERF_CYCLES]);
+        }
+
+        double PerfStats::perScope(PerfEvent e) const
+        {
+            if (!valid[e] || numScopes == 0)
+                return 0.0;
+            return static_cast<double>(counts[e]) / static_cast<double>(numScopes);
+        }
+
+        std::ostream& operator<<(std::ostream &stream, const PerfStats &obj)
+        {
+            stream << std::setw(30) << std::left << "Scopes" << std::setw(10) << obj.numScopes << std::endl
+                   << std::setw(30) << std::left << "Milliseconds" << std::setw(10) << obj.milliseconds << std::endl;
+
+            for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+                stream << std::setw(30) << std::left << perfEventName(static_cast<PerfEvent>(e));
+                if (obj.valid[e]) {
+                    stream << std::setw(10) << obj.counts[e];
+                } else {
+                    stream << std::setw(10) << "n/a";
+                }
+                stream << std::endl;
+            }
+
+            if (obj.valid[PERF_CYCLES] && obj.valid[PERF_INSTRUCTIONS]) {
+                stream << std::setw(30) << std::left << "Instructions per cycle" << std::setw(10) << obj.instructionsPerCycle() << std::endl;
+            }
+
+            return stream;
+        }
+
+        bool perfCountersAvailable()
+        {
+#ifdef DEST_HAS_PERF_EVENT
+            uint64_t raw[NumRawValues];
+            return threadCounters().read(raw);
+#else
+            return false;
+#endif
+        }
+
+        void setPerfCountersEnabled(bool enabled)
+        {
+            enabledFlag().store(enabled);
+        }
+
+        bool perfCountersEnabled()
+        {
+            return enabledFlag().load(std::memory_order_relaxed);
+        }
+
+        PerfStats perfStats(PerfPhase phase)
+        {
+            const PhaseAccumulator &acc = accumulators()[phase];
+
+            PerfStats s;
+            s.numScopes = acc.numScopes.load();
+            s.milliseconds = static_cast<double>(acc.nanoseconds.load()) * 1e-6;
+
+            const unsigned int mask = acc.validMask.load();
+            for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+                s.valid[e] = (mask & (1u << e)) != 0;
+                s.counts[e] = acc.counts[e].load();
+            }
+            return s;
+        }
+
+        void resetPerfStats()
+        {
+            PhaseAccumulator *acc = accumulators();
+            for (int p = 0; p < PERF_NUM_PHASES; ++p) {
+                acc[p].numScopes.store(0);
+                acc[p].nanoseconds.store(0);
+                acc[p].validMask.store(0);
+                for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+                    acc[p].counts[e].store(0);
+            }
+        }
+
+        const char *perfEventName(PerfEvent e)
+        {
+            switch (e) {
+            case PERF_CYCLES: return "Cycles";
+            case PERF_INSTRUCTIONS: return "Instructions";
+            case PERF_L1D_MISSES: return "L1D read misses";
+            case PERF_LLC_MISSES: return "LLC misses";
+            case PERF_BRANCH_MISSES: return "Branch misses";
+            default: return "Unknown";
+            }
+        }
+
+        const char *perfPhaseName(PerfPhase p)
+        {
+            switch (p) {
+            case PERF_PHASE_PREDICT: return "predict";
+            case PERF_PHASE_FIT: return "fit";
+            default: return "unknown";
+            }
+        }
+
+        PerfScope::PerfScope(PerfPhase phase)
+        : _phase(phase), _active(false), _outermost(false)
+        {
+            if (perfCountersEnabled()) {
+                _active = true;
+                _outermost = (scopeDepth()++ == 0);
+                if (_outermost)
+                    begin();
+            }
+        }
+
+        PerfScope::~PerfScope()
+        {
+            if (_active) {
+                if (_outermost)
+                    end();
+                --scopeDepth();
+            }
+        }
+
+        void PerfScope::begin()
+        {
+            _start[PERF_NUM_EVENTS] = 0;
+            _start[PERF_NUM_EVENTS + 1] = 0;
+#ifdef DEST_HAS_PERF_EVENT
+            threadCounters().read(_start);
+#endif
+            _startTime = std::chrono::steady_clock::now();
+        }
+
+        void PerfScope::end()
+        {
+            const std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+
+            PhaseAccumulator &acc = accumulators()[_phase];
+            acc.numScopes.fetch_add(1, std::memory_order_relaxed);
+            acc.nanoseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - _startTime).count()), std::memory_order_relaxed);
+
+#ifdef DEST_HAS_PERF_EVENT
+            uint64_t stop[NumRawValues];
+            CounterGroup &g = threadCounters();
+            if (_start[PERF_NUM_EVENTS] > 0 && g.read(stop)) {
+                const uint64_t enabled = stop[PERF_NUM_EVENTS] - _start[PERF_NUM_EVENTS];
+                const uint64_t running = stop[PERF_NUM_EVENTS + 1] - _start[PERF_NUM_EVENTS + 1];
+
+                // Scale for time the group was not scheduled on the PMU.
+                const double scale = running > 0 ? static_cast<double>(enabled) / static_cast<double>(running) : 0.0;
+
+                unsigned int mask = 0;
+                for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+                    if (!g.opened(e))
+                        continue;
+                    acc.counts[e].fetch_add(static_cast<uint64_t>((stop[e] - _start[e]) * scale), std::memory_order_relaxed);
+                    mask |= 1u << e;
+                }
+                acc.validMask.fetch_or(mask, std::memory_order_relaxed);
+            }
+#endif
+        }
+
+    }
+}
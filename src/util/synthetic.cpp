@@ -0,0 +1,301 @@
+/**
+    This file is part of Deformable Shape Tracking (DEST).
+
+    Copyright(C) 2015/2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/util/synthetic.h>
+#include <algorithm>
+#include <cmath>
+
+namespace dest {
+    namespace util {
+
+        inline core::Shape createSyntheticMeanFace() {
+            core::Shape s(2, 22);
+
+            // Contour, lower half of an ellipse
+            const float pi = 3.14159265f;
+            for (int i = 0; i < 7; ++i) {
+                float a = pi - i * pi / 6.f;
+                s(0, i) = 0.45f * std::cos(a);
+                s(1, i) = -0.05f + 0.53f * std::sin(a);
+            }
+
+            // Eyebrows, eyes, nose, mouth
+            const float rest[15][2] = {
+                {-0.32f, -0.28f}, {-0.12f, -0.30f}, {0.12f, -0.30f}, {0.32f, -0.28f},
+                {-0.30f, -0.15f}, {-0.10f, -0.15f}, {0.10f, -0.15f}, {0.30f, -0.15f},
+                {0.00f, -0.08f}, {-0.07f, 0.08f}, {0.07f, 0.08f},
+                {-0.17f, 0.25f}, {0.00f, 0.20f}, {0.17f, 0.25f}, {0.00f, 0.31f}
+            };
+
+            for (int i = 0; i < 15; ++i) {
+                s(0, 7 + i) = rest[i][0];
+                s(1, 7 + i) = rest[i][1];
+            }
+
+            return s;
+        }
+
+        core::Shape syntheticMeanFace()
+        {
+            static const core::Shape _instance = createSyntheticMeanFace();
+            return _instance;
+        }
+
+        core::Shape randomSyntheticFace(std::mt19937 &rnd)
+        {
+            core::Shape s = syntheticMeanFace();
+
+            std::uniform_real_distribution<float> jitter(-0.015f, 0.015f);
+            std::uniform_real_distribution<float> mouth(-0.03f, 0.08f);
+            std::uniform_real_distribution<float> eyes(0.85f, 1.15f);
+            std::uniform_real_distribution<float> jaw(0.9f, 1.1f);
+
+            // Jaw width
+            s.block(0, 0, 1, 7) *= jaw(rnd);
+
+            // Eye size around eye centers
+            const float eyeScale = eyes(rnd);
+            for (int e = 0; e < 2; ++e) {
+                const int i0 = 11 + 2 * e;
+                Eigen::Vector2f c = (s.col(i0) + s.col(i0 + 1)) * 0.5f;
+                s.col(i0) = c + (s.col(i0) - c) * eyeScale;
+                s.col(i0 + 1) = c + (s.col(i0 + 1) - c) * eyeScale;
+            }
+
+            // Mouth opening
+            s(1, 21) += mouth(rnd);
+
+            for (core::Shape::Index i = 0; i < s.cols(); ++i) {
+                s(0, i) += jitter(rnd);
+                s(1, i) += jitter(rnd);
+            }
+
+            return s;
+        }
+
+        inline void blendPixel(core::Image &img, int x, int y, float value, float weight) {
+            float v = img(y, x) * (1.f - weight) + value * weight;
+            img(y, x) = static_cast<unsigned char>(std::max<float>(0.f, std::min<float>(255.f, v)));
+        }
+
+        void renderSyntheticFace(const core::Shape &shape, core::Image &img)
+        {
+            const int rows = static_cast<int>(img.rows());
+            const int cols = static_cast<int>(img.cols());
+
+            // Map the face ellipse from normalized space to image space via best-fit similarity.
+            core::ShapeTransform shapeToImage = core::estimateSimilarityTransform(syntheticMeanFace(), shape);
+            core::ShapeTransform imageToShape = shapeToImage.inverse();
+            const float scale = shapeToImage.linear().col(0).norm();
+
+            core::Rect bounds = shapeToImage * (core::unitRectangle() * 1.3f).colwise().homogeneous();
+            const Eigen::Vector2f minC = bounds.rowwise().minCoeff();
+            const Eigen::Vector2f maxC = bounds.rowwise().maxCoeff();
+
+            const int x0 = std::max<int>(0, static_cast<int>(std::floor(minC.x())));
+            const int y0 = std::max<int>(0, static_cast<int>(std::floor(minC.y())));
+            const int x1 = std::min<int>(cols - 1, static_cast<int>(std::ceil(maxC.x())));
+            const int y1 = std::min<int>(rows - 1, static_cast<int>(std::ceil(maxC.y())));
+
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    Eigen::Vector2f n = imageToShape * Eigen::Vector2f(static_cast<float>(x), static_cast<float>(y));
+                    const float ex = n.x() / 0.47f;
+                    const float ey = (n.y() + 0.05f) / 0.58f;
+                    const float e = ex * ex + ey * ey;
+                    if (e <= 1.f) {
+                        // Vertical shading and a soft border
+                        const float value = 185.f - 45.f * n.y();
+                        blendPixel(img, x, y, value, std::min<float>(1.f, (1.f - e) * 8.f));
+                    }
+                }
+            }
+
+            // Dark blobs at landmarks
+            const float radius = std::max<float>(1.5f, 0.035f * scale);
+            const int iradius = static_cast<int>(std::ceil(radius));
+            for (core::Shape::Index i = 0; i < shape.cols(); ++i) {
+                const int cx = static_cast<int>(std::floor(shape(0, i) + 0.5f));
+                const int cy = static_cast<int>(std::floor(shape(1, i) + 0.5f));
+
+                for (int y = std::max<int>(0, cy - iradius); y <= std::min<int>(rows - 1, cy + iradius); ++y) {
+                    for (int x = std::max<int>(0, cx - iradius); x <= std::min<int>(cols - 1, cx + iradius); ++x) {
+                        const float dx = x - shape(0, i);
+                        const float dy = y - shape(1, i);
+                        const float w = 1.f - (dx * dx + dy * dy) / (radius * radius);
+                        if (w > 0.f) {
+                            blendPixel(img, x, y, 30.f, w);
+                        }
+                    }
+                }
+            }
+        }
+
+        void renderSyntheticBackground(std::mt19937 &rnd, core::Image &img)
+        {
+            const int grid = 8;
+            std::uniform_real_distribution<float> coarse(40.f, 140.f);
+            std::uniform_int_distribution<int> fine(-8, 8);
+
+            Eigen::MatrixXf g(grid + 1, grid + 1);
+            for (int i = 0; i < g.size(); ++i) {
+                g.data()[i] = coarse(rnd);
+            }
+
+            const int rows = static_cast<int>(img.rows());
+            const int cols = static_cast<int>(img.cols());
+            const float sy = static_cast<float>(grid) / std::max<int>(1, rows);
+            const float sx = static_cast<float>(grid) / std::max<int>(1, cols);
+
+            for (int y = 0; y < rows; ++y) {
+                const float gy = y * sy;
+                const int iy = std::min<int>(grid - 1, static_cast<int>(gy));
+                const float b = gy - iy;
+                for (int x = 0; x < cols; ++x) {
+                    const float gx = x * sx;
+                    const int ix = std::min<int>(grid - 1, static_cast<int>(gx));
+                    const float a = gx - ix;
+
+                    const float v = (g(iy, ix) * (1.f - a) + g(iy, ix + 1) * a) * (1.f - b) +
+                                    (g(iy + 1, ix) * (1.f - a) + g(iy + 1, ix + 1) * a) * b;
+
+                    img(y, x) = static_cast<unsigned char>(std::max<float>(0.f, std::min<float>(255.f, v + fine(rnd))));
+                }
+            }
+        }
+
+        void createSyntheticInputData(int numImages, int imageSize, std::mt19937 &rnd, core::InputData &input)
+        {
+            const float pi = 3.14159265f;
+            std::uniform_real_distribution<float> scale(0.4f * imageSize, 0.6f * imageSize);
+            std::uniform_real_distribution<float> angle(-pi / 12.f, pi / 12.f);
+            std::uniform_real_distribution<float> zeroone(0.f, 1.f);
+
+            for (int i = 0; i < numImages; ++i) {
+                const float s = scale(rnd);
+                const float slack = std::max<float>(0.f, 0.5f * imageSize - 0.6f * s);
+
+                Eigen::AffineCompact2f t;
+                t = Eigen::Translation2f(0.5f * imageSize + slack * (2.f * zeroone(rnd) - 1.f),
+                                         0.5f * imageSize + slack * (2.f * zeroone(rnd) - 1.f)) *
+                    Eigen::Rotation2Df(angle(rnd)) *
+                    Eigen::Scaling(s);
+
+                core::Shape shape = t * randomSyntheticFace(rnd).colwise().homogeneous();
+
+                core::Image img(imageSize, imageSize);
+                renderSyntheticBackground(rnd, img);
+                renderSyntheticFace(shape, img);
+
+                input.images.push_back(img);
+                input.shapes.push_back(shape);
+                input.rects.push_back(core::shapeBounds(shape));
+            }
+        }
+
+        SyntheticVideoParameters::SyntheticVideoParameters()
+        {
+            width = 320;
+            height = 240;
+            numFrames = 300;
+            faceSize = 0.5f;
+            maxSpeed = 4.f;
+            maxRotation = 3.14159265f / 12.f;
+            rotationPeriod = 90;
+            visibleFrames = 300;
+            hiddenFrames = 0;
+            noise = 2.f;
+            seed = 10;
+        }
+
+        SyntheticVideo::SyntheticVideo(const SyntheticVideoParameters &params)
+            :_params(params)
+        {
+            const float pi = 3.14159265f;
+            std::mt19937 rnd(params.seed);
+            std::uniform_real_distribution<float> phase(0.f, 2.f * pi);
+
+            _background.resize(params.height, params.width);
+            renderSyntheticBackground(rnd, _background);
+            _face = randomSyntheticFace(rnd);
+
+            // Keep the face including rotation and scale changes within the frame.
+            const float size = params.faceSize * std::min<int>(params.width, params.height);
+            _amplitude.x() = std::max<float>(0.f, 0.5f * params.width - 0.66f * size);
+            _amplitude.y() = std::max<float>(0.f, 0.5f * params.height - 0.66f * size);
+
+            // Peak speed of a * sin(f * t) is a * f. Vertical motion is slower for Lissajous like paths.
+            _frequency.x() = _amplitude.x() > 0.f ? params.maxSpeed / _amplitude.x() : 0.f;
+            _frequency.y() = _amplitude.y() > 0.f ? 0.7f * params.maxSpeed / _amplitude.y() : 0.f;
+
+            _phase.x() = phase(rnd);
+            _phase.y() = phase(rnd);
+            _scalePhase = phase(rnd);
+            _mouthPhase = phase(rnd);
+        }
+
+        int SyntheticVideo::numFrames() const
+        {
+            return _params.numFrames;
+        }
+
+        bool SyntheticVideo::faceVisible(int frame) const
+        {
+            if (_params.hiddenFrames <= 0)
+                return true;
+
+            return (frame % (_params.visibleFrames + _params.hiddenFrames)) < _params.visibleFrames;
+        }
+
+        core::Shape SyntheticVideo::shape(int frame) const
+        {
+            const float pi = 3.14159265f;
+            const float t = static_cast<float>(frame);
+
+            core::Shape face = _face;
+            face(1, 21) += 0.03f * std::sin(2.f * pi * t / 60.f + _mouthPhase);
+
+            const float size = _params.faceSize * std::min<int>(_params.width, _params.height);
+            const float scale = size * (1.f + 0.1f * std::sin(2.f * pi * t / 150.f + _scalePhase));
+            const float angle = _params.rotationPeriod > 0 ? _params.maxRotation * std::sin(2.f * pi * t / _params.rotationPeriod) : 0.f;
+
+            Eigen::AffineCompact2f tr;
+            tr = Eigen::Translation2f(0.5f * _params.width + _amplitude.x() * std::sin(_frequency.x() * t + _phase.x()),
+                                      0.5f * _params.height + _amplitude.y() * std::sin(_frequency.y() * t + _phase.y())) *
+                Eigen::Rotation2Df(angle) *
+                Eigen::Scaling(scale);
+
+            return tr * face.colwise().homogeneous();
+        }
+
+        bool SyntheticVideo::render(int frame, core::Image &img) const
+        {
+            img = _background;
+
+            if (_params.noise > 0.f) {
+                // Seeded per frame, so that frames can be rendered in any order.
+                std::mt19937 rnd(_params.seed + 1 + static_cast<unsigned int>(frame));
+                std::normal_distribution<float> noise(0.f, _params.noise);
+
+                for (core::Image::Index i = 0; i < img.size(); ++i) {
+                    const float v = img.data()[i] + noise(rnd) + 0.5f;
+                    img.data()[i] = static_cast<unsigned char>(std::max<float>(0.f, std::min<float>(255.f, v)));
+                }
+            }
+
+            const bool visible = faceVisible(frame);
+            if (visible) {
+                renderSyntheticFace(shape(frame), img);
+            }
+
+            return visible;
+        }
+    }
+}
@@ -0,0 +1,157 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/core/autotune.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+TEST_CASE("autotune-profile-io")
+{
+    dest::core::RuntimeProfile p;
+    p.isa = dest::util::ISA_GENERIC;
+    p.samplingStrategy = dest::core::SAMPLING_LAZY;
+    p.engine = dest::core::ENGINE_PIPELINED;
+    p.batchSize = 12;
+    p.numThreads = 3;
+    p.pipelineStages = 4;
+    p.facesPerSecond = 1234.5f;
+
+    const std::string path = "dest_test_autotune.profile";
+    REQUIRE(dest::core::saveRuntimeProfile(path, p));
+
+    dest::core::RuntimeProfile q;
+    REQUIRE(dest::core::loadRuntimeProfile(path, q));
+    REQUIRE(q.isa == p.isa);
+    REQUIRE(q.samplingStrategy == p.samplingStrategy);
+    REQUIRE(q.engine == p.engine);
+    REQUIRE(q.batchSize == 12);
+    REQUIRE(q.numThreads == 3);
+    REQUIRE(q.pipelineStages == 4);
+    REQUIRE(q.facesPerSecond == Approx(1234.5f));
+
+    // Partial profiles keep remaining values, unknown keys are skipped.
+    {
+        std::ofstream ofs(path.c_str());
+        ofs << "# comment" << std::endl << "batch_size=8" << std::endl << "future_key=1" << std::endl;
+    }
+    REQUIRE(dest::core::loadRuntimeProfile(path, q));
+    REQUIRE(q.batchSize == 8);
+    REQUIRE(q.pipelineStages == 4);
+
+    // Malformed values are rejected and leave the profile untouched.
+    {
+        std::ofstream ofs(path.c_str());
+        ofs << "batch_size=2" << std::endl << "engine=turbo" << std::endl;
+    }
+    REQUIRE(!dest::core::loadRuntimeProfile(path, q));
+    REQUIRE(q.batchSize == 8);
+
+    std::remove(path.c_str());
+    REQUIRE(!dest::core::loadRuntimeProfile(path, q));
+    REQUIRE(dest::core::runtimeProfilePath("dest.bin") == "dest.bin.profile");
+}
+
+TEST_CASE("autotune-select")
+{
+    dest::core::Tracker t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    const dest::util::InstructionSet isa = dest::util::activeInstructionSet();
+
+    dest::core::AutotuneParameters params;
+    params.batchSizes.assign(1, 8);
+    params.threadCounts.assign(1, 1);
+    params.maxPipelineStages = 2;
+    params.numRepetitions = 1;
+
+    std::vector<dest::core::Image> imgs(input.images.begin(), input.images.begin() + 16);
+    std::vector<dest::core::ShapeTransform> transforms(input.shapeToImage.begin(), input.shapeToImage.begin() + 16);
+
+    const std::ios::fmtflags flags = std::cout.flags();
+    const std::streamsize precision = std::cout.precision();
+
+    std::vector<dest::core::RuntimeProfile> trials;
+    dest::core::RuntimeProfile best = dest::core::autotune(t, imgs, transforms, params, &trials);
+
+    // Logging leaves the format of the shared output stream untouched.
+    REQUIRE(std::cout.flags() == flags);
+    REQUIRE(std::cout.precision() == precision);
+
+    const int numIsa = static_cast<int>(dest::util::detectInstructionSet()) + 1;
+    REQUIRE(trials.size() == static_cast<size_t>(numIsa * 3 + 1 + 1));
+    REQUIRE(best.facesPerSecond > 0.f);
+    for (size_t i = 0; i < trials.size(); ++i) {
+        REQUIRE(trials[i].facesPerSecond <= best.facesPerSecond);
+    }
+
+    // Global state is restored, tracker is untouched.
+    REQUIRE(dest::util::activeInstructionSet() == isa);
+    REQUIRE(t.samplingStrategy() == dest::core::SAMPLING_AUTO);
+
+    dest::core::applyRuntimeProfile(best, t);
+    REQUIRE(t.samplingStrategy() == best.samplingStrategy);
+    REQUIRE(dest::util::activeInstructionSet() == best.isa);
+    dest::util::setActiveInstructionSet(isa);
+
+    dest::core::CoalescerParameters cp;
+    dest::core::applyRuntimeProfile(best, cp);
+    REQUIRE(cp.maxBatchSize == best.batchSize);
+}
+
+TEST_CASE("autotune-predict-with-profile")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    std::vector<dest::core::MappedImage> imgs;
+    std::vector<dest::core::ShapeTransform> transforms(input.shapeToImage.begin(), input.shapeToImage.begin() + 10);
+    for (size_t i = 0; i < transforms.size(); ++i) {
+        const dest::core::Image &img = input.images[i];
+        imgs.push_back(dest::core::MappedImage(img.data(), img.rows(), img.cols(), Eigen::OuterStride<Eigen::Dynamic>(img.cols())));
+    }
+
+    // All engines produce the same landmarks as single predictions.
+    const dest::core::PredictEngine engines[] = { dest::core::ENGINE_SINGLE, dest::core::ENGINE_BATCHED, dest::core::ENGINE_PIPELINED };
+    for (int e = 0; e < 3; ++e) {
+        dest::core::RuntimeProfile p;
+        p.engine = engines[e];
+        p.batchSize = 4;
+        p.pipelineStages = 2;
+
+        std::vector<dest::core::Shape> shapes;
+        dest::core::predictWithRuntimeProfile(p, t, imgs, transforms, shapes);
+        REQUIRE(shapes.size() == imgs.size());
+
+        bool equal = true;
+        for (size_t i = 0; i < imgs.size(); ++i) {
+            equal = equal && shapes[i].isApprox(t.predict(input.images[i], transforms[i]));
+        }
+        REQUIRE(equal);
+
+        // A predictor reused across calls gives the same landmarks on every call.
+        dest::core::ProfiledPredictor predictor(p, t);
+        REQUIRE(predictor.profile().engine == p.engine);
+        for (int r = 0; r < 3; ++r) {
+            std::vector<dest::core::Shape> reused;
+            predictor.predict(imgs, transforms, reused);
+            REQUIRE(reused.size() == shapes.size());
+
+            bool same = true;
+            for (size_t i = 0; i < shapes.size(); ++i) {
+                same = same && reused[i].isApprox(shapes[i]);
+            }
+            REQUIRE(same);
+        }
+    }
+}
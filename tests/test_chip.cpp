@@ -0,0 +1,74 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+
+#include <dest/core/chip.h>
+#include <dest/util/synthetic.h>
+
+TEST_CASE("chip-reference-shape")
+{
+    dest::core::ChipParameters params;
+    params.width = 100;
+    params.height = 50;
+    params.padding = 0.1f;
+
+    dest::core::Shape s(2, 3);
+    s << -1.f, 1.f, 0.f,
+         -1.f, -1.f, 1.f;
+
+    dest::core::Shape r = dest::core::chipReferenceShape(s, params);
+
+    dest::core::Shape expected(2, 3);
+    expected << 29.5f, 69.5f, 49.5f,
+                4.5f, 4.5f, 44.5f;
+
+    REQUIRE(r.isApprox(expected));
+}
+
+TEST_CASE("chip-extract")
+{
+    std::mt19937 rnd(10);
+    dest::core::Image img(120, 160);
+    dest::util::renderSyntheticBackground(rnd, img);
+
+    dest::core::ChipParameters params;
+    params.width = 24;
+    params.height = 20;
+
+    dest::core::Shape reference = dest::core::chipReferenceShape(dest::util::syntheticMeanFace(), params);
+
+    Eigen::AffineCompact2f t0, t1;
+    t0 = Eigen::Translation2f(40.f, 30.f) * Eigen::Rotation2Df(0.3f) * Eigen::Scaling(1.5f);
+    t1 = Eigen::Translation2f(100.f, 70.f) * Eigen::Scaling(0.75f);
+
+    std::vector<dest::core::Shape> shapes;
+    shapes.push_back(t0 * reference.colwise().homogeneous());
+    shapes.push_back(t1 * reference.colwise().homogeneous());
+
+    std::vector<float> chips(2 * params.width * params.height);
+    dest::core::extractChips(img, shapes, reference, params, chips.data());
+
+    const Eigen::AffineCompact2f transforms[2] = { t0, t1 };
+    for (int c = 0; c < 2; ++c) {
+        dest::core::PixelCoordinates coords(2, params.width * params.height);
+        for (int y = 0; y < params.height; ++y) {
+            for (int x = 0; x < params.width; ++x) {
+                coords.col(y * params.width + x) = transforms[c] * Eigen::Vector2f((float)x, (float)y);
+            }
+        }
+
+        dest::core::PixelIntensities expected;
+        dest::core::readImage(img, coords, expected);
+
+        Eigen::Map<dest::core::PixelIntensities> chip(chips.data() + c * params.width * params.height, params.width * params.height);
+        REQUIRE(chip.isApprox(expected, 1e-3f));
+    }
+}
@@ -0,0 +1,163 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+
+#include <dest/face/detection_scheduler.h>
+
+/** Run frames without faces and return the frame indices the detector was run on. */
+inline std::vector<int> runEmptyFrames(dest::face::DetectionScheduler &s, int numFrames)
+{
+    std::vector<int> detections;
+    for (int i = 0; i < numFrames; ++i) {
+        if (s.shouldDetect()) {
+            detections.push_back(i);
+            s.reportDetection(false);
+        }
+    }
+    return detections;
+}
+
+TEST_CASE("detection-scheduler-backoff")
+{
+    dest::face::DetectionSchedulerParameters params;
+    params.baseInterval = 5;
+    params.minInterval = 1;
+    params.maxInterval = 16;
+    params.backoffFactor = 2.f;
+
+    dest::face::DetectionScheduler s(params);
+    std::vector<int> detections = runEmptyFrames(s, 100);
+
+    // Intervals grow 2, 4, 8, 16, 16, ...
+    REQUIRE(detections.size() >= 5);
+    REQUIRE(detections[0] == 0);
+    REQUIRE(detections[1] - detections[0] == 2);
+    REQUIRE(detections[2] - detections[1] == 4);
+    REQUIRE(detections[3] - detections[2] == 8);
+    REQUIRE(detections[4] - detections[3] == 16);
+    REQUIRE(s.stats().interval == 16);
+
+    REQUIRE(s.stats().numFrames == 100);
+    REQUIRE(s.stats().numDetections == static_cast<int>(detections.size()));
+    REQUIRE(s.stats().numBaselineDetections == 20);
+    REQUIRE(s.stats().detectionsSaved() == 20 - static_cast<int>(detections.size()));
+    REQUIRE(!s.tracking());
+}
+
+TEST_CASE("detection-scheduler-snap-back")
+{
+    dest::face::DetectionSchedulerParameters params;
+    params.baseInterval = 5;
+    params.maxInterval = 64;
+
+    dest::face::DetectionScheduler s(params);
+    runEmptyFrames(s, 200);
+    REQUIRE(s.stats().interval == 64);
+
+    // Global motion triggers detection on the next frame.
+    REQUIRE(s.shouldDetect(params.motionThreshold + 1.f));
+    REQUIRE(s.stats().numMotionTriggers == 1);
+
+    // New detection switches to the base cadence.
+    s.reportDetection(true);
+    REQUIRE(s.tracking());
+    REQUIRE(s.stats().interval == 5);
+
+    int numDetections = 0;
+    for (int i = 0; i < 20; ++i) {
+        if (s.shouldDetect()) {
+            ++numDetections;
+            s.reportDetection(true);
+        } else {
+            s.reportTrack(0.f);
+        }
+    }
+    REQUIRE(numDetections == 4);
+
+    // Explicit requests are honored.
+    s.requestDetection();
+    REQUIRE(s.shouldDetect());
+}
+
+TEST_CASE("detection-scheduler-uncertain-tracks")
+{
+    dest::face::DetectionSchedulerParameters params;
+    params.baseInterval = 8;
+
+    dest::face::DetectionScheduler s(params);
+    REQUIRE(s.shouldDetect());
+    s.reportDetection(true);
+    REQUIRE(s.stats().interval == 8);
+
+    // Uncertain tracks tighten the interval.
+    s.shouldDetect();
+    s.reportTrack(params.uncertaintyThreshold * 2.f);
+    REQUIRE(s.stats().interval == 4);
+    s.shouldDetect();
+    s.reportTrack(params.uncertaintyThreshold * 2.f);
+    REQUIRE(s.stats().interval == 2);
+
+    // Confident tracks relax it back to the base interval.
+    for (int i = 0; i < 10; ++i) {
+        if (!s.shouldDetect())
+            s.reportTrack(0.f);
+        else
+            s.reportDetection(true);
+    }
+    REQUIRE(s.stats().interval == 8);
+
+    // Losing the face starts backing off from the minimum interval.
+    s.reportDetection(false);
+    REQUIRE(!s.tracking());
+    REQUIRE(s.stats().interval == params.minInterval);
+}
+
+TEST_CASE("detection-scheduler-motion-while-tracking")
+{
+    dest::face::DetectionSchedulerParameters params;
+    params.baseInterval = 8;
+
+    dest::face::DetectionScheduler s(params);
+    REQUIRE(s.shouldDetect());
+    s.reportDetection(true);
+
+    // Motion while tracking confidently halves the base interval once, it does not detect every frame.
+    const float motion = params.motionThreshold + 1.f;
+    int numDetections = 0;
+    bool halved = true;
+    for (int i = 0; i < 40; ++i) {
+        const bool detect = s.shouldDetect(motion);
+        halved = halved && s.stats().interval == 4;
+        if (detect) {
+            ++numDetections;
+            s.reportDetection(true);
+        } else {
+            s.reportTrack(0.f);
+        }
+    }
+    REQUIRE(halved);
+    REQUIRE(numDetections == 10);
+
+    // Once the track is uncertain, motion snaps back to the minimum interval.
+    s.reportTrack(params.uncertaintyThreshold * 2.f);
+    s.shouldDetect(motion);
+    REQUIRE(s.stats().interval == params.minInterval);
+}
+
+TEST_CASE("detection-scheduler-motion")
+{
+    dest::core::Image a = dest::core::Image::Constant(16, 16, 10);
+    dest::core::Image b = dest::core::Image::Constant(16, 16, 30);
+
+    REQUIRE(dest::face::DetectionScheduler::measureMotion(a, a) == 0.f);
+    REQUIRE(dest::face::DetectionScheduler::measureMotion(a, b) == 20.f);
+    REQUIRE(dest::face::DetectionScheduler::measureMotion(a, dest::core::Image(8, 8)) == 0.f);
+}
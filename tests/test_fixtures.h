@@ -0,0 +1,59 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#ifndef DEST_TEST_FIXTURES_H
+#define DEST_TEST_FIXTURES_H
+
+#include <dest/core/tracker.h>
+#include <dest/core/training_data.h>
+#include <dest/util/synthetic.h>
+
+/**
+    Small set of synthetic faces shared by tests. Shapes are normalized.
+*/
+inline const dest::core::InputData &syntheticInputs()
+{
+    static dest::core::InputData input;
+    if (input.images.empty()) {
+        input.rnd.seed(10);
+        dest::util::createSyntheticInputData(60, 96, input.rnd, input);
+        dest::core::InputData::normalizeShapes(input);
+    }
+    return input;
+}
+
+/**
+    Tiny tracker trained on synthetic faces shared by tests.
+*/
+inline const dest::core::Tracker &syntheticTracker()
+{
+    static dest::core::Tracker t;
+    static bool trained = false;
+    if (!trained) {
+        dest::core::InputData input = syntheticInputs();
+
+        dest::core::SampleData td(input);
+        td.params.numCascades = 4;
+        td.params.numTrees = 20;
+        td.params.maxTreeDepth = 4;
+        td.params.numRandomPixelCoordinates = 100;
+        td.params.learningRate = 0.2f;
+
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 5;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+
+        t.fit(td);
+        trained = true;
+    }
+    return t;
+}
+
+#endif
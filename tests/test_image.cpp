@@ -11,6 +11,7 @@
 #include "catch.hpp"
 
 #include <dest/core/image.h>
+#include <dest/util/cpu.h>
 
 TEST_CASE("image-readpixels")
 {
@@ -30,4 +31,283 @@ TEST_CASE("image-readpixels")
     
     REQUIRE(intensities.isApprox(expected));
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("image-readpixels-instruction-sets")
+{
+    std::mt19937 rnd(10);
+    std::uniform_int_distribution<int> di(0, 255);
+    std::uniform_real_distribution<float> dc(-10.f, 50.f);
+
+    // Odd sized image embedded in a larger one to get a non-trivial stride.
+    dest::core::Image full(41, 53);
+    for (int i = 0; i < full.size(); ++i)
+        full.data()[i] = static_cast<unsigned char>(di(rnd));
+    Eigen::Ref<const dest::core::Image> img = full.block(1, 3, 37, 47);
+
+    dest::core::PixelCoordinates coords(2, 103);
+    for (int i = 0; i < coords.size(); ++i)
+        coords.data()[i] = dc(rnd);
+
+    const dest::util::InstructionSet active = dest::util::activeInstructionSet();
+
+    REQUIRE(dest::util::setActiveInstructionSet(dest::util::ISA_GENERIC));
+    dest::core::PixelIntensities expected;
+    dest::core::readImage(img, coords, expected);
+
+    const dest::util::InstructionSet levels[] = { dest::util::ISA_SSE2, dest::util::ISA_AVX2, dest::util::ISA_AVX512 };
+    for (int l = 0; l < 3; ++l) {
+        if (!dest::util::setActiveInstructionSet(levels[l]))
+            continue;
+
+        dest::core::PixelIntensities intensities;
+        dest::core::readImage(img, coords, intensities);
+        REQUIRE(intensities.isApprox(expected));
+    }
+
+    dest::util::setActiveInstructionSet(active);
+}
+
+TEST_CASE("image-readpixels-instruction-sets-borders")
+{
+    std::mt19937 rnd(10);
+    std::uniform_int_distribution<int> di(0, 255);
+
+    // Tightly allocated images sampled at their first and last pixels, including one too small for word gathers.
+    const int sizes[][2] = { { 7, 9 }, { 1, 3 } };
+    const dest::util::InstructionSet active = dest::util::activeInstructionSet();
+
+    for (int s = 0; s < 2; ++s) {
+        const int rows = sizes[s][0];
+        const int cols = sizes[s][1];
+
+        dest::core::Image img(rows, cols);
+        for (int i = 0; i < img.size(); ++i)
+            img.data()[i] = static_cast<unsigned char>(di(rnd));
+
+        dest::core::PixelCoordinates coords(2, 32);
+        for (int i = 0; i < coords.cols(); ++i) {
+            const bool first = (i % 2) == 0;
+            coords(0, i) = first ? -1.f + 0.1f * i : cols - 0.1f * i;
+            coords(1, i) = first ? -0.5f : rows - 0.5f;
+        }
+
+        REQUIRE(dest::util::setActiveInstructionSet(dest::util::ISA_GENERIC));
+        dest::core::PixelIntensities expected;
+        dest::core::readImage(img, coords, expected);
+
+        const dest::util::InstructionSet levels[] = { dest::util::ISA_SSE2, dest::util::ISA_AVX2, dest::util::ISA_AVX512 };
+        for (int l = 0; l < 3; ++l) {
+            if (!dest::util::setActiveInstructionSet(levels[l]))
+                continue;
+
+            dest::core::PixelIntensities intensities;
+            dest::core::readImage(img, coords, intensities);
+            REQUIRE(intensities.isApprox(expected));
+        }
+    }
+
+    dest::util::setActiveInstructionSet(active);
+}
+
+TEST_CASE("image-readpixels-instruction-sets-exact")
+{
+    std::mt19937 rnd(10);
+    std::uniform_int_distribution<int> di(0, 255);
+    std::uniform_real_distribution<float> dc(-2.f, 130.f);
+
+    dest::core::Image img(97, 128);
+    for (int i = 0; i < img.size(); ++i)
+        img.data()[i] = static_cast<unsigned char>(di(rnd));
+
+    dest::core::PixelCoordinates coords(2, 4099);
+    for (int i = 0; i < coords.size(); ++i)
+        coords.data()[i] = dc(rnd);
+
+    const dest::util::InstructionSet active = dest::util::activeInstructionSet();
+
+    REQUIRE(dest::util::setActiveInstructionSet(dest::util::ISA_GENERIC));
+    dest::core::PixelIntensities expected;
+    dest::core::readImage(img, coords, expected);
+
+    // Interpolation is not contracted to fused multiply-add, so all levels agree bit for bit.
+    const dest::util::InstructionSet levels[] = { dest::util::ISA_SSE2, dest::util::ISA_AVX2, dest::util::ISA_AVX512 };
+    for (int l = 0; l < 3; ++l) {
+        if (!dest::util::setActiveInstructionSet(levels[l]))
+            continue;
+
+        dest::core::PixelIntensities intensities;
+        dest::core::readImage(img, coords, intensities);
+
+        bool equal = (intensities.size() == expected.size());
+        for (int i = 0; equal && i < expected.size(); ++i)
+            equal = (intensities(i) == expected(i));
+        REQUIRE(equal);
+    }
+
+    dest::util::setActiveInstructionSet(active);
+}
+
+TEST_CASE("image-readpixels-lazy")
+{
+    std::mt19937 rnd(10);
+    std::uniform_int_distribution<int> di(0, 255);
+    std::uniform_real_distribution<float> dc(-5.f, 5.f);
+
+    dest::core::Image img(32, 40);
+    for (int i = 0; i < img.size(); ++i)
+        img.data()[i] = static_cast<unsigned char>(di(rnd));
+
+    dest::core::PixelCoordinates anchors(2, 3);
+    anchors << 5.f, 20.f, 35.f,
+               5.f, 30.f, 10.f;
+
+    dest::core::PixelCoordinates offsets(2, 70);
+    Eigen::VectorXi anchorIds(70);
+    for (int i = 0; i < 70; ++i) {
+        offsets(0, i) = dc(rnd);
+        offsets(1, i) = dc(rnd);
+        anchorIds(i) = i % 3;
+    }
+
+    Eigen::Matrix2f A;
+    A << 0.8f, -0.6f,
+         0.6f, 0.8f;
+
+    const dest::util::InstructionSet active = dest::util::activeInstructionSet();
+
+    dest::core::PixelIntensities expected;
+    dest::core::readImage(img, A, offsets, anchorIds, anchors, expected);
+
+    // Relative locations resolve to A * offset + anchor.
+    dest::core::PixelCoordinates coords = A * offsets;
+    for (int i = 0; i < 70; ++i)
+        coords.col(i) += anchors.col(anchorIds(i));
+    dest::core::PixelIntensities absolute;
+    dest::core::readImage(img, coords, absolute);
+    REQUIRE(expected.isApprox(absolute, 1e-4f));
+
+    dest::core::LazyPixelIntensities lazy(img, A, offsets, anchorIds, anchors);
+    REQUIRE(lazy.numSampled() == 0);
+    REQUIRE(lazy(3) == expected(3));
+    REQUIRE(lazy(65) == expected(65));
+    REQUIRE(lazy(3) == expected(3));
+    REQUIRE(lazy.numSampled() == 2);
+
+    bool equal = true;
+    for (int i = 0; i < 70; ++i)
+        equal = equal && (lazy(i) == expected(i));
+    REQUIRE(equal);
+    REQUIRE(lazy.numSampled() == 70);
+
+    // Lazy reads use the generic kernel and match bulk reads of every instruction set level.
+    const dest::util::InstructionSet levels[] = { dest::util::ISA_GENERIC, dest::util::ISA_SSE2, dest::util::ISA_AVX2, dest::util::ISA_AVX512 };
+    for (int l = 0; l < 4; ++l) {
+        if (!dest::util::setActiveInstructionSet(levels[l]))
+            continue;
+
+        dest::core::PixelIntensities bulk;
+        dest::core::readImage(img, A, offsets, anchorIds, anchors, bulk);
+        equal = true;
+        for (int i = 0; i < 70; ++i)
+            equal = equal && (lazy(i) == bulk(i));
+        REQUIRE(equal);
+    }
+    dest::util::setActiveInstructionSet(active);
+
+    // Reused buffers start out empty for each instance.
+    dest::core::LazyPixelIntensities::Buffer buffer;
+    for (int k = 0; k < 2; ++k) {
+        dest::core::LazyPixelIntensities reused(img, A, offsets, anchorIds, anchors, buffer);
+        REQUIRE(reused.numSampled() == 0);
+        REQUIRE(reused(k) == expected(k));
+        REQUIRE(reused.numSampled() == 1);
+    }
+}
+
+TEST_CASE("image-pyramid")
+{
+    dest::core::Image img(6, 7);
+    for (int r = 0; r < 6; ++r)
+        for (int c = 0; c < 7; ++c)
+            img(r, c) = static_cast<unsigned char>(10 * r + c);
+
+    dest::core::ImagePyramid pyr;
+    pyr.create(img, 0, 0, 7, 6, 2);
+    REQUIRE(pyr.numLevels() == 2);
+
+    // 2x2 box filter, odd border replicates last column.
+    const dest::core::Image &l1 = pyr.level(1);
+    REQUIRE(l1.rows() == 3);
+    REQUIRE(l1.cols() == 4);
+    REQUIRE(l1(0, 0) == 6);
+    REQUIRE(l1(1, 2) == 30);
+    REQUIRE(l1(2, 3) == 51);
+
+    const dest::core::Image &l2 = pyr.level(2);
+    REQUIRE(l2.rows() == 2);
+    REQUIRE(l2.cols() == 2);
+
+    // Center of 2x2 block maps to level pixel center.
+    Eigen::Vector2f p = pyr.imageToLevel(1) * Eigen::Vector2f(2.5f, 0.5f);
+    REQUIRE(p.isApprox(Eigen::Vector2f(1.f, 0.f)));
+    p = pyr.imageToLevel(2) * Eigen::Vector2f(5.5f, 1.5f);
+    REQUIRE(p.isApprox(Eigen::Vector2f(1.f, 0.f)));
+
+    // Aligned regions reproduce levels of the entire image.
+    dest::core::ImagePyramid roi;
+    roi.create(img, 4, 2, 10, 10, 2);
+    REQUIRE(roi.level(1)(0, 0) == l1(1, 2));
+    p = roi.imageToLevel(1) * Eigen::Vector2f(4.5f, 2.5f);
+    REQUIRE(p.isApprox(Eigen::Vector2f(0.f, 0.f)));
+
+    // Regions outside of image are empty.
+    roi.create(img, 10, 10, 4, 4, 2);
+    REQUIRE(roi.numLevels() == 0);
+}
+
+TEST_CASE("image-pyramid-lazy")
+{
+    std::mt19937 rnd(10);
+    std::uniform_int_distribution<int> di(0, 255);
+
+    dest::core::Image img(200, 300);
+    for (int i = 0; i < img.size(); ++i)
+        img.data()[i] = static_cast<unsigned char>(di(rnd));
+
+    // Odd region extents, last tiles are partial.
+    dest::core::ImagePyramid eager, lazy;
+    eager.create(img, 16, 32, 171, 149, 3);
+    lazy.createLazy(img, 16, 32, 171, 149, 3);
+    REQUIRE(lazy.numLevels() == 3);
+
+    // Pixels bilinear sampling inside the bounds reads equal those of the eager pyramid.
+    const Eigen::AlignedBox2f bounds(Eigen::Vector2f(3.5f, 2.2f), Eigen::Vector2f(9.1f, 7.9f));
+    const dest::core::Image &l2 = lazy.level(2, bounds);
+    bool equal = true;
+    for (int r = 2; r <= 8; ++r)
+        for (int c = 3; c <= 10; ++c)
+            equal = equal && (l2(r, c) == eager.level(2)(r, c));
+    REQUIRE(equal);
+
+    // Levels across tiles are repeated 2x2 box filters of the region.
+    const dest::core::Image &e1 = eager.level(1);
+    const dest::core::Image &e2 = eager.level(2);
+    equal = true;
+    for (int r = 0; r < 74; ++r)
+        for (int c = 0; c < 85; ++c)
+            equal = equal && (e1(r, c) == ((img(32 + 2 * r, 16 + 2 * c) + img(32 + 2 * r, 17 + 2 * c) + img(33 + 2 * r, 16 + 2 * c) + img(33 + 2 * r, 17 + 2 * c) + 2) >> 2));
+    for (int r = 0; r < 37; ++r)
+        for (int c = 0; c < 42; ++c)
+            equal = equal && (e2(r, c) == ((e1(2 * r, 2 * c) + e1(2 * r, 2 * c + 1) + e1(2 * r + 1, 2 * c) + e1(2 * r + 1, 2 * c + 1) + 2) >> 2));
+    REQUIRE(equal);
+
+    // Bounds exceeding the level clamp to its border.
+    const Eigen::AlignedBox2f all(Eigen::Vector2f(-100.f, -100.f), Eigen::Vector2f(1000.f, 1000.f));
+    for (int l = 1; l <= 3; ++l) {
+        const dest::core::Image &level = lazy.level(l, all);
+        REQUIRE(level.rows() == eager.level(l).rows());
+        REQUIRE(level.cols() == eager.level(l).cols());
+        REQUIRE(level == eager.level(l));
+    }
+}
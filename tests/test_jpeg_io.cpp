@@ -0,0 +1,163 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include <dest/core/config.h>
+#ifdef DEST_WITH_JPEG
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/io/jpeg_io.h>
+
+/** Smooth test pattern with some texture. */
+inline dest::core::Image createPattern(int rows, int cols)
+{
+    dest::core::Image img(rows, cols);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            img(y, x) = static_cast<unsigned char>((x * 3 + y * 2 + ((x / 7 + y / 5) % 3) * 40) % 256);
+        }
+    }
+    return img;
+}
+
+TEST_CASE("jpeg-region")
+{
+    const dest::core::Image img = createPattern(301, 417);
+
+    std::vector<unsigned char> data;
+    REQUIRE(dest::io::encodeJpeg(img, 95, data));
+
+    int w, h;
+    REQUIRE(dest::io::readJpegSize(data.data(), data.size(), w, h));
+    REQUIRE(w == 417);
+    REQUIRE(h == 301);
+
+    dest::io::JpegRegion full;
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), 0, 0, w, h, 1, full));
+    REQUIRE(full.image.rows() == 301);
+    REQUIRE(full.image.cols() == 417);
+    REQUIRE((full.image.cast<float>() - img.cast<float>()).cwiseAbs().mean() < 4.f);
+
+    // Cropped regions decode to the same pixels as the full image.
+    dest::io::JpegRegion r;
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), 53, 91, 100, 70, 1, r));
+    REQUIRE(r.x == 53);
+    REQUIRE(r.y == 91);
+    REQUIRE(r.image == full.image.block(91, 53, 70, 100));
+    REQUIRE(r.imageToRegion().matrix().isApprox((dest::core::ShapeTransform(Eigen::Translation2f(-53.f, -91.f))).matrix()));
+
+    // Regions are clipped to the image.
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), -20, 250, 100, 100, 1, r));
+    REQUIRE(r.x == 0);
+    REQUIRE(r.y == 250);
+    REQUIRE(r.image == full.image.block(250, 0, 51, 80));
+
+    // Reduced scale.
+    dest::io::JpegRegion fullHalf, half;
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), 0, 0, w, h, 2, fullHalf));
+    REQUIRE(fullHalf.image.rows() == 151);
+    REQUIRE(fullHalf.image.cols() == 209);
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), 53, 91, 100, 70, 2, half));
+    REQUIRE(half.x == 52);
+    REQUIRE(half.y == 90);
+    REQUIRE(half.image == fullHalf.image.block(45, 26, 36, 51));
+
+    // Failures
+    REQUIRE(!dest::io::decodeJpegRegion(data.data(), data.size(), 0, 0, w, h, 3, r));
+    REQUIRE(!dest::io::decodeJpegRegion(data.data(), data.size(), w, 0, 10, 10, 1, r));
+    REQUIRE(!dest::io::decodeJpegRegion(data.data(), data.size() / 8, 0, 0, w, h, 1, r));
+    REQUIRE(!dest::io::readJpegSize(img.data(), 100, w, h));
+}
+
+TEST_CASE("jpeg-realign")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    // Place a face in a larger photo.
+    dest::core::Image canvas = createPattern(480, 640);
+    const Eigen::Vector2f offset(300.f, 200.f);
+    canvas.block(200, 300, input.images[0].rows(), input.images[0].cols()) = input.images[0];
+    const dest::core::Rect rect = input.rects[0].colwise() + offset;
+
+    std::vector<unsigned char> data;
+    REQUIRE(dest::io::encodeJpeg(canvas, 100, data));
+
+    dest::io::JpegRegion full;
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), 0, 0, 640, 480, 1, full));
+
+    const dest::core::ShapeTransform shapeToImage = dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), rect);
+    const dest::core::Shape expected = t.predict(full.image, shapeToImage);
+
+    dest::io::JpegRealignParameters params;
+    params.footprintScale = 4.f;
+
+    dest::core::Shape s;
+    dest::io::JpegRegion region;
+    REQUIRE(dest::io::realignJpeg(t, data.data(), data.size(), rect, params, s, &region));
+    REQUIRE(s.isApprox(expected, 1e-3f));
+    REQUIRE(region.image.size() < full.image.size() / 4);
+
+    // Automatic scale keeps faces at least minFaceSize wide.
+    const float faceSize = (rect.rowwise().maxCoeff() - rect.rowwise().minCoeff()).minCoeff();
+    params.scaleDenom = 0;
+    params.minFaceSize = static_cast<int>(faceSize / 2);
+    REQUIRE(dest::io::realignJpeg(t, data.data(), data.size(), rect, params, s, &region));
+    REQUIRE(region.scaleDenom == 2);
+    REQUIRE(s.cols() == expected.cols());
+    REQUIRE((s - expected).colwise().norm().mean() < 0.1f * faceSize);
+}
+
+TEST_CASE("jpeg-tile-source")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::core::Image canvas = createPattern(480, 640);
+    canvas.block(200, 300, input.images[0].rows(), input.images[0].cols()) = input.images[0];
+    const dest::core::Rect rect = input.rects[0].colwise() + Eigen::Vector2f(300.f, 200.f);
+
+    std::vector<unsigned char> data;
+    REQUIRE(dest::io::encodeJpeg(canvas, 100, data));
+
+    dest::io::JpegTileSource src;
+    REQUIRE(!src.open(data.data(), 100));
+    REQUIRE(src.open(data.data(), data.size()));
+    REQUIRE(src.width() == 640);
+    REQUIRE(src.height() == 480);
+    REQUIRE(src.threadSafe());
+
+    // Regions decode to the same pixels as the full image.
+    dest::io::JpegRegion full;
+    REQUIRE(dest::io::decodeJpegRegion(data.data(), data.size(), 0, 0, 640, 480, 1, full));
+
+    dest::core::Image region;
+    REQUIRE(src.readRegion(53, 91, 100, 70, region));
+    REQUIRE(region == full.image.block(91, 53, 70, 100));
+
+    // Aligning from regions decoded on demand matches aligning on the decoded image.
+    dest::face::TiledParameters params;
+    params.footprintScale = 4.f;
+    params.numThreads = 2;
+
+    std::vector<dest::core::Rect> faces(1, rect);
+    std::vector<dest::core::Shape> shapes, expected;
+
+    dest::face::TiledProcessor p(t, params);
+    REQUIRE(p.align(src, faces, shapes));
+    REQUIRE(p.stats().peakResidentPixels < static_cast<size_t>(full.image.size()) / 4);
+
+    dest::face::ImageTileSource fullSrc(full.image);
+    REQUIRE(p.align(fullSrc, faces, expected));
+    REQUIRE(shapes[0].isApprox(expected[0], 1e-4f));
+}
+
+#endif
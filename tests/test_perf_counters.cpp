@@ -0,0 +1,60 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/util/perf_counters.h>
+#include <sstream>
+
+TEST_CASE("perf-counters-scopes")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::util::setPerfCountersEnabled(false);
+    dest::util::resetPerfStats();
+    t.predict(input.images[0], input.shapeToImage[0]);
+    REQUIRE(dest::util::perfStats(dest::util::PERF_PHASE_PREDICT).numScopes == 0);
+
+    // Scopes are recorded whether or not hardware counters are available.
+    dest::util::setPerfCountersEnabled(true);
+    for (int i = 0; i < 5; ++i) {
+        t.predict(input.images[i], input.shapeToImage[i]);
+    }
+
+    {
+        // Nested scopes are measured once.
+        dest::util::PerfScope outer(dest::util::PERF_PHASE_PREDICT);
+        t.predict(input.images[0], input.shapeToImage[0]);
+    }
+
+    dest::util::setPerfCountersEnabled(false);
+
+    const dest::util::PerfStats s = dest::util::perfStats(dest::util::PERF_PHASE_PREDICT);
+    REQUIRE(s.numScopes == 6);
+    REQUIRE(s.milliseconds > 0.0);
+    REQUIRE(dest::util::perfStats(dest::util::PERF_PHASE_FIT).numScopes == 0);
+
+    if (dest::util::perfCountersAvailable()) {
+        REQUIRE(s.valid[dest::util::PERF_CYCLES]);
+        REQUIRE(s.counts[dest::util::PERF_CYCLES] > 0);
+    } else {
+        REQUIRE(!s.valid[dest::util::PERF_CYCLES]);
+        REQUIRE(s.instructionsPerCycle() == 0.0);
+    }
+
+    std::ostringstream oss;
+    oss << s;
+    REQUIRE(oss.str().find("Cycles") != std::string::npos);
+
+    dest::util::resetPerfStats();
+    REQUIRE(dest::util::perfStats(dest::util::PERF_PHASE_PREDICT).numScopes == 0);
+}
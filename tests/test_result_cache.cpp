@@ -0,0 +1,178 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/core/result_cache.h>
+#include <dest/util/hash.h>
+#include <cstdio>
+#include <cstring>
+
+TEST_CASE("hash-bytes")
+{
+    // Reference values of XXH64.
+    REQUIRE(dest::util::hashBytes("", 0) == 0xef46db3751d8e999ULL);
+    REQUIRE(dest::util::hashBytes("a", 1) == 0xd24ec4f1a98c6e5bULL);
+
+    const char *s = "Nobody inspects the spammish repetition";
+    REQUIRE(dest::util::hashBytes(s, std::strlen(s)) == 0xfbcea83c8a378bf1ULL);
+}
+
+TEST_CASE("result-cache-memory")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::core::ResultCacheParameters params;
+    params.maxEntries = 4;
+    dest::core::ResultCache cache(t, params);
+
+    // Keys do not depend on image stride.
+    const dest::core::Image &img = input.images[0];
+    dest::core::Image padded = dest::core::Image::Zero(img.rows(), img.cols() + 7);
+    padded.block(0, 0, img.rows(), img.cols()) = img;
+    dest::core::MappedImage view(padded.data(), img.rows(), img.cols(), Eigen::OuterStride<Eigen::Dynamic>(padded.cols()));
+    REQUIRE(dest::core::hashImage(view) == dest::core::hashImage(img));
+    REQUIRE(cache.key(view, input.shapeToImage[0]) == cache.key(img, input.shapeToImage[0]));
+    REQUIRE(!(cache.key(img, input.shapeToImage[1]) == cache.key(img, input.shapeToImage[0])));
+
+    const dest::core::Shape expected = t.predict(img, input.shapeToImage[0]);
+    REQUIRE(cache.predict(img, input.shapeToImage[0]).isApprox(expected));
+    REQUIRE(cache.predict(view, input.shapeToImage[0]).isApprox(expected));
+    REQUIRE(cache.stats().numHits == 1);
+    REQUIRE(cache.stats().numMisses == 1);
+
+    // Least recently used results are evicted.
+    for (int i = 1; i < 5; ++i) {
+        cache.predict(input.images[i], input.shapeToImage[i]);
+    }
+    dest::core::ResultCacheStats s = cache.stats();
+    REQUIRE(s.numEntries == 4);
+    REQUIRE(s.numEvictions == 1);
+
+    dest::core::Shape shape;
+    REQUIRE(!cache.lookup(cache.key(img, input.shapeToImage[0]), shape));
+    REQUIRE(cache.lookup(cache.key(input.images[4], input.shapeToImage[4]), shape));
+
+    // Batches evaluate duplicates once.
+    cache.clear();
+    std::vector<dest::core::MappedImage> imgs;
+    std::vector<dest::core::ShapeTransform> transforms;
+    for (int i = 0; i < 6; ++i) {
+        const dest::core::Image &im = input.images[i % 2];
+        imgs.push_back(dest::core::MappedImage(im.data(), im.rows(), im.cols(), Eigen::OuterStride<Eigen::Dynamic>(im.cols())));
+        transforms.push_back(input.shapeToImage[i % 2]);
+    }
+
+    std::vector<dest::core::Shape> shapes;
+    cache.predict(imgs, transforms, shapes);
+    REQUIRE(shapes.size() == 6);
+    REQUIRE(cache.stats().numEntries == 2);
+    for (int i = 0; i < 6; ++i) {
+        REQUIRE(shapes[i].isApprox(t.predict(input.images[i % 2], input.shapeToImage[i % 2])));
+    }
+}
+
+TEST_CASE("result-cache-face-region")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::core::ResultCacheParameters params;
+    params.hashFaceRegion = true;
+    dest::core::ResultCache cache(t, params);
+
+    // Embed face into larger canvases at different offsets.
+    const dest::core::Image &img = input.images[0];
+    dest::core::Image a = dest::core::Image::Constant(200, 200, 10);
+    dest::core::Image b = dest::core::Image::Constant(200, 220, 10);
+    a.block(20, 30, img.rows(), img.cols()) = img;
+    b.block(50, 90, img.rows(), img.cols()) = img;
+
+    dest::core::ShapeTransform ta = input.shapeToImage[0];
+    dest::core::ShapeTransform tb = input.shapeToImage[0];
+    ta.translation() += Eigen::Vector2f(30.f, 20.f);
+    tb.translation() += Eigen::Vector2f(90.f, 50.f);
+
+    REQUIRE(cache.key(a, ta) == cache.key(b, tb));
+
+    // Results are shared and mapped to the respective position.
+    const dest::core::Shape sa = cache.predict(a, ta);
+    const dest::core::Shape sb = cache.predict(b, tb);
+    REQUIRE(cache.stats().numHits == 1);
+    REQUIRE(sb.isApprox(t.predict(b, tb), 1e-4f));
+    REQUIRE((sb.colwise() - Eigen::Vector2f(60.f, 30.f)).isApprox(sa, 1e-4f));
+
+    // Pixels far from the face do not affect the key.
+    dest::core::ResultCacheKey k = cache.key(a, ta);
+    a(199, 199) = 255;
+    REQUIRE(cache.key(a, ta) == k);
+    a(20 + img.rows() / 2, 30 + img.cols() / 2) ^= 1;
+    REQUIRE(!(cache.key(a, ta) == k));
+}
+
+TEST_CASE("result-cache-disk")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    const std::string path = "dest_test_result_cache.bin";
+    std::remove(path.c_str());
+
+    dest::core::ResultCacheParameters params;
+    params.diskPath = path;
+
+    dest::core::Shape expected;
+    {
+        dest::core::ResultCache cache(t, params);
+        for (int i = 0; i < 3; ++i) {
+            cache.predict(input.images[i], input.shapeToImage[i]);
+        }
+        expected = cache.predict(input.images[2], input.shapeToImage[2]);
+        REQUIRE(cache.stats().numDiskEntries == 3);
+    }
+
+    {
+        // Results survive restarts.
+        dest::core::ResultCache cache(t, params);
+        REQUIRE(cache.stats().numDiskEntries == 3);
+        REQUIRE(cache.stats().numEntries == 0);
+
+        dest::core::Shape s;
+        REQUIRE(cache.lookup(cache.key(input.images[2], input.shapeToImage[2]), s));
+        s = input.shapeToImage[2] * s.colwise().homogeneous();
+        REQUIRE(s.isApprox(expected));
+        REQUIRE(cache.stats().numDiskHits == 1);
+        REQUIRE(cache.stats().numEntries == 1);
+        REQUIRE(cache.predict(input.images[1], input.shapeToImage[1]).isApprox(t.predict(input.images[1], input.shapeToImage[1])));
+        REQUIRE(cache.stats().numDiskHits == 2);
+    }
+
+    {
+        // Results of other models are not returned.
+        dest::core::Tracker other = t;
+        dest::core::InputData in = input;
+        dest::core::SampleData td(in);
+        td.params.numCascades = 1;
+        td.params.numTrees = 5;
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 1;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+        other.fit(td);
+        REQUIRE(dest::core::trackerFingerprint(other) != dest::core::trackerFingerprint(t));
+
+        dest::core::ResultCache cache(other, params);
+        dest::core::Shape s;
+        REQUIRE(!cache.lookup(cache.key(input.images[2], input.shapeToImage[2]), s));
+    }
+
+    std::remove(path.c_str());
+}
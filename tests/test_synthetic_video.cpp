@@ -0,0 +1,85 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/util/synthetic.h>
+#include <dest/core/tracker.h>
+
+TEST_CASE("synthetic-video")
+{
+    dest::util::SyntheticVideoParameters params;
+    params.numFrames = 100;
+    params.visibleFrames = 30;
+    params.hiddenFrames = 10;
+
+    dest::util::SyntheticVideo video(params);
+    dest::util::SyntheticVideo same(params);
+
+    REQUIRE(video.numFrames() == 100);
+
+    dest::core::Image img, other;
+    float maxDisplacement = 0.f;
+    for (int i = 0; i < video.numFrames(); ++i) {
+        const bool visible = video.render(i, img);
+        REQUIRE(visible == ((i % 40) < 30));
+        REQUIRE(img.rows() == params.height);
+        REQUIRE(img.cols() == params.width);
+
+        // Deterministic in frame index
+        same.render(i, other);
+        REQUIRE(img == other);
+
+        // Face stays within the frame and moves smoothly
+        const dest::core::Shape s = video.shape(i);
+        REQUIRE(s.row(0).minCoeff() >= 0.f);
+        REQUIRE(s.row(0).maxCoeff() < params.width);
+        REQUIRE(s.row(1).minCoeff() >= 0.f);
+        REQUIRE(s.row(1).maxCoeff() < params.height);
+
+        if (i > 0) {
+            maxDisplacement = std::max<float>(maxDisplacement, (s - video.shape(i - 1)).colwise().norm().maxCoeff());
+        }
+    }
+
+    REQUIRE(maxDisplacement > 0.f);
+    REQUIRE(maxDisplacement < 2.f * params.maxSpeed);
+}
+
+TEST_CASE("synthetic-video-alignment")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+
+    // Match the face sizes the tracker was trained on.
+    dest::util::SyntheticVideoParameters params;
+    params.width = 128;
+    params.height = 96;
+    params.numFrames = 60;
+    params.maxSpeed = 2.f;
+
+    dest::util::SyntheticVideo video(params);
+
+    // Align from the bounds of the ground truth shape, as a perfect face detector would report.
+    dest::core::Image img;
+    float error = 0.f;
+    for (int i = 0; i < video.numFrames(); ++i) {
+        video.render(i, img);
+
+        const dest::core::Shape gt = video.shape(i);
+        const dest::core::Rect r = dest::core::shapeBounds(gt);
+        const dest::core::Shape s = t.predict(img, dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), r));
+
+        error += (s - gt).colwise().norm().mean() / (r.col(3) - r.col(0)).norm();
+    }
+    error /= video.numFrames();
+
+    REQUIRE(error < 0.03f);
+}
@@ -0,0 +1,227 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/face/tiled_processor.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/** Tile source remembering the origin of the last read and the largest region read. */
+class RecordingTileSource : public dest::face::ImageTileSource {
+public:
+    RecordingTileSource(const Eigen::Ref<const dest::core::Image> &img)
+    : ImageTileSource(img), lastX(0), lastY(0), maxPixels(0)
+    {}
+
+    bool readRegion(int x, int y, int w, int h, dest::core::Image &dst) {
+        lastX = x;
+        lastY = y;
+        maxPixels = std::max<size_t>(maxPixels, static_cast<size_t>(w) * h);
+        return ImageTileSource::readRegion(x, y, w, h, dst);
+    }
+
+    int lastX, lastY;
+    size_t maxPixels;
+};
+
+/** Tile source declaring thread-safety as configured and remembering the largest number of concurrent reads. */
+class ConcurrentTileSource : public dest::face::ImageTileSource {
+public:
+    ConcurrentTileSource(const Eigen::Ref<const dest::core::Image> &img, bool safe)
+    : ImageTileSource(img), safe(safe), active(0), maxActive(0)
+    {}
+
+    bool readRegion(int x, int y, int w, int h, dest::core::Image &dst) {
+        const int a = active.fetch_add(1) + 1;
+        int m = maxActive.load();
+        while (a > m && !maxActive.compare_exchange_weak(m, a))
+            ;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        active.fetch_sub(1);
+        return ImageTileSource::readRegion(x, y, w, h, dst);
+    }
+
+    bool threadSafe() const {
+        return safe;
+    }
+
+    bool safe;
+    std::atomic<int> active, maxActive;
+};
+
+/** Place synthetic faces on a large canvas in a grid and return their rectangles. */
+inline std::vector<dest::core::Rect> createCanvas(int numFaces, int faceStride, dest::core::Image &canvas)
+{
+    const dest::core::InputData &input = syntheticInputs();
+
+    const int perRow = 4;
+    const int numRows = (numFaces + perRow - 1) / perRow;
+    canvas.setConstant(numRows * faceStride + 32, perRow * faceStride + 32, 0);
+
+    std::vector<dest::core::Rect> rects;
+    for (int i = 0; i < numFaces; ++i) {
+        const int x = 32 + (i % perRow) * faceStride;
+        const int y = 32 + (i / perRow) * faceStride;
+        const dest::core::Image &img = input.images[i];
+        canvas.block(y, x, img.rows(), img.cols()) = img;
+        rects.push_back(input.rects[i].colwise() + Eigen::Vector2f(static_cast<float>(x), static_cast<float>(y)));
+    }
+    return rects;
+}
+
+TEST_CASE("tiled-suppress-overlaps")
+{
+    std::vector<dest::core::Rect> rects;
+    rects.push_back(dest::core::createRectangle(Eigen::Vector2f(0, 0), Eigen::Vector2f(10, 10)));
+    rects.push_back(dest::core::createRectangle(Eigen::Vector2f(5, 0), Eigen::Vector2f(10, 10)));   // partial copy of first
+    rects.push_back(dest::core::createRectangle(Eigen::Vector2f(20, 20), Eigen::Vector2f(30, 30)));
+    rects.push_back(dest::core::createRectangle(Eigen::Vector2f(8, 8), Eigen::Vector2f(22, 22)));   // small overlaps only
+
+    dest::face::TiledProcessor::suppressOverlaps(rects, 0.5f);
+
+    REQUIRE(rects.size() == 3);
+    REQUIRE(rects[0].isApprox(dest::core::createRectangle(Eigen::Vector2f(8, 8), Eigen::Vector2f(22, 22))));
+    REQUIRE(rects[1].isApprox(dest::core::createRectangle(Eigen::Vector2f(0, 0), Eigen::Vector2f(10, 10))));
+    REQUIRE(rects[2].isApprox(dest::core::createRectangle(Eigen::Vector2f(20, 20), Eigen::Vector2f(30, 30))));
+}
+
+TEST_CASE("tiled-processor")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+
+    dest::core::Image canvas;
+    const std::vector<dest::core::Rect> truth = createCanvas(12, 160, canvas);
+
+    dest::face::TiledParameters params;
+    params.tileSize = 192;
+    params.tileOverlap = 128;
+    params.numThreads = 1;
+
+    RecordingTileSource src(canvas);
+
+    // Reports every face overlapping the tile, clipped to the tile. Faces cut by tile borders
+    // thus produce partial detections next to the full one from a neighboring tile.
+    dest::face::TileDetector detector = [&](const Eigen::Ref<const dest::core::Image> &tile, std::vector<dest::core::Rect> &faces) {
+        const Eigen::Vector2f origin(static_cast<float>(src.lastX), static_cast<float>(src.lastY));
+        const Eigen::Vector2f extent(static_cast<float>(tile.cols()), static_cast<float>(tile.rows()));
+        for (size_t i = 0; i < truth.size(); ++i) {
+            const Eigen::Vector2f minC = (truth[i].rowwise().minCoeff() - origin).cwiseMax(Eigen::Vector2f::Zero());
+            const Eigen::Vector2f maxC = (truth[i].rowwise().maxCoeff() - origin).cwiseMin(extent);
+            if ((maxC - minC).minCoeff() > 0.f)
+                faces.push_back(dest::core::createRectangle(minC, maxC));
+        }
+        return true;
+    };
+
+    dest::face::TiledProcessor p(t, params);
+
+    std::vector<dest::core::Rect> faces;
+    REQUIRE(p.detect(src, detector, faces));
+    REQUIRE(p.stats().numTiles > 1);
+    REQUIRE(p.stats().numDetections > p.stats().numFaces);
+    REQUIRE(faces.size() == truth.size());
+    REQUIRE(src.maxPixels <= 192u * 192u);
+
+    for (size_t i = 0; i < truth.size(); ++i) {
+        bool found = false;
+        for (size_t j = 0; j < faces.size() && !found; ++j) {
+            found = faces[j].isApprox(truth[i], 1e-4f);
+        }
+        REQUIRE(found);
+    }
+
+    // Align on multiple threads, reading only face footprints.
+    params.numThreads = 4;
+    params.footprintScale = 4.f;
+    dest::face::TiledProcessor pa(t, params);
+
+    RecordingTileSource alignSrc(canvas);
+    std::vector<dest::core::Shape> shapes;
+    REQUIRE(pa.align(alignSrc, truth, shapes));
+    REQUIRE(shapes.size() == truth.size());
+    REQUIRE(alignSrc.maxPixels < static_cast<size_t>(canvas.size()) / 4);
+
+    for (size_t i = 0; i < truth.size(); ++i) {
+        const dest::core::ShapeTransform shapeToImage = dest::core::estimateSimilarityTransform(dest::core::unitRectangle(), truth[i]);
+        const dest::core::Shape expected = t.predict(canvas, shapeToImage);
+        REQUIRE(shapes[i].isApprox(expected, 1e-3f));
+    }
+}
+
+TEST_CASE("tiled-processor-deterministic")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::Image canvas = dest::core::Image::Constant(200, 300, 0);
+
+    dest::face::TiledParameters params;
+    params.tileSize = 100;
+    params.tileOverlap = 90;
+
+    // Equally sized detections overlapping across neighboring tiles, so suppression depends
+    // on their order. Varying delays shuffle the order in which tiles complete.
+    std::atomic<int> calls(0);
+    dest::face::TileDetector detector = [&](const Eigen::Ref<const dest::core::Image> &, std::vector<dest::core::Rect> &faces) {
+        std::this_thread::sleep_for(std::chrono::microseconds((calls.fetch_add(1) * 7) % 300));
+        faces.push_back(dest::core::createRectangle(Eigen::Vector2f(10, 10), Eigen::Vector2f(60, 60)));
+        faces.push_back(dest::core::createRectangle(Eigen::Vector2f(14, 12), Eigen::Vector2f(64, 62)));
+        return true;
+    };
+
+    params.numThreads = 1;
+    dest::face::TiledProcessor serial(t, params);
+    dest::face::ImageTileSource src(canvas);
+    std::vector<dest::core::Rect> expected;
+    REQUIRE(serial.detect(src, detector, expected));
+    REQUIRE(serial.stats().numFaces < serial.stats().numDetections);
+
+    params.numThreads = 4;
+    dest::face::TiledProcessor parallel(t, params);
+    bool equal = true;
+    for (int r = 0; r < 5; ++r) {
+        std::vector<dest::core::Rect> faces;
+        REQUIRE(parallel.detect(src, detector, faces));
+        equal = equal && faces.size() == expected.size();
+        for (size_t i = 0; equal && i < faces.size(); ++i) {
+            equal = faces[i] == expected[i];
+        }
+    }
+    REQUIRE(equal);
+}
+
+TEST_CASE("tiled-processor-concurrent-reads")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::Image canvas = dest::core::Image::Constant(200, 300, 0);
+
+    dest::face::TiledParameters params;
+    params.tileSize = 100;
+    params.tileOverlap = 0;
+    params.numThreads = 4;
+    dest::face::TiledProcessor p(t, params);
+
+    dest::face::TileDetector detector = [](const Eigen::Ref<const dest::core::Image> &, std::vector<dest::core::Rect> &) {
+        return true;
+    };
+
+    // Reads are serialized unless the source declares itself thread-safe.
+    std::vector<dest::core::Rect> faces;
+    ConcurrentTileSource unsafeSrc(canvas, false);
+    REQUIRE(p.detect(unsafeSrc, detector, faces));
+    REQUIRE(p.stats().numTiles == 6);
+    REQUIRE(unsafeSrc.maxActive.load() == 1);
+
+    ConcurrentTileSource safeSrc(canvas, true);
+    REQUIRE(p.detect(safeSrc, detector, faces));
+    REQUIRE(safeSrc.maxActive.load() > 1);
+}
@@ -0,0 +1,380 @@
+/**
+This file is part of Deformable Shape Tracking (DEST).
+
+Copyright(C) 2015/2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of the BSD license.See the LICENSE file for details.
+*/
+
+#include "catch.hpp"
+#include "test_fixtures.h"
+
+#include <dest/core/tracker.h>
+#include <dest/core/request_coalescer.h>
+#include <dest/core/pipelined_tracker.h>
+#include <dest/util/spsc_queue.h>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("tracker-batch-predict")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    std::vector<dest::core::MappedImage> imgs;
+    std::vector<dest::core::ShapeTransform> transforms;
+    for (size_t i = 0; i < 10; ++i) {
+        const dest::core::Image &img = input.images[i];
+        imgs.push_back(dest::core::MappedImage(img.data(), img.rows(), img.cols(), Eigen::OuterStride<Eigen::Dynamic>(img.cols())));
+        transforms.push_back(input.shapeToImage[i]);
+    }
+
+    std::vector<dest::core::Shape> shapes;
+    t.predict(imgs, transforms, shapes);
+
+    REQUIRE(shapes.size() == 10);
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        dest::core::Shape expected = t.predict(input.images[i], input.shapeToImage[i]);
+        REQUIRE(shapes[i].isApprox(expected));
+    }
+}
+
+TEST_CASE("tracker-sampling-strategies")
+{
+    dest::core::Tracker t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    REQUIRE(t.samplingStrategy() == dest::core::SAMPLING_AUTO);
+
+    std::vector<dest::core::Shape> eager;
+    t.setSamplingStrategy(dest::core::SAMPLING_EAGER);
+    REQUIRE(t.numLazySamplingCascades() == 0);
+    for (size_t i = 0; i < 10; ++i) {
+        eager.push_back(t.predict(input.images[i], input.shapeToImage[i]));
+    }
+
+    t.setSamplingStrategy(dest::core::SAMPLING_LAZY);
+    REQUIRE(t.numLazySamplingCascades() == t.numCascades());
+    for (size_t i = 0; i < 10; ++i) {
+        REQUIRE(t.predict(input.images[i], input.shapeToImage[i]).isApprox(eager[i]));
+    }
+}
+
+TEST_CASE("tracker-incremental-predict")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::core::TrackState state;
+    dest::core::Image img = input.images[0];
+    const dest::core::ShapeTransform &shapeToImage = input.shapeToImage[0];
+
+    dest::core::Shape s = t.predict(img, shapeToImage, state);
+    REQUIRE(s.isApprox(t.predict(img, shapeToImage)));
+    REQUIRE(state.treesReused == 0);
+    const int numTrees = state.treesEvaluated;
+    REQUIRE(numTrees > 0);
+
+    // Unchanged frame keeps all leaves.
+    s = t.predict(img, shapeToImage, state);
+    REQUIRE(s.isApprox(t.predict(img, shapeToImage)));
+    REQUIRE(state.treesReused == numTrees);
+
+    // Slightly changing frames keep most leaves and match full prediction.
+    std::mt19937 rnd(10);
+    std::uniform_int_distribution<int> dn(-1, 1);
+    for (int f = 0; f < 5; ++f) {
+        for (int i = 0; i < img.size(); ++i) {
+            img.data()[i] = static_cast<unsigned char>(std::min<int>(255, std::max<int>(0, img.data()[i] + dn(rnd))));
+        }
+
+        s = t.predict(img, shapeToImage, state);
+        REQUIRE(s.isApprox(t.predict(img, shapeToImage), 1e-4f));
+        REQUIRE(state.treesEvaluated + state.treesReused == numTrees);
+        REQUIRE(state.treesReused > 0);
+    }
+
+    // Switching to a different face re-traverses as necessary.
+    s = t.predict(input.images[1], input.shapeToImage[1], state);
+    REQUIRE(s.isApprox(t.predict(input.images[1], input.shapeToImage[1]), 1e-4f));
+}
+
+/** Mean landmark distance in normalized shape space on the given range of inputs. */
+inline float meanNormalizedError(const dest::core::Tracker &t, const dest::core::InputData &input, size_t first, size_t last)
+{
+    float error = 0.f;
+    for (size_t i = first; i < last; ++i) {
+        dest::core::Shape s = t.predict(input.images[i], input.shapeToImage[i]);
+        s = input.shapeToImage[i].inverse() * s.colwise().homogeneous();
+        error += (s - input.shapes[i]).colwise().norm().mean();
+    }
+    return error / static_cast<float>(last - first);
+}
+
+TEST_CASE("tracker-refit")
+{
+    dest::core::Tracker t = syntheticTracker();
+
+    // New domain with reduced contrast and shifted brightness.
+    dest::core::InputData input;
+    input.rnd.seed(20);
+    dest::util::createSyntheticInputData(60, 96, input.rnd, input);
+    dest::core::InputData::normalizeShapes(input);
+    for (size_t i = 0; i < input.images.size(); ++i) {
+        input.images[i] = (input.images[i].cast<float>() * 0.4f + Eigen::MatrixXf::Constant(96, 96, 120.f)).cast<unsigned char>();
+    }
+
+    // Refit on the first images, evaluate on the remaining ones.
+    dest::core::InputData train = input;
+    train.images.resize(45);
+    train.shapes.resize(45);
+    train.rects.resize(45);
+    train.shapeToImage.resize(45);
+
+    const float before = meanNormalizedError(t, input, 45, 60);
+
+    dest::core::SampleData td(train);
+    dest::core::SampleCreationParameters sp;
+    sp.numShapesPerImage = 5;
+    dest::core::SampleData::createTrainingSamples(td, sp);
+
+    const dest::core::Shape meanShape = t.meanShape();
+    REQUIRE(t.refit(td));
+    REQUIRE(t.meanShape().isApprox(meanShape));
+    REQUIRE(t.numCascades() == syntheticTracker().numCascades());
+
+    const float after = meanNormalizedError(t, input, 45, 60);
+    REQUIRE(after < before);
+}
+
+TEST_CASE("tracker-pyramid-sampling")
+{
+    dest::core::InputData input = syntheticInputs();
+
+    dest::core::SampleData td(input);
+    td.params.numCascades = 4;
+    td.params.numTrees = 20;
+    td.params.maxTreeDepth = 4;
+    td.params.numRandomPixelCoordinates = 100;
+    td.params.learningRate = 0.2f;
+    td.params.pyramidSamplesPerLambda = 1.f;
+
+    dest::core::SampleCreationParameters sp;
+    sp.numShapesPerImage = 5;
+    dest::core::SampleData::createTrainingSamples(td, sp);
+
+    dest::core::Tracker t;
+    REQUIRE(t.fit(td));
+    REQUIRE(t.maxSamplingLevel(input.shapeToImage[0]) > 0);
+    REQUIRE(syntheticTracker().maxSamplingLevel(input.shapeToImage[0]) == 0);
+
+    // Coarse stages still converge.
+    float initialError = 0.f;
+    for (size_t i = 0; i < 60; ++i)
+        initialError += (t.meanShape() - input.shapes[i]).colwise().norm().mean();
+    initialError /= 60.f;
+    REQUIRE(meanNormalizedError(t, input, 0, 60) < 0.5f * initialError);
+
+    // Sampling spacing survives serialization.
+    flatbuffers::FlatBufferBuilder fbb;
+    fbb.Finish(t.save(fbb));
+    dest::core::Tracker loaded;
+    loaded.load(*flatbuffers::GetRoot<dest::io::Tracker>(fbb.GetBufferPointer()));
+    REQUIRE(loaded.maxSamplingLevel(input.shapeToImage[0]) == t.maxSamplingLevel(input.shapeToImage[0]));
+
+    std::vector<dest::core::MappedImage> imgs;
+    std::vector<dest::core::ShapeTransform> transforms;
+    for (size_t i = 0; i < 8; ++i) {
+        const dest::core::Image &img = input.images[i];
+        imgs.push_back(dest::core::MappedImage(img.data(), img.rows(), img.cols(), Eigen::OuterStride<Eigen::Dynamic>(img.cols())));
+        transforms.push_back(input.shapeToImage[i]);
+    }
+
+    std::vector<dest::core::Shape> batch;
+    loaded.predict(imgs, transforms, batch);
+
+    dest::core::TrackState state;
+    for (size_t i = 0; i < 8; ++i) {
+        const dest::core::Shape s = t.predict(input.images[i], input.shapeToImage[i]);
+        REQUIRE(s.isApprox(loaded.predict(input.images[i], input.shapeToImage[i])));
+        REQUIRE(s.isApprox(batch[i], 1e-4f));
+        REQUIRE(s.isApprox(t.predict(input.images[i], input.shapeToImage[i], state), 1e-4f));
+    }
+}
+
+TEST_CASE("tracker-request-coalescer")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::core::CoalescerParameters params;
+    params.maxBatchSize = 4;
+    params.batchWindowMs = 1.f;
+
+    std::vector< std::future<dest::core::Shape> > results;
+    {
+        dest::core::RequestCoalescer rc(t, params);
+        for (size_t i = 0; i < 10; ++i) {
+            results.push_back(rc.submit(input.images[i], input.shapeToImage[i]));
+        }
+
+        for (size_t i = 0; i < results.size(); ++i) {
+            dest::core::Shape expected = t.predict(input.images[i], input.shapeToImage[i]);
+            REQUIRE(results[i].get().isApprox(expected));
+        }
+
+        dest::core::CoalescerStats stats = rc.stats();
+        REQUIRE(stats.numRequests == 10);
+        REQUIRE(stats.numBatches >= 3);
+        REQUIRE(stats.batchSizeLimit >= 1);
+        REQUIRE(stats.batchSizeLimit <= 4);
+    }
+
+    // A failing batch rethrows from every pending future and does not stop the worker.
+    results.clear();
+    {
+        dest::core::RequestCoalescer rc(t, params, [](const std::vector<dest::core::MappedImage> &, const std::vector<dest::core::ShapeTransform> &, std::vector<dest::core::Shape> &) {
+            throw std::runtime_error("batch failed");
+        });
+        for (size_t i = 0; i < 10; ++i) {
+            results.push_back(rc.submit(input.images[i], input.shapeToImage[i]));
+        }
+
+        for (size_t i = 0; i < results.size(); ++i) {
+            REQUIRE_THROWS_AS(results[i].get(), std::runtime_error);
+        }
+
+        REQUIRE(rc.stats().numRequests == 0);
+    }
+}
+
+TEST_CASE("tracker-pipelined")
+{
+    const dest::core::Tracker &t = syntheticTracker();
+    const dest::core::InputData &input = syntheticInputs();
+
+    dest::core::PipelineParameters params;
+    params.numStages = 3;
+    params.queueCapacity = 4;
+    params.firstCore = -1;
+
+    dest::core::PipelinedTracker pt(t, params);
+    REQUIRE(pt.numStages() == 3);
+    REQUIRE(pt.stageCascades(0).first == 0);
+    REQUIRE(pt.stageCascades(2).second == t.numCascades());
+    REQUIRE(pt.stageCascades(0).second == pt.stageCascades(1).first);
+    REQUIRE(pt.stageCascades(1).second == pt.stageCascades(2).first);
+
+    std::vector< std::future<dest::core::Shape> > results;
+    for (size_t i = 0; i < 20; ++i) {
+        results.push_back(pt.submit(input.images[i], input.shapeToImage[i]));
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        dest::core::Shape expected = t.predict(input.images[i], input.shapeToImage[i]);
+        REQUIRE(results[i].get().isApprox(expected));
+    }
+
+    // A stage failing on some faces passes the exception to their futures and keeps serving the others.
+    const dest::core::ShapeTransform failing = input.shapeToImage[3];
+    dest::core::PipelinedTracker failingPt(t, params, [&](const Eigen::Ref<const dest::core::Image> &img, dest::core::ImagePyramid &pyr, const dest::core::ShapeTransform &shapeToImage, int first, int last, dest::core::Shape &estimate) {
+        if (first > 0 && shapeToImage.isApprox(failing))
+            throw std::runtime_error("stage failed");
+        t.predictCascades(img, pyr, shapeToImage, first, last, estimate);
+    });
+
+    results.clear();
+    for (size_t i = 0; i < 20; ++i) {
+        const size_t k = (i % 4 == 3) ? 3 : i;
+        results.push_back(failingPt.submit(input.images[k], input.shapeToImage[k]));
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i % 4 == 3) {
+            REQUIRE_THROWS_AS(results[i].get(), std::runtime_error);
+        } else {
+            dest::core::Shape expected = t.predict(input.images[i], input.shapeToImage[i]);
+            REQUIRE(results[i].get().isApprox(expected));
+        }
+    }
+}
+
+TEST_CASE("spsc-queue")
+{
+    dest::util::SPSCQueue<int> q(3);
+    REQUIRE(q.capacity() == 4);
+
+    int v;
+    REQUIRE(!q.pop(v));
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(q.push(i));
+    }
+    REQUIRE(!q.push(4));
+    REQUIRE(q.pop(v));
+    REQUIRE(v == 0);
+
+    // Concurrent producer and consumer preserve order.
+    const int n = 100000;
+    std::thread producer([&q]() {
+        for (int i = 5; i < n; ++i) {
+            while (!q.push(i))
+                std::this_thread::yield();
+        }
+    });
+
+    int expected = 1;
+    bool ordered = true;
+    while (expected < n) {
+        if (q.pop(v)) {
+            if (expected == 4)
+                expected = 5;
+            ordered = ordered && (v == expected);
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    REQUIRE(ordered);
+    REQUIRE(q.empty());
+}
+
+TEST_CASE("tracker-correlation-splits")
+{
+    const dest::core::InputData &input = syntheticInputs();
+
+    // Train on the first images, evaluate on the remaining ones as well.
+    float errors[2], heldOutErrors[2];
+    for (int m = 0; m < 2; ++m) {
+        dest::core::InputData in = input;
+        in.images.resize(45);
+        in.shapes.resize(45);
+        in.rects.resize(45);
+        in.shapeToImage.resize(45);
+        in.rnd.seed(10);
+
+        dest::core::SampleData td(in);
+        td.params.numCascades = 4;
+        td.params.numTrees = 10;
+        td.params.maxTreeDepth = 4;
+        td.params.numRandomPixelCoordinates = 100;
+        td.params.learningRate = 0.2f;
+        td.params.splitSelection = (m == 0) ? dest::core::SPLIT_RANDOM : dest::core::SPLIT_CORRELATION;
+
+        dest::core::SampleCreationParameters sp;
+        sp.numShapesPerImage = 5;
+        dest::core::SampleData::createTrainingSamples(td, sp);
+
+        dest::core::Tracker t;
+        REQUIRE(t.fit(td));
+        errors[m] = meanNormalizedError(t, input, 0, 45);
+        heldOutErrors[m] = meanNormalizedError(t, input, 45, 60);
+    }
+
+    // Same number of trees, stronger splits that generalize.
+    REQUIRE(errors[1] < errors[0]);
+    REQUIRE(heldOutErrors[1] < heldOutErrors[0]);
+}